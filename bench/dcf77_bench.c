@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dcf77.h"
+#include "timecode.h"
+#include "tz_cache.h"
+#include "tx_chan.h"
+#include "schedule.h"
+#include "tx_backend.h"
+#include "tx_clock.h"
+#include "rt_metrics.h"
+#include "rt_profile.h"
+#include "flight_rec.h"
+#include "tx_log.h"
+#include "hw_conf.h"
+#include "parse_num.h"
+#include "version.h"
+
+/*
+dcf77-bench: host benchmarks of the transmit path, no hardware needed.
+  encode.*   frame encoders: tx_block_prep() + set_modulation(), dcf77_encode_range(), tc_encode() per protocol
+  plan.*     edge planner: one minute of edges for one and for four channels
+  carrier.*  carrier planner: table hit, full search, find_best()
+  edge.*     per-edge work: att_set() on the virtual backend (GPIO mock), metrics, flight recorder, log push
+  sleep.*    clk_delay(), realtime sleep_until() and the hybrid sleep-then-spin wait: wake-up lateness on this host
+Batched benchmarks take one sample per batch (ns per operation), latency benchmarks one per operation.
+Every result is one line of key=value pairs with fixed names and units: two runs compare line by line.
+*/
+
+#ifndef DCF77_BUILD_TYPE
+#define DCF77_BUILD_TYPE "unknown"
+#endif
+
+#define DEFAULT_REPS 15
+#define SLEEP_AHEAD_NS 500000LL // Sleep benchmarks: deadline this far ahead of each wake-up
+
+typedef struct bench_args {
+    int reps;
+    double scale;
+    int core;          // -1: not pinned
+    int prio;          // SCHED_FIFO priority, 0 = SCHED_OTHER
+    const char *only;  // Name prefix, NULL = all
+    uint8_t list;
+} bench_args_t;
+
+typedef struct bench {
+    const char *name;
+    long ops;                         // Operations per batch, or samples for a latency benchmark (scale 1)
+    uint64_t (*batch)(long n);        // Runs n operations, returns a checksum
+    int64_t (*latency)(void);         // One operation, returns its ns
+    void (*settle)(void);             // After each batch, not timed
+} bench_t;
+
+static tz_cache_t zone[TX_MAX_CHANNELS];
+static tx_chan_t chans[TX_MAX_CHANNELS];
+static tx_minute_t minute;
+static tx_backend_t *mock;
+static tx_clock_t clk;
+static tx_clock_t spin_clk; // Realtime clock behind the hybrid wait, adaptive margin
+static tx_spin_t spin;
+static rt_metrics_t metrics;
+static flight_rec_t rec;
+static char rec_path[64];
+static volatile uint64_t sink; // Keeps the compiler from dropping the work
+
+static int64_t mono_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return tx_ts_ns(&ts);
+}
+
+static const time_t T0 = 1718458200; // 2024-06-15 13:30 UTC
+
+/*--------------------------- ENCODERS ------------------------*/
+
+static uint64_t b_encode_legacy(long n){
+    uint64_t sum = 0;
+    uint8_t leap = 0;
+    for (long i = 0; i < n; i++) {
+        tx_block_prep(T0 + (time_t)i * 60, &leap);
+        for (int s = 0; s < 60; s++) sum += (uint64_t)set_modulation(s).duration;
+    }
+    return sum;
+}
+
+static uint64_t b_encode_range(long n){
+    dcf77_frame_t buf[1024];
+    uint64_t sum = 0;
+    for (long done = 0; done < n; done += 1024) {
+        const long k = n - done < 1024 ? n - done : 1024;
+        dcf77_encode_range(T0 + (time_t)done * 60, (size_t)k, &zone[0], 0, buf);
+        for (long i = 0; i < k; i++) sum ^= buf[i];
+    }
+    return sum;
+}
+
+static uint64_t encode_proto(const tc_proto_t *p, const tz_cache_t *tz, long n){
+    uint64_t sum = 0;
+    for (long i = 0; i < n; i++) {
+        const tc_frame_t f = tc_encode(p, T0 + (time_t)i * 60, tz, 0);
+        sum ^= f.a ^ f.b;
+    }
+    return sum;
+}
+
+static uint64_t b_encode_dcf77(long n){ return encode_proto(&tc_dcf77, &zone[0], n); }
+static uint64_t b_encode_msf(long n){ return encode_proto(&tc_msf, &zone[1], n); }
+static uint64_t b_encode_wwvb(long n){ return encode_proto(&tc_wwvb, &zone[2], n); }
+static uint64_t b_encode_jjy(long n){ return encode_proto(&tc_jjy, &zone[3], n); }
+
+/*--------------------------- PLANNERS ------------------------*/
+
+static uint64_t plan(int n_chan, long n){
+    uint64_t sum = 0;
+    for (long i = 0; i < n; i++) {
+        uint8_t leap = 0;
+        sched_compile_minute(chans, n_chan, T0 + (time_t)i * 60, &leap, &minute);
+        sum += (uint64_t)minute.n_edges;
+    }
+    return sum;
+}
+
+static uint64_t b_plan_1(long n){ return plan(1, n); }
+static uint64_t b_plan_4(long n){ return plan(TX_MAX_CHANNELS, n); }
+
+static uint64_t b_carrier_table(long n){
+    uint64_t sum = 0;
+    for (long i = 0; i < n; i++) {
+        int from_table;
+        sum += carrier_plan(CLOCK_FREQ, TARGET_HZ, &from_table).loops;
+    }
+    return sum;
+}
+
+static uint64_t b_carrier_search(long n){
+    uint64_t sum = 0;
+    for (long i = 0; i < n; i++) sum += carrier_plan_search(CLOCK_FREQ, TARGET_HZ).loops;
+    return sum;
+}
+
+static uint64_t b_find_best(long n){
+    uint64_t sum = 0;
+    for (long i = 0; i < n; i++) sum += find_best(CLOCK_FREQ, TARGET_HZ, 0, (uint32_t)(CLOCK_FREQ / TARGET_HZ / 2)).loops;
+    return sum;
+}
+
+/*--------------------------- EDGE PATH ------------------------*/
+
+static uint64_t b_att_set(long n){
+    struct timespec dl;
+    clock_gettime(CLOCK_REALTIME, &dl);
+    for (long i = 0; i < n; i++) mock->att_set(mock, 0, (uint8_t)(i & 1), &dl);
+    return (uint64_t)n;
+}
+
+static uint64_t b_metrics(long n){
+    for (long i = 0; i < n; i++) rt_metrics_edge(&metrics, i & 0xfff, 200);
+    return atomic_load_explicit(&metrics.tx_send.count, memory_order_relaxed);
+}
+
+static uint64_t b_recorder(long n){
+    for (long i = 0; i < n; i++) fr_record(&rec, i, i + 100, minute.frame[0], minute.frame_b[0], (uint8_t)(i % 60), (uint8_t)(i & 1), 0);
+    return (uint64_t)n;
+}
+
+static uint64_t b_log_push(long n){
+    // An id the writer skips: this measures the queue, not stderr
+    const tx_log_rec_t r = { .ev = 0xffff };
+    for (long i = 0; i < n; i++) tx_log_push(&r);
+    return (uint64_t)n;
+}
+
+// Let the writer empty the ring before the next batch: a full ring only measures the drop path
+static void s_log_drain(void){
+    const struct timespec drain = { .tv_sec = 0, .tv_nsec = (TX_LOG_POLL_MS + 5) * 1000000L };
+    nanosleep(&drain, NULL);
+}
+
+/*--------------------------- SLEEP LATENESS ------------------------*/
+
+static struct timespec ahead(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t ns = tx_ts_ns(&ts) + SLEEP_AHEAD_NS;
+    return (struct timespec){ .tv_sec = (time_t)(ns / 1000000000LL), .tv_nsec = (long)(ns % 1000000000LL) };
+}
+
+static int64_t l_clk_delay(void){
+    const struct timespec dl = ahead();
+    clk_delay(dl);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return tx_ts_ns(&now) - tx_ts_ns(&dl);
+}
+
+static int64_t l_sleep_until(void){
+    const struct timespec dl = ahead();
+    clk.sleep_until(&clk, &dl);
+    return tx_clock_ns(&clk) - tx_ts_ns(&dl);
+}
+
+static int64_t l_sleep_spin(void){
+    const struct timespec dl = ahead();
+    spin_clk.sleep_until(&spin_clk, &dl);
+    return tx_clock_ns(&spin_clk) - tx_ts_ns(&dl);
+}
+
+static const bench_t benches[] = {
+    { "encode.legacy",     20000,   b_encode_legacy,   NULL,           NULL },
+    { "encode.range",      200000,  b_encode_range,    NULL,           NULL },
+    { "encode.dcf77",      100000,  b_encode_dcf77,    NULL,           NULL },
+    { "encode.msf",        100000,  b_encode_msf,      NULL,           NULL },
+    { "encode.wwvb",       100000,  b_encode_wwvb,     NULL,           NULL },
+    { "encode.jjy",        100000,  b_encode_jjy,      NULL,           NULL },
+    { "plan.minute",       10000,   b_plan_1,          NULL,           NULL },
+    { "plan.minute4",      2000,    b_plan_4,          NULL,           NULL },
+    { "carrier.table",     100000,  b_carrier_table,   NULL,           NULL },
+    { "carrier.search",    1,       b_carrier_search,  NULL,           NULL },
+    { "carrier.find_best", 100,     b_find_best,       NULL,           NULL },
+    { "edge.att_set",      100000,  b_att_set,         NULL,           NULL },
+    { "edge.metrics",      100000,  b_metrics,         NULL,           NULL },
+    { "edge.recorder",     100000,  b_recorder,        NULL,           NULL },
+    { "edge.log_push",     512,     b_log_push,        NULL,           s_log_drain },
+    { "sleep.clk_delay",   1000,    NULL,              l_clk_delay,    NULL },
+    { "sleep.realtime",    1000,    NULL,              l_sleep_until,  NULL },
+    { "sleep.spin",        1000,    NULL,              l_sleep_spin,   NULL },
+};
+
+static int cmp_double(const void *a, const void *b){
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name, double *v, int n){
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += v[i];
+    qsort(v, (size_t)n, sizeof(*v), cmp_double);
+    printf("bench=%s samples=%d unit=ns mean=%.2f p50=%.2f p99=%.2f min=%.2f max=%.2f\n", name, n, sum / n,
+           v[n / 2], v[(int)((n - 1) * 0.99)], v[0], v[n - 1]);
+    fflush(stdout);
+}
+
+static int run(const bench_t *b, const bench_args_t *a){
+    const long ops = (long)(b->ops * a->scale) > 0 ? (long)(b->ops * a->scale) : 1;
+    const int n = b->batch ? a->reps : (int)ops;
+    double *v = malloc((size_t)n * sizeof(*v));
+    if (!v) { perror("malloc"); return -1; }
+
+    if (b->batch) {
+        sink ^= b->batch(ops); // Warm up: caches, page faults, lazy tables
+        if (b->settle) b->settle();
+        for (int r = 0; r < n; r++) {
+            const int64_t t0 = mono_ns();
+            sink ^= b->batch(ops);
+            v[r] = (double)(mono_ns() - t0) / (double)ops;
+            if (b->settle) b->settle();
+        }
+    } else {
+        for (int i = 0; i < 16; i++) sink ^= (uint64_t)b->latency();
+        for (int i = 0; i < n; i++) v[i] = (double)b->latency();
+    }
+    report(b->name, v, n);
+    free(v);
+    return 0;
+}
+
+static void zone_init(int i, const tc_proto_t *p){
+    if (tz_cache_init(&zone[i], p->zone, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+        tz_cache_init_rules(&zone[i], p->zone, p->std_offset, p->dst_start, p->dst_end, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+    }
+    chans[i] = (tx_chan_t){ .carrier_pin = (unsigned)(4 + i), .att_pin = (unsigned)(20 + i), .proto = p, .tz = &zone[i] };
+    snprintf(chans[i].zone, sizeof(chans[i].zone), "%s", p->zone);
+}
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s [-r reps] [-n scale] [-c core] [-p prio] [-b name] [-l]\n"
+                "  -r, --reps     n           (Samples per batched benchmark, Default: %d)\n"
+                "  -n, --scale    x           (Multiplies every operation count, Default: 1)\n"
+                "  -c, --core     n           (Pin to this core)\n"
+                "  -p, --prio     n           (SCHED_FIFO priority, needs -c, Default: 0 = SCHED_OTHER)\n"
+                "  -b, --bench    name        (Only benchmarks starting with name, e.g. encode or edge.att_set)\n"
+                "  -l, --list                 (List the benchmarks)\n"
+                "  -h, --help                 (This message)\n", prog, DEFAULT_REPS);
+}
+
+static int parse_args(int argc, char *argv[], bench_args_t *out){
+    *out = (bench_args_t){ .reps = DEFAULT_REPS, .scale = 1.0, .core = -1 };
+
+    static const struct option longopts[] = {
+        {"reps",  required_argument, 0, 'r'},
+        {"scale", required_argument, 0, 'n'},
+        {"core",  required_argument, 0, 'c'},
+        {"prio",  required_argument, 0, 'p'},
+        {"bench", required_argument, 0, 'b'},
+        {"list",  no_argument,       0, 'l'},
+        {"help",  no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    char *end;
+    while ((c = getopt_long(argc, argv, "r:n:c:p:b:lh", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'r':
+                if (parse_int(optarg, 1, INT_MAX, &out->reps) < 0) { fprintf(stderr, "Error: invalid reps '%s'\n\n", optarg); return -1; }
+                break;
+            case 'n':
+                out->scale = strtod(optarg, &end);
+                if (end == optarg || *end || out->scale <= 0) { fprintf(stderr, "Error: invalid scale '%s'\n\n", optarg); return -1; }
+                break;
+            case 'c':
+                if (parse_int(optarg, 0, CPU_SETSIZE - 1, &out->core) < 0) { fprintf(stderr, "Error: invalid core '%s'\n\n", optarg); return -1; }
+                break;
+            case 'p':
+                if (parse_int(optarg, 0, 99, &out->prio) < 0) { fprintf(stderr, "Error: invalid priority '%s'\n\n", optarg); return -1; }
+                break;
+            case 'b': out->only = optarg; break;
+            case 'l': out->list = 1; break;
+            case 'h': usage(stdout, argv[0]); exit(0);
+            default: usage(stderr, argv[0]); return -1;
+        }
+    }
+    if (out->prio && out->core < 0) { fprintf(stderr, "Error: -p needs -c\n\n"); return -1; }
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    bench_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+    const size_t n_bench = sizeof(benches) / sizeof(benches[0]);
+
+    if (args.list) {
+        for (size_t i = 0; i < n_bench; i++) printf("%s\n", benches[i].name);
+        return 0;
+    }
+    if (args.core >= 0 && rt_thread_setup(args.core, args.prio, 0) < 0) return 1;
+
+    const tc_proto_t *protos[TX_MAX_CHANNELS] = { &tc_dcf77, &tc_msf, &tc_wwvb, &tc_jjy };
+    for (int i = 0; i < TX_MAX_CHANNELS; i++) zone_init(i, protos[i]);
+    dcf77_set_zone(&zone[0]);
+    uint8_t leap = 0;
+    sched_compile_minute(chans, 1, T0, &leap, &minute);
+
+    if (tx_clock_realtime_init(&clk) < 0 || tx_clock_realtime_init(&spin_clk) < 0) return 1;
+    tx_clock_spin_init(&spin_clk, &spin, 0, 0, NULL);
+    mock = tx_backend_virtual_new(NULL);
+    if (!mock) { fprintf(stderr, "Error: virtual backend init failed\n"); return 1; }
+    mock->clock = &clk;
+    mock->att_open(mock, 0, 0);
+
+    snprintf(rec_path, sizeof(rec_path), "/tmp/dcf77-bench.%d.rec", (int)getpid());
+    if (fr_open(&rec, rec_path, chans, 1) < 0) return 1;
+    if (tx_log_start(NULL) < 0) return 1;
+    tx_log_bind();
+
+    printf("# version=%s build=%s cc=\"%s\" cpus=%ld reps=%d scale=%g core=%d prio=%d\n", DCF77_PROJECT_VERSION, DCF77_BUILD_TYPE[0] ? DCF77_BUILD_TYPE : "none", __VERSION__,
+           sysconf(_SC_NPROCESSORS_ONLN), args.reps, args.scale, args.core, args.prio);
+    int rc = 0;
+    for (size_t i = 0; i < n_bench; i++) {
+        if (args.only && strncmp(benches[i].name, args.only, strlen(args.only)) != 0) continue;
+        if (run(&benches[i], &args) < 0) rc = 1;
+    }
+
+    tx_log_stop();
+    fr_close(&rec);
+    unlink(rec_path);
+    tx_backend_free(mock);
+    for (int i = 0; i < TX_MAX_CHANNELS; i++) tz_cache_free(&zone[i]);
+    return rc;
+}
@@ -0,0 +1,138 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "hw_conf.h"
+#include "rt_profile.h"
+#include "parse_num.h"
+
+/*
+Attenuator edge benchmark: per-edge latency and syscall count of the legacy
+request/release path (tx_send_legacy) against the held-line engine (tx_edge_*).
+Toggles GPIO_LINE on GPIO_CHIP: run on the Pi with the transmitter stopped.
+Syscalls are counted with the raw_syscalls:sys_enter tracepoint (needs root + tracefs).
+*/
+
+#define DEFAULT_EDGES 2000
+
+typedef struct edge_stats {
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+    double syscalls; // per edge, <0 when unavailable
+} edge_stats_t;
+
+static int64_t ts_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_i64(const void *a, const void *b){
+    const int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Open a per-thread counter on raw_syscalls:sys_enter, -1 when tracefs or permissions are missing
+static int syscall_counter_open(void){
+    static const char *paths[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+    };
+    long long id = -1;
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]) && id < 0; ++i) {
+        FILE *f = fopen(paths[i], "r");
+        if (!f) continue;
+        if (fscanf(f, "%lld", &id) != 1) id = -1;
+        fclose(f);
+    }
+    if (id < 0) return -1;
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = (unsigned long long)id;
+    attr.disabled = 1;
+    attr.sample_period = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static edge_stats_t run(const char *name, void (*edge)(uint8_t, tx_ctx_t *), tx_ctx_t *ctx, int edges){
+    edge_stats_t st = { .syscalls = -1.0 };
+    int64_t *lat = malloc((size_t)edges * sizeof(*lat));
+    if (!lat) { perror("malloc"); return st; }
+
+    for (int i = 0; i < 16; ++i) edge((uint8_t)(i & 1), ctx); // Warm up
+
+    int cnt_fd = syscall_counter_open();
+    if (cnt_fd >= 0) {
+        ioctl(cnt_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cnt_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    for (int i = 0; i < edges; ++i) {
+        const int64_t t0 = ts_ns();
+        edge((uint8_t)(i & 1), ctx);
+        lat[i] = ts_ns() - t0;
+    }
+
+    if (cnt_fd >= 0) {
+        ioctl(cnt_fd, PERF_EVENT_IOC_DISABLE, 0);
+        unsigned long long n = 0;
+        if (read(cnt_fd, &n, sizeof(n)) == sizeof(n)) st.syscalls = (double)n / edges;
+        close(cnt_fd);
+    }
+    edge(0, ctx); // Leave Hi-Z
+
+    double sum = 0.0;
+    for (int i = 0; i < edges; ++i) sum += (double)lat[i];
+    qsort(lat, (size_t)edges, sizeof(*lat), cmp_i64);
+    st.mean_us = sum / edges / 1000.0;
+    st.p50_us = lat[edges / 2] / 1000.0;
+    st.p99_us = lat[(int)((edges - 1) * 0.99)] / 1000.0;
+    st.max_us = lat[edges - 1] / 1000.0;
+    free(lat);
+
+    if (st.syscalls < 0) printf("%-8s %8d %14s", name, edges, "n/a");
+    else printf("%-8s %8d %14.1f", name, edges, st.syscalls);
+    printf(" %10.2f %10.2f %10.2f %10.2f\n", st.mean_us, st.p50_us, st.p99_us, st.max_us);
+    return st;
+}
+
+static void edge_held(uint8_t state, tx_ctx_t *ctx){ tx_edge_set(ctx, state); }
+
+int main(int argc, char *argv[]){
+    int edges = DEFAULT_EDGES;
+    if (argc > 1) {
+        if (parse_int(argv[1], 1, INT_MAX, &edges) < 0) {
+            fprintf(stderr, "Usage: sudo %s [edges]   (Default: %d)\n", argv[0], DEFAULT_EDGES);
+            return 1;
+        }
+    }
+
+    rt_profile_t rt;
+    rt_profile_defaults(&rt);
+    rt_thread_setup(rt.tx_core, rt.tx_prio, rt.slack_ns); // Same core/priority as data_tx
+
+    tx_ctx_t *ctx = tx_ctx_new();
+    if (!ctx || tx_chip_init(ctx) < 0) { fprintf(stderr, "GPIO chip init failed\n"); return 1; }
+
+    printf("%-8s %8s %14s %10s %10s %10s %10s\n", "path", "edges", "syscalls/edge", "mean_us", "p50_us", "p99_us", "max_us");
+    run("legacy", tx_send_legacy, ctx, edges);
+
+    if (tx_edge_open(ctx, GPIO_LINE) < 0) { fprintf(stderr, "Edge engine init failed\n"); gpio_cleanup(ctx); tx_ctx_free(ctx); return 1; }
+    run("held", edge_held, ctx, edges);
+
+    gpio_cleanup(ctx);
+    tx_ctx_free(ctx);
+    return 0;
+}
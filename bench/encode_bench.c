@@ -0,0 +1,90 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dcf77.h"
+#include "tz_cache.h"
+#include "parse_num.h"
+
+/*
+Encoder throughput: dcf77_encode_range() frames/second on one core and on all cores.
+Each thread encodes its own slice of the range into its own buffer (no shared state).
+*/
+
+#define DEFAULT_MINUTES (100L * 525960L) // ~ a century
+#define CHUNK 4096
+
+typedef struct job {
+    const tz_cache_t *tz;
+    time_t start;
+    long minutes;
+    uint64_t checksum; // Keeps the compiler from dropping the work
+} job_t;
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *encode_job(void *args){
+    job_t *j = (job_t *)args;
+    dcf77_frame_t buf[CHUNK];
+    uint64_t sum = 0;
+    for (long done = 0; done < j->minutes; done += CHUNK) {
+        const long n = (j->minutes - done) < CHUNK ? (j->minutes - done) : CHUNK;
+        dcf77_encode_range(j->start + (time_t)done * 60, (size_t)n, j->tz, 0, buf);
+        for (long i = 0; i < n; ++i) sum ^= buf[i];
+    }
+    j->checksum = sum;
+    return NULL;
+}
+
+static double run(const tz_cache_t *tz, time_t start, long minutes, int threads){
+    pthread_t tid[threads];
+    job_t jobs[threads];
+    const long per = minutes / threads;
+
+    const double t0 = now_s();
+    for (int i = 0; i < threads; ++i) {
+        jobs[i] = (job_t){ .tz = tz, .start = start + (time_t)(i * per) * 60, .minutes = (i == threads - 1) ? minutes - per * i : per };
+        pthread_create(&tid[i], NULL, encode_job, &jobs[i]);
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(tid[i], NULL);
+        sum ^= jobs[i].checksum;
+    }
+    const double dt = now_s() - t0;
+
+    const double fps = (double)minutes / dt;
+    printf("threads=%-3d frames=%ld seconds=%.3f frames_per_sec=%.0f checksum=%016llx\n", threads, minutes, dt, fps, (unsigned long long)sum);
+    return fps;
+}
+
+int main(int argc, char *argv[]){
+    long long minutes = DEFAULT_MINUTES;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((argc > 1 && parse_ll(argv[1], 1, LONG_MAX, &minutes) < 0) || (argc > 2 && parse_int(argv[2], 1, INT_MAX, &threads) < 0)) {
+        fprintf(stderr, "Usage: %s [minutes] [threads]   (Default: %ld, all cores)\n", argv[0], DEFAULT_MINUTES);
+        return 1;
+    }
+
+    tz_cache_t tz;
+    if (tz_cache_init(&tz, TZ_DEFAULT_ZONE, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+        tz_cache_init_rules(&tz, TZ_DEFAULT_ZONE, 3600, &startRule, &endRule, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+    }
+
+    const time_t start = 946684800; // 2000-01-01 00:00 UTC
+    const double one = run(&tz, start, minutes, 1);
+    if (threads > 1) {
+        const double all = run(&tz, start, minutes, threads);
+        printf("scaling=%.2fx\n", all / one);
+    }
+
+    tz_cache_free(&tz);
+    return 0;
+}
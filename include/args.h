@@ -11,20 +11,63 @@ extern "C" {
 #define SET_LOCAL 0x0
 #define SET_NTP 0x1
 
+// Run events (parser_t.events bits), each followed by a write to parser_t.evfd
+#define RUN_EV_DONE    0x1 // data_tx() finished
+#define RUN_EV_STOP    0x2 // SIGINT/SIGTERM
+#define RUN_EV_RESTART 0x4 // SIGHUP: restart the modulator
+
+#define MOD_CPU 0x0 // RT thread toggles the attenuator at every edge
+#define MOD_PIO 0x1 // PIO state machine times the edges from per-second FIFO words
+
+struct tx_backend;
+struct rt_metrics;
+struct tx_clock;
+struct rt_profile;
+struct tx_disc_cfg;
+struct tx_disc;
+struct tx_chan;
+struct tx_live;
+struct flight_rec;
+
 typedef struct parser{
-    uint8_t t_src; 
+    _Atomic uint8_t t_src; // Control socket may switch it
     int t_lim;
+    uint8_t daemon;        // No time limit
     int t_toff;
-    uint8_t verbose;
+    const char *zone;
+    struct tx_chan *chan; // Resolved channel list (always at least one)
+    int n_chan;
+    const char *ntp_servers;
+    _Atomic uint8_t verbose;
+    uint8_t backend_sel;
+    const char *trace_path;
+    struct tx_backend *backend;
+    uint8_t mod_sel;
+    uint8_t clock_sel;
+    uint8_t have_start;
+    time_t start;
+    struct tx_clock *clock;
+    const char *metrics_path;
+    struct rt_metrics *metrics;
+    const char *control_path;
+    struct tx_live *live;     // Settings the control socket changes at minute boundaries
+    _Atomic uint8_t carrier_on;
+    const char *rec_path;
+    struct flight_rec *rec;   // Flight recorder, NULL when off
+    uint8_t keep_carrier; // SIGHUP restarts the modulator only
+    uint8_t check_only;   // Self-check and calibration, then exit
+    struct rt_profile *rt;
+    struct tx_disc_cfg *disc_cfg;
+    struct tx_disc *disc; // Running time discipline, NULL when off
     atomic_bool *stop_thread;
-    pthread_mutex_t *lck;
-    pthread_cond_t *ext;
-    int *exit;
+    atomic_int *events;
+    int evfd;             // eventfd main() blocks on
 } parser_t;
 
-int parse_arguments(int argc, char *argv[], parser_t *out);
+// Raise run events from any thread or a signal handler (async-signal-safe)
+void run_event(parser_t *t_args, int ev);
 
-void verbose_time(time_t t);
+int parse_arguments(int argc, char *argv[], parser_t *out);
 
 #ifdef __cplusplus
 }
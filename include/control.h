@@ -0,0 +1,47 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Control socket: line-based commands on a Unix stream socket, served by a low-priority thread.
+Each reply ends with "ok" or "error: <reason>". Transmission settings change at the next minute boundary.
+  status                       state of the transmitter, one key=value per line
+  offset <minutes> [channel]   transmitted time offset (all channels by default)
+  source local|ntp             time source of the discipline
+  verbose 0|1
+  window off|HH:MM-HH:MM,...   UTC transmit windows, carrier off outside them (-M cpu only)
+  help
+*/
+
+#define CTL_LINE_MAX 256
+#define CTL_REPLY_MAX 4096
+#define CTL_IDLE_MS 30000 // A client silent this long is dropped
+
+struct parser;
+
+typedef struct tx_ctl_srv {
+    struct parser *cli;
+    int fd;
+    int wake_fd; // eventfd: tx_ctl_stop() ends the accept wait and the client being served
+    pthread_t tid;
+    char path[108];
+} tx_ctl_srv_t;
+
+// Run one command line, reply written to out (truncated to len); returns the reply length
+size_t tx_ctl_exec(struct parser *cli, const char *line, char *out, size_t len);
+
+int tx_ctl_start(tx_ctl_srv_t *srv, struct parser *cli, const char *path);
+void tx_ctl_stop(tx_ctl_srv_t *srv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
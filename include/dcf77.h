@@ -2,6 +2,8 @@
 #define DCF77_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,20 +25,24 @@ typedef struct DSTRule{
 #define Carrier_MOD 0x0
 #define Carrier 0x1
 
+// Bits 0-58 as transmitted, bit 60 = leap second minute marker
+typedef uint64_t dcf77_frame_t;
+
 extern uint64_t minute_frame;
 
-extern DSTRule_t startRule;
-extern DSTRule_t endRule;
+extern const DSTRule_t startRule;
+extern const DSTRule_t endRule;
+
+struct tz_cache;
 
 // Sakamoto last Sunday math: Returns the date of the last Sunday of a given month
 int weekday(int y, int m, int d);
 int get_last_sunday(int year, int month);
 
-//DST EU date switch calculator
-void calculate_dst_flag(struct tm *t);
+//Transmitted time zone (see tz_cache.h); offset, DST and switch announcement come from its table
+void dcf77_set_zone(const struct tz_cache *tz);
+const struct tz_cache *dcf77_zone(void);
 
-//Flag toggle 1hr before event
-uint8_t toggle_calc(struct tm* t);
 //Leap second toggle
 uint8_t leap_calc(int hr, uint8_t active);
 
@@ -48,6 +54,12 @@ bit_mod_t set_modulation(int bit_second);
 
 void tx_block_prep (time_t t_min, uint8_t *ntp_leap);
 
+// Reentrant encoder: no shared state, no allocation. Frame sent during the minute starting at t_min (encodes t_min + 60)
+dcf77_frame_t dcf77_encode(time_t t_min, const struct tz_cache *tz, uint8_t ntp_leap);
+// count consecutive minutes starting at t_min into out[count]
+void dcf77_encode_range(time_t t_min, size_t count, const struct tz_cache *tz, uint8_t ntp_leap, dcf77_frame_t *out);
+bit_mod_t dcf77_modulation(dcf77_frame_t frame, int bit_second);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,98 @@
+#ifndef DISCIPLINE_H
+#define DISCIPLINE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rt_metrics;
+
+/*
+Time discipline: edges are scheduled on CLOCK_MONOTONIC through a UTC mapping
+  utc = utc0 + (mono - mono0) * (1 + rate)
+that a low-priority thread re-anchors after every sample of the time source. Re-anchoring keeps the
+mapping continuous, so source steps are slewed out (at most slew ppm) instead of landing in the deadlines.
+  rate = freq + phase / poll   freq: drift estimate (FLL), phase: last measured UTC error
+An error beyond step is stepped instead (the current frame may be corrupted).
+From -D "key=value,...":
+  poll=0        seconds between samples, 0 = 64 for ntp, 8 for local
+  bound=1000    UTC error (us) above which a sample counts as out of bound
+  slew=500      max phase slew (ppm)
+  step=500      error (ms) above which the mapping is stepped
+*/
+
+#define DISC_POLL_NTP 64
+#define DISC_POLL_LOCAL 8
+#define DISC_FREQ_MAX_PPB 500000LL // Anything beyond is a broken source, not a crystal
+#define DISC_FLL_GAIN 0.5
+
+typedef struct tx_disc_cfg {
+    uint8_t enabled;
+    uint32_t poll_s;
+    int64_t bound_ns;
+    int64_t slew_ppb;
+    int64_t step_ns;
+} tx_disc_cfg_t;
+
+// One reading of the time source: true UTC at monotonic time mono_ns; -1 if the source did not answer
+typedef int (*tx_disc_source_t)(void *arg, int64_t *utc_ns, int64_t *mono_ns, uint8_t *leap);
+
+typedef struct tx_disc {
+    // Mapping, published under a seqlock: the RT thread never blocks on the discipline thread
+    _Atomic uint32_t seq;
+    _Atomic int64_t mono0;
+    _Atomic int64_t utc0;
+    _Atomic double rate;
+    _Atomic int64_t leap_at; // Raw UTC of a pending leap second boundary (see leap_adjust())
+
+    tx_disc_cfg_t cfg;
+    tx_disc_source_t source; // Under lck once running (tx_disc_set_source())
+    void *source_arg;
+    uint8_t poll_auto;       // poll=0: follows the source
+    struct rt_metrics *metrics;
+
+    // Discipline thread only
+    double freq;             // Drift estimate (fraction)
+    int64_t last_mono;
+    uint8_t slew_clamped;    // Last phase correction was limited: its residual is not drift
+    _Atomic uint8_t leap;
+    _Atomic int64_t last_err_ns;
+    _Atomic uint64_t samples, misses, out_of_bound, steps;
+
+    pthread_t tid;
+    pthread_mutex_t lck;
+    pthread_cond_t wake;
+    uint8_t stop;
+    uint8_t resample;        // Take a sample now
+    uint8_t running;
+} tx_disc_t;
+
+void tx_disc_cfg_defaults(tx_disc_cfg_t *cfg);
+// "off" or key=value list; -1 (message on stderr) on an unknown key or bad value
+int tx_disc_cfg_parse(tx_disc_cfg_t *cfg, const char *spec);
+
+// Sources: CLOCK_REALTIME as kept by the system (steps get slewed), or NTP (arg: server list)
+int tx_disc_source_local(void *arg, int64_t *utc_ns, int64_t *mono_ns, uint8_t *leap);
+int tx_disc_source_ntp(void *arg, int64_t *utc_ns, int64_t *mono_ns, uint8_t *leap);
+
+// Anchors the mapping on a first sample (-1 if the source fails), then starts the discipline thread
+int tx_disc_start(tx_disc_t *d, const tx_disc_cfg_t *cfg, tx_disc_source_t src, void *arg, struct rt_metrics *m);
+void tx_disc_stop(tx_disc_t *d);
+// Switch the time source of a running discipline and sample it right away; the difference is slewed like any error
+void tx_disc_set_source(tx_disc_t *d, tx_disc_source_t src, void *arg);
+
+// Controller step for one sample (discipline thread, or tools driving it directly)
+void tx_disc_update(tx_disc_t *d, int64_t utc_ns, int64_t mono_ns);
+
+int64_t tx_disc_utc(tx_disc_t *d, int64_t mono_ns);
+int64_t tx_disc_mono(tx_disc_t *d, int64_t utc_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef FLIGHT_REC_H
+#define FLIGHT_REC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "tx_chan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Flight recorder: every attenuator edge goes into a fixed ring in a shared file (/dev/shm), written by the RT loop
+with plain stores, no locks and no syscalls. The file outlives the transmitter, and readers (dcf77-trace) map it
+read-only: a per-entry sequence number tells a half-written entry from a complete one, so attaching never
+disturbs the writer.
+*/
+
+#define FR_MAGIC "DCF77FR1"
+#define FR_VERSION 1
+#define FR_RECORDS (1u << 18) // Power of two; ~36 hours of one DCF77 channel
+#define FR_DEFAULT_PATH "/dev/shm/dcf77.rec"
+
+typedef struct fr_entry {
+    _Atomic uint64_t seq; // 2n + 2 once entry n is complete, odd while it is written
+    int64_t deadline_ns;  // Intended edge time, CLOCK_REALTIME ns
+    int64_t actual_ns;    // Time the edge was applied, 0 = timed by the PIO modulator
+    uint64_t frame;       // tc_frame_t of the minute (a, TC_LEAP_MINUTE included)
+    uint64_t frame_b;
+    uint8_t sec;          // Second within the minute
+    uint8_t state;        // Carrier_MOD / Carrier
+    uint8_t chan;
+    uint8_t reserved[5];
+} fr_entry_t;
+
+typedef struct fr_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+    uint32_t capacity;
+    uint8_t n_chan;
+    uint8_t reserved[3];
+    char proto[TX_MAX_CHANNELS][8]; // tc_proto_t name per channel
+    int64_t started_ns;
+    _Atomic uint64_t head;          // Entries written so far; entry n lives at n % capacity
+} fr_header_t;
+
+typedef struct flight_rec {
+    fr_header_t *hdr;
+    fr_entry_t *ring;
+    size_t map_len;
+    uint32_t mask;
+    uint64_t head; // Writer's copy of hdr->head
+} flight_rec_t;
+
+// Writer: create the file, an existing one moved to <path>.prev, and map it with every page populated; -1 on failure
+int fr_open(flight_rec_t *fr, const char *path, const tx_chan_t *chan, int n_chan);
+// Reader: map an existing recorder read-only; -1 on failure or a foreign file
+int fr_attach(flight_rec_t *fr, const char *path);
+void fr_close(flight_rec_t *fr);
+
+// RT path: a handful of stores into locked, prefaulted memory
+static inline void fr_record(flight_rec_t *fr, int64_t deadline_ns, int64_t actual_ns, uint64_t frame, uint64_t frame_b,
+                             uint8_t sec, uint8_t state, uint8_t chan){
+    const uint64_t n = fr->head;
+    fr_entry_t *e = &fr->ring[n & fr->mask];
+    atomic_store_explicit(&e->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    e->deadline_ns = deadline_ns;
+    e->actual_ns = actual_ns;
+    e->frame = frame;
+    e->frame_b = frame_b;
+    e->sec = sec;
+    e->state = state;
+    e->chan = chan;
+    atomic_store_explicit(&e->seq, 2 * n + 2, memory_order_release);
+    fr->head = n + 1;
+    atomic_store_explicit(&fr->hdr->head, n + 1, memory_order_release);
+}
+
+// Reader: copy entry n; 0 if it was overwritten or is being written
+int fr_read(const flight_rec_t *fr, uint64_t n, fr_entry_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/types.h>
 #include <stdatomic.h>
 #include <pthread.h>
 
@@ -17,6 +18,8 @@ extern "C" {
 
 typedef struct tx_ctx tx_ctx_t;
 
+tx_ctx_t *tx_ctx_new(void);
+void tx_ctx_free(tx_ctx_t *ctx);
 
 void gpio_cleanup(tx_ctx_t *ctx);
 void tx_chip_close(tx_ctx_t *ctx);
@@ -30,6 +33,12 @@ void gpio_in(tx_ctx_t *txt);
 void gpio_out(tx_ctx_t *txt);
 void gpio_clr(tx_ctx_t *txt);
 void tx_send(uint8_t state, tx_ctx_t *txt);
+void tx_send_legacy(uint8_t state, tx_ctx_t *txt);
+
+// Edge engine: request the line once (Hi-Z), then switch Hi-Z <-> drive LOW with one reconfigure per edge
+int tx_edge_open(tx_ctx_t *ctx, unsigned int gpio_line);
+int tx_edge_set(tx_ctx_t *ctx, uint8_t state);
+void tx_edge_close(tx_ctx_t *ctx);
 
 /*--------------------------- ATTENUATOR GPIO CONTROL DEFINITIONS ------------------------*/
 
@@ -42,23 +51,71 @@ void tx_send(uint8_t state, tx_ctx_t *txt);
 #define CLOCK_FREQ 200000000.0
 #define CARRIER_PIN 18U
 
-// PIO Assembly, Compatible with RP2040 Instruction Set: Datasheet - https://pip-assets.raspberrypi.com/categories/814-rp2040/documents/RP-008371-DS-1-rp2040-datasheet.pdf Section 3.4
+// PIO Assembly, Compatible with RP2040 Instruction Set. High delay from ISR, low delay from OSR: Datasheet - https://pip-assets.raspberrypi.com/categories/814-rp2040/documents/RP-008371-DS-1-rp2040-datasheet.pdf Section 3.4
 extern const uint16_t carrier_freq_program_instructions[];
 
 typedef struct clk_vals{
-    uint32_t loops;
+    uint32_t loops;      // High half delay loops
+    uint32_t loops_low;  // Low half delay loops
+    uint16_t div_int;    // Divider as programmed: div_int + div_frac / 256
+    uint8_t div_frac;
+    uint8_t jitter_clk;  // Period jitter of the FRAC dither pattern, system clocks
     double clk_div_ideal;
     double clk_div_real;
     double f_actual;
-    double err;
+    double err;          // |f_actual - f_target|, Hz
+    double err_ppb;      // (f_actual - f_target) / f_target
+    double duty;         // High time / period
 } clk_vals_t;
 
+// Build-time planner table (generated/carrier_table.h)
+typedef struct carrier_plan_entry {
+    double f_pio;
+    double f_target;
+    uint32_t loops;
+    uint32_t loops_low;
+    uint16_t div_int;
+    uint8_t div_frac;
+} carrier_plan_entry_t;
+
+#define CARRIER_DUTY_TOL 0.001 // Planner: |duty - 50%| allowed for asymmetric loops
+// PIO clock rates precomputed at build time (RP1 runs its PIO at 200 MHz; RP2040/RP2350 defaults)
+#define CARRIER_PLAN_CLOCKS { 200000000.0, 125000000.0, 133000000.0, 150000000.0 }
+#define CARRIER_PLAN_TARGETS { TARGET_HZ, 60000.0, 40000.0 } // DCF77, MSF/WWVB/JJY60, JJY
+
 
 struct pio_instance;
 struct pio_program;
 
+// Claimed carrier state machine (hw backend)
+typedef struct pio_carrier {
+    struct pio_instance *pio;
+    int sm;
+    uint offset;
+} pio_carrier_t;
+
+// Claimed modulator state machine: drives the attenuator pin itself (see modulator.h)
+typedef struct pio_mod {
+    struct pio_instance *pio;
+    int sm;
+    uint offset;
+} pio_mod_t;
+
 void pio_cleanup(struct pio_instance **pio_driver,int *sm_r, uint *sm_off,  struct pio_program prog);
+int pio_carrier_start(pio_carrier_t *car, unsigned int pin, const clk_vals_t *clock_settings);
+void pio_carrier_stop(pio_carrier_t *car);
+int pio_mod_start(pio_mod_t *mod, unsigned int pin);
+void pio_mod_put(pio_mod_t *mod, uint32_t word); // Blocks while the TX FIFO is full
+uint pio_mod_level(pio_mod_t *mod);
+void pio_mod_stop(pio_mod_t *mod, unsigned int pin);
 clk_vals_t find_best(double f_pio, double f_target, uint32_t Loops_min, uint32_t Loops_max);
+// Frequency/duty of given settings; period = (loops + 3) + (loops_low + 3) cycles
+clk_vals_t carrier_plan_eval(double f_pio, double f_target, uint32_t loops, uint32_t loops_low, uint16_t div_int, uint8_t div_frac);
+// Every period length with near-even high/low split and both neighbouring 1/256 dividers: least error,
+// then no FRAC jitter, then duty closest to 50%
+clk_vals_t carrier_plan_search(double f_pio, double f_target);
+// Precomputed plan when (f_pio, f_target) is in the build-time table, else carrier_plan_search()
+clk_vals_t carrier_plan(double f_pio, double f_target, int *from_table);
 
 /*--------------------------- PIO CARRIER GPIO CONTROL DEFINITIONS ------------------------*/
 
@@ -68,8 +125,9 @@ clk_vals_t find_best(double f_pio, double f_target, uint32_t Loops_min, uint32_t
 /*--------------------------- THREAD  DEFINITIONS ------------------------*/
 
 void clk_delay(struct timespec tm);
-void  thread_setup(pthread_t thread, int core);
-void* carrier_conf(void *args);
+int thread_create_low(pthread_t *tid, void *(*fn)(void *), void *arg);
+int carrier_setup(void *args);    // One shot: plan and start the carrier, nothing keeps running
+void carrier_shutdown(void *args);
 void* data_tx(void *args);
 
 /*--------------------------- THREAD  DEFINITIONS ------------------------*/
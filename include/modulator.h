@@ -0,0 +1,65 @@
+#ifndef MODULATOR_H
+#define MODULATOR_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "schedule.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+PIO-side modulator: a second state machine owns the attenuator pin and times every edge itself.
+The CPU pushes one 32-bit word per second, X (attenuation loop) in the low half and Y (full carrier
+loop) in the high half; the joined TX FIFO holds MOD_FIFO_DEPTH seconds of look-ahead.
+
+  pull -> out X -> out Y -> jmp !X -> set pindirs 0 (Hi-Z) ... set pindirs 1 (LOW) ... next pull
+  Same polarity as tx_send(): Hi-Z = Carrier_MOD (attenuated), driven LOW = Carrier.
+  attenuation = X + 2 ticks, period = X + Y + 8 ticks (minute mark, X == 0: period = Y + 6)
+*/
+
+#define MOD_CLKDIV 20000U          // 200 MHz / 20000 = 10 kHz state machine clock
+#define MOD_TICK_NS 100000LL       // One modulator cycle = 100us
+#define MOD_TICKS_SEC 10000U       // Cycles per second
+#define MOD_LEAD_TICKS 4U          // Cycles from the pull to the attenuation edge
+#define MOD_PROGRAM_LEN 8
+#define MOD_FIFO_DEPTH 8           // TX FIFO joined with RX
+#define MOD_MAX_SECONDS 61         // Leap second minute
+#define MOD_PREROLL_NS 500000000LL // First word is aligned from this far ahead
+#define MOD_TRIM_MAX 10            // Max drift correction per minute (ticks)
+#define MOD_TRIM_SAMPLES 10        // Phase observations needed before trimming
+
+extern const uint16_t modulator_program_instructions[];
+
+// Word for one second: att_ticks == 0 (minute mark) or >= 3, period_ticks >= att_ticks + 6
+int mod_word(uint32_t att_ticks, uint32_t period_ticks, uint32_t *word);
+uint32_t mod_word_att_ticks(uint32_t word);
+uint32_t mod_word_period_ticks(uint32_t word);
+
+// Words for a compiled minute (60, or 61 with a leap second), trim_ticks added to the last second.
+// due[s] = CLOCK_REALTIME second the word starts at (the inserted leap second repeats :59)
+// -1 if the minute has an edge the program cannot time (see tc_att_from_start()) or more than one channel
+int mod_compile_minute(const tx_minute_t *m, int32_t trim_ticks, uint32_t *words, time_t *due);
+
+/*
+Drift trim: the RP1 crystal and the NTP disciplined system clock drift apart by a few ppm.
+Each phase sample is (time a blocked push returned) - (expected pull of the word that made room);
+wake-up latency only ever adds to it, so the per-minute minimum is the best phase estimate.
+*/
+typedef struct mod_trim {
+    int64_t min_phase_ns;
+    uint32_t samples;
+} mod_trim_t;
+
+void mod_trim_reset(mod_trim_t *t);
+void mod_trim_observe(mod_trim_t *t, int64_t phase_ns);
+// Ticks to add to the next minute (negative: modulator is late), starts a new window
+int32_t mod_trim_take(mod_trim_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
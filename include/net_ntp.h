@@ -1,34 +1,77 @@
 #ifndef NET_NTP_H
 #define NET_NTP_H
 
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // NTP uses 1900 as the epoch, Unix uses 1970. Difference is 70 years in seconds.
 #define NTP_TIMESTAMP_DELTA 2208988800ull
-#define HOSTNAME "pool.ntp.org"
+#define NTP_DEFAULT_SERVERS "0.pool.ntp.org,1.pool.ntp.org,2.pool.ntp.org,3.pool.ntp.org"
+#define NTP_PORT "123"
+#define NTP_MAX_SERVERS 8
+#define NTP_TIMEOUT_MS 2000  // Whole query: name resolution and every server
+#define NTP_RETRY_MS 500     // Unanswered servers get another request this often
 
 typedef struct {
     uint8_t li_vn_mode;      // LI (2b), VN (3b), Mode (3b)
-    uint8_t stratum;         
-    uint8_t poll;            
-    uint8_t precision;       
-    uint32_t rootDelay;      
-    uint32_t rootDispersion; 
-    uint32_t refId;          
-    uint32_t refTm_s;        
-    uint32_t refTm_f;        
-    uint32_t origTm_s;       
-    uint32_t origTm_f;       
-    uint32_t rxTm_s;         
-    uint32_t rxTm_f;         
+    uint8_t stratum;
+    uint8_t poll;
+    uint8_t precision;
+    uint32_t rootDelay;
+    uint32_t rootDispersion;
+    uint32_t refId;
+    uint32_t refTm_s;
+    uint32_t refTm_f;
+    uint32_t origTm_s;
+    uint32_t origTm_f;
+    uint32_t rxTm_s;
+    uint32_t rxTm_f;
     uint32_t txTm_s;         // Transmit Timestamp Seconds
     uint32_t txTm_f;         // Transmit Timestamp Fractions
 } ntp_packet;
 
+/*
+One server's answer, all four timestamps on CLOCK_REALTIME ns:
+  T1 request sent, T2 server receive, T3 server transmit, T4 reply received (kernel timestamp)
+  offset = ((T2 - T1) + (T3 - T4)) / 2   (server - local)
+  delay  = (T4 - T1) - (T3 - T2)
+*/
+typedef struct ntp_sample {
+    char server[64];
+    uint8_t valid;
+    uint8_t leap;            // LI: 0 none, 1 insert, 2 delete at the end of the UTC day
+    uint8_t stratum;
+    int64_t offset_ns;
+    int64_t delay_ns;
+    int64_t root_dist_ns;    // delay / 2 + root delay / 2 + root dispersion: error bound vs UTC
+    const char *error;       // Why !valid (static string)
+} ntp_sample_t;
 
 typedef struct {
-    time_t time_data;		
+    time_t time_data;        // UTC seconds at the time of the query (local clock + offset)
     uint8_t leap_sec;
+    int64_t offset_ns;       // UTC - CLOCK_REALTIME
+    int64_t delay_ns;
+    int64_t root_dist_ns;
+    int servers_ok;
+    char server[64];         // Source of the chosen sample
 } ret_ntp;
 
-ret_ntp *ntp_get();
+// Query every server of the comma separated list ("host", "host:port", "[v6]:port") in parallel,
+// one sample per server; returns the number of servers, -1 on a malformed list.
+// Thread safe. A name whose lookup outlived an earlier call is not looked up again until that lookup finishes
+int ntp_query(const char *servers, int timeout_ms, ntp_sample_t *samples, int max);
+// Index of the sample with the least root distance, -1 if none is valid
+int ntp_best(const ntp_sample_t *samples, int n);
+// ntp_query() + ntp_best(); -1 if no server answered in time
+int ntp_get(const char *servers, int timeout_ms, ret_ntp *out);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
\ No newline at end of file
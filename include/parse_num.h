@@ -0,0 +1,17 @@
+#ifndef PARSE_NUM_H
+#define PARSE_NUM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The whole string as a base 10 integer within [min, max]: 0, or -1 on no digits, trailing junk,
+// overflow or out of range (*out untouched)
+int parse_ll(const char *s, long long min, long long max, long long *out);
+int parse_int(const char *s, int min, int max, int *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef PIO_EMU_H
+#define PIO_EMU_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Software model of one PIO state machine (RP2040 datasheet section 3.4, same encoding on the RP1),
+for checking our hand-assembled programs without a Pi. Cycle accurate: one instruction (or delay/stall
+cycle) per state machine clock, and the clock itself follows the INT.FRAC fractional divider, so
+every cycle also carries its system clock timestamp.
+Supported: JMP (all conditions but PIN), OUT, IN, PULL/PUSH, MOV, SET, delay, wrap, pio_sm_exec().
+Not modelled: WAIT, IRQ, side-set, autopull/autopush, OUT/MOV EXEC.
+*/
+
+#define PIO_EMU_FIFO 8 // TX FIFO joined with RX
+
+struct pio_emu;
+// Called after the instruction in 'cycle' (at system clock 'sysclk') changed the pin outputs or directions
+typedef void (*pio_emu_watch_t)(void *arg, uint64_t cycle, uint64_t sysclk, uint32_t pins, uint32_t pindirs);
+
+typedef struct pio_emu {
+    const uint16_t *prog;
+    uint8_t len;
+    uint8_t wrap_target;
+    uint8_t wrap;
+    uint8_t pc;
+    uint8_t delay;        // Delay cycles still to burn
+    uint8_t out_right;    // OUT/IN shift direction: 1 = right
+    uint8_t osr_count;    // Bits shifted out of the OSR (32 = empty)
+    uint8_t isr_count;
+    uint8_t set_base, set_count;
+    uint8_t out_base, out_count;
+    uint8_t in_base;
+    uint32_t x, y, isr, osr;
+    uint32_t pins, pindirs; // Bit n = GPIO n
+    uint32_t tx[PIO_EMU_FIFO];
+    uint8_t tx_head, tx_level;
+    uint32_t rx_last;       // Last word pushed (RX FIFO is not modelled beyond that)
+    uint64_t rx_count;
+    uint64_t cycle;         // Cycles executed, stalls included
+    uint64_t sysclk;        // System clocks elapsed at the start of the current cycle
+    uint32_t div_int;       // Clock divider, 1..65536
+    uint8_t div_frac;       // 1/256ths
+    uint8_t frac_acc;
+    uint64_t stalls;
+    pio_emu_watch_t watch;
+    void *watch_arg;
+} pio_emu_t;
+
+// Program loaded at offset 0, pc = 0, OSR empty, shift right, clock divider 1
+void pio_emu_init(pio_emu_t *e, const uint16_t *prog, uint8_t len, uint8_t wrap_target, uint8_t wrap);
+void pio_emu_set_clkdiv_int_frac(pio_emu_t *e, uint16_t div_int, uint8_t div_frac);
+// Float divider converted like sm_config_set_clkdiv() does (truncated to 1/256)
+void pio_emu_set_clkdiv(pio_emu_t *e, float div);
+// Execute one instruction immediately, like pio_sm_exec(); -1 if unsupported or it would stall
+int pio_emu_exec(pio_emu_t *e, uint16_t ins);
+int pio_emu_put(pio_emu_t *e, uint32_t word); // -1 if the TX FIFO is full
+// One cycle; -1 on an unsupported instruction
+int pio_emu_step(pio_emu_t *e);
+// Until e->cycle reaches 'until' or an error
+int pio_emu_run(pio_emu_t *e, uint64_t until);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RT_METRICS_H
+#define RT_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed buckets (upper bounds, ns); the last bucket is +Inf
+#define RT_HIST_BUCKETS 16
+#define RT_HIST_BOUNDS_NS { 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, \
+                            1000000, 2000000, 5000000, 10000000, 50000000, 100000000 }
+
+// An edge applied later than this counts as a deadline miss
+#define RT_DEADLINE_MISS_NS 1000000LL // 1ms
+
+// Single writer (RT thread), any number of readers: relaxed atomics only, no locks
+typedef struct rt_hist {
+    _Atomic uint64_t bucket[RT_HIST_BUCKETS]; // Non-cumulative counts
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+} rt_hist_t;
+
+typedef struct rt_metrics {
+    rt_hist_t lateness;  // clk_delay() wake-up vs absolute edge deadline
+    rt_hist_t tx_send;   // Time spent applying the edge (backend att_set)
+    _Atomic uint64_t frames_sent;
+    _Atomic uint64_t deadline_misses;
+    _Atomic int64_t worst_late_ns;
+    _Atomic int64_t utc_error_ns;      // Last time discipline sample: source UTC - mapped UTC
+    _Atomic int64_t freq_ppb;          // Drift estimate of CLOCK_MONOTONIC vs the source
+    _Atomic uint64_t utc_out_of_bound; // Samples beyond the configured bound
+    _Atomic int64_t first_frame_ns;    // Transmitter start to the end of the first complete frame (last start)
+    _Atomic uint64_t log_dropped;      // Log records lost to a full ring or the rate limit (tx_log.h)
+    _Atomic uint64_t spin_ns;          // Hybrid wait (tx_clock.h): time spent spinning
+    _Atomic uint64_t spin_waits;
+    _Atomic uint64_t spin_overshoots;  // Sleeps that woke past the deadline they were spinning to
+    _Atomic int64_t spin_margin_ns;    // Current sleep-to-spin margin, 0 = no hybrid wait
+} rt_metrics_t;
+
+typedef struct rt_metrics_srv {
+    rt_metrics_t *m;
+    int fd;
+    pthread_t tid;
+    char path[108];
+} rt_metrics_srv_t;
+
+void rt_hist_observe(rt_hist_t *h, int64_t ns);
+
+// RT path: one call per attenuator edge
+void rt_metrics_edge(rt_metrics_t *m, int64_t late_ns, int64_t send_ns);
+void rt_metrics_frame(rt_metrics_t *m);
+
+// Prometheus text exposition format, returns bytes written (truncated to len)
+size_t rt_metrics_format(const rt_metrics_t *m, char *buf, size_t len);
+
+// Unix-socket endpoint (plain text or HTTP GET), served by a low-priority thread
+int rt_metrics_serve_start(rt_metrics_srv_t *srv, rt_metrics_t *m, const char *path);
+void rt_metrics_serve_stop(rt_metrics_srv_t *srv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
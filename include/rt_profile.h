@@ -0,0 +1,68 @@
+#ifndef RT_PROFILE_H
+#define RT_PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Real-time placement of the transmitter threads, from -R "key=value,..." or -R @file (one key=value per line, # comments).
+  main=2        core of main() (event handling)
+  tx=3          core of the edge thread (data_tx)
+  spin=-1       core reserved for busy-waiting edges; when set the edge thread runs there instead of tx and
+                waits for each deadline by sleeping, then spinning the last stretch (hybrid wait, tx_clock.h)
+  margin=0      hybrid wait: spin this long (us) before each deadline, 0 = adapt to the observed wake-up lateness
+  prio=99       SCHED_FIFO priority of both threads (main-prio=, tx-prio= set one), 0 = SCHED_OTHER
+  slack=0       timer slack (ns) for SCHED_OTHER threads, 0 = kernel default; SCHED_FIFO sleeps have none
+  calib=1000    startup latency calibration length (ms, one sample per ms), 0 = skip
+  budget=1000   edge timing budget (us) the calibration max must stay within
+  strict=0      1: refuse to transmit when a check fails
+*/
+
+#define RT_CORE_NONE -1
+#define RT_CALIB_INTERVAL_NS 1000000LL // cyclictest's default interval
+
+typedef struct rt_profile {
+    int main_core;
+    int tx_core;
+    int spin_core;
+    int64_t spin_margin_ns;
+    int main_prio;
+    int tx_prio;
+    uint32_t slack_ns;
+    uint32_t calib_ms;
+    int64_t budget_ns;
+    uint8_t strict;
+} rt_profile_t;
+
+typedef struct rt_calib {
+    uint32_t samples;
+    int64_t min_ns, avg_ns, p99_ns, max_ns;
+    int core, prio;
+    uint8_t setup_ok; // Pinning and priority took: otherwise the numbers are not the edge thread's
+} rt_calib_t;
+
+void rt_profile_defaults(rt_profile_t *p);
+// -1 on an unknown key, a bad value or an unreadable file (message on stderr)
+int rt_profile_parse(rt_profile_t *p, const char *spec);
+static inline int rt_profile_edge_core(const rt_profile_t *p){ return p->spin_core != RT_CORE_NONE ? p->spin_core : p->tx_core; }
+
+// Pin the calling thread, set its policy/priority and timer slack; -1 (reported on stderr) if any step failed
+int rt_thread_setup(int core, int prio, uint32_t slack_ns);
+
+// Host checks: cores online, edge core isolated (isolcpus, nohz_full), performance governor, memory locked,
+// calling thread scheduling class. Prints one line per check (failures only unless verbose); returns failures
+int rt_selfcheck(const rt_profile_t *p, int mlock_ok, int verbose, FILE *out);
+
+// Wake-up latency of the edge loop's timerfd wait (tx_clock.h) on the edge core at the edge thread's priority, like cyclictest -i 1000;
+// -1 if the thread or its timer could not run, 1 if max is within budget_ns, 0 otherwise
+int rt_calibrate(const rt_profile_t *p, rt_calib_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "tx_chan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCHED_CHAN_EDGES 256 // Up to TC_MAX_SEGS edges in each of 61 seconds
+#define SCHED_MAX_EDGES (SCHED_CHAN_EDGES * TX_MAX_CHANNELS)
+#define SCHED_RING 4        // Minutes compiled ahead of the RT thread
+#define SCHED_MAX_WINDOWS 4
+
+// One attenuator edge at an absolute time
+typedef struct tx_edge {
+    struct timespec at; // CLOCK_REALTIME deadline
+    uint8_t state;      // Carrier_MOD / Carrier as passed to tx_send()
+    uint8_t sec;        // Second within the minute
+    uint8_t chan;       // Index into the channel list
+} tx_edge_t;
+
+// A whole minute compiled to edges, every channel merged and sorted by deadline
+typedef struct tx_minute {
+    time_t minute_start;
+    uint32_t gen;       // tx_live_t generation it was compiled with
+    uint8_t idle;       // Outside every transmit window: no edges, carrier off
+    uint8_t n_chan;
+    uint64_t frame[TX_MAX_CHANNELS];   // tc_frame_t channel A (the DCF77 frame)
+    uint64_t frame_b[TX_MAX_CHANNELS]; // Channel B (MSF)
+    uint16_t n_edges;
+    tx_edge_t edge[SCHED_MAX_EDGES];
+} tx_minute_t;
+
+/*
+Settings that change while running (control socket). The producer applies them to every minute it compiles;
+each change bumps 'gen', and the consumer drops minutes compiled with an older generation, so a change
+reaches the air at the next minute boundary without a gap.
+*/
+typedef struct tx_live {
+    pthread_mutex_t lck;
+    _Atomic uint32_t gen;
+    int t_toff[TX_MAX_CHANNELS];
+    uint8_t n_win;                         // 0: transmit all day
+    uint16_t win_from[SCHED_MAX_WINDOWS];  // Minutes of the UTC day, [from, to), may wrap midnight
+    uint16_t win_to[SCHED_MAX_WINDOWS];
+    _Atomic int64_t on_air;                // Minute the RT thread is sending, 0 before the first
+} tx_live_t;
+
+void tx_live_init(tx_live_t *l, const tx_chan_t *chan, int n_chan);
+void tx_live_destroy(tx_live_t *l);
+// Writers hold l->lck around their changes, then call this
+void tx_live_commit(tx_live_t *l);
+int tx_live_window_on(const tx_live_t *l, time_t minute_start);
+
+/*
+Single producer (low priority compiler thread) / single consumer (RT thread) ring of minutes.
+The producer blocks on 'free' when it is SCHED_RING minutes ahead, the consumer on 'filled'.
+*/
+typedef struct tx_sched {
+    tx_minute_t slot[SCHED_RING];
+    _Atomic uint32_t head; // Next slot the producer fills
+    uint32_t tail;         // Next slot the consumer reads
+    sem_t filled;
+    sem_t free;
+    atomic_bool done;   // Producer finished (limit reached or stopped)
+    time_t next_minute; // Producer cursor
+    int remaining;      // Minutes still to compile, <0 = no limit
+    uint8_t leap;          // Indication not yet applied to a boundary
+    _Atomic uint8_t *leap_src; // NULL: only the indication given at start
+    uint8_t leap_src_last;
+    time_t leap_at;        // Boundary the armed indication belongs to, 0: none
+    uint8_t leap_armed;
+    const tx_chan_t *chan;
+    int n_chan;
+    tx_live_t *live;       // NULL: settings fixed at start
+    uint32_t gen;          // Producer: generation of the minutes it compiles
+    _Atomic int64_t taken; // Consumer: last minute handed to the RT thread
+    atomic_bool *stop;
+    atomic_bool quit;      // Set by sched_stop(): the consumer may have left without raising *stop
+    pthread_t tid;
+} tx_sched_t;
+
+// Compile every channel's frame for the minute on air from minute_start into one stream of absolute edges.
+// Channels with the same protocol, zone and offset share one encoded frame.
+int sched_compile_minute(const tx_chan_t *chan, int n_chan, time_t minute_start, uint8_t *leap, tx_minute_t *out);
+
+// leap_src (e.g. the discipline's indicator) is sampled every minute; the indication only reaches the air on
+// the last UTC day of a month, and a boundary consumes it
+int sched_start(tx_sched_t *s, const tx_chan_t *chan, int n_chan, tx_live_t *live, time_t first_minute, int minutes, uint8_t leap, _Atomic uint8_t *leap_src, atomic_bool *stop);
+// RT side: next compiled minute (blocks until ready), NULL once the producer is done
+const tx_minute_t *sched_next(tx_sched_t *s);
+// RT side: hand the slot returned by sched_next() back to the producer
+void sched_release(tx_sched_t *s);
+void sched_stop(tx_sched_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TIMECODE_H
+#define TIMECODE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "dcf77.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Time code descriptors: every supported station is a const table, the encoder and the schedule compiler
+are shared. A frame is one or two bits per second (channel A, and B for MSF); each second sends the symbol
+  sym[A | B << 1], or sym[TC_SYM_MARK] at marker positions
+and a symbol is a short list of attenuator edges within its second. The schedule turns those into the
+same tx_edge_t stream for every protocol, so the RT loop does not know which one it is sending.
+*/
+
+#define TC_MAX_SEGS 4
+#define TC_MAX_FIELDS 24
+#define TC_MAX_PARITY 4
+#define TC_SYM_MARK 4
+#define TC_NAMES "dcf77|msf|wwvb|jjy|jjy60"
+#define TC_LEAP_MINUTE (1ULL << 60) // Channel A: minute with an inserted leap second (61 seconds)
+
+// Values a field can carry, taken from the broken-down transmitted time
+enum tc_src {
+    TC_SRC_MIN,
+    TC_SRC_HOUR,
+    TC_SRC_MDAY,
+    TC_SRC_MON,
+    TC_SRC_YEAR,      // 0-99
+    TC_SRC_WDAY,      // 1-7, Monday = 1
+    TC_SRC_WDAY0,     // 0-6, Sunday = 0
+    TC_SRC_YDAY,      // 1-366
+    TC_SRC_DST,
+    TC_SRC_STD,
+    TC_SRC_ANNOUNCE,  // DST change within the next hour
+    TC_SRC_LEAP_HOUR, // Leap second at the end of this UTC hour
+    TC_SRC_LEAP_DAY,  // Leap second at the end of this UTC day
+    TC_SRC_DST_DAY0,  // DST in effect at 00:00 UTC today
+    TC_SRC_DST_DAY1,  // DST in effect at 24:00 UTC today
+    TC_SRC_LEAP_YEAR,
+    TC_SRC_COUNT
+};
+
+// BCD field: digits in transmission order, width[] bits each (0 ends the list), 'gap' unused bits between digits
+typedef struct tc_field {
+    uint8_t src;
+    uint8_t chan;      // 0 = A, 1 = B
+    uint8_t pos;       // First second
+    uint8_t msb_first; // Tens before units, 8 before 1; else units first, 1 before 8 (DCF77)
+    uint8_t gap;
+    uint8_t width[3];
+} tc_field_t;
+
+// Parity over channel A seconds [from, to], written to (sec, chan)
+typedef struct tc_parity {
+    uint8_t sec;
+    uint8_t chan;
+    uint8_t from;
+    uint8_t to;
+    uint8_t odd;
+} tc_parity_t;
+
+// Edges within one second, ms after its start; the carrier stays in the last state into the next second
+typedef struct tc_symbol {
+    uint8_t n;
+    struct { uint16_t ms; uint8_t state; } seg[TC_MAX_SEGS];
+} tc_symbol_t;
+
+typedef struct tc_proto {
+    const char *name;
+    double carrier_hz;     // Fed to the carrier planner
+    const char *zone;      // Default transmitted zone
+    int32_t std_offset;    // Built-in rules when the system has no tzfile for 'zone'
+    const DSTRule_t *dst_start, *dst_end; // NULL: no DST
+    uint8_t next_minute;   // The frame sent during minute t encodes t + 60 (else t)
+    uint8_t utc_fields;    // Time fields in UTC, the zone only feeds the DST bits
+    uint8_t leap_insert;   // Leap minutes get a 61st second: '0' at 59, the last symbol at 60
+    uint64_t const_a;      // Fixed '1' bits
+    uint64_t const_b;
+    uint64_t markers;      // Seconds sending sym[TC_SYM_MARK]
+    uint8_t n_fields;
+    tc_field_t field[TC_MAX_FIELDS];
+    uint8_t n_parity;
+    tc_parity_t parity[TC_MAX_PARITY]; // Applied in order, after every field
+    tc_symbol_t sym[TC_SYM_MARK + 1];
+} tc_proto_t;
+
+// Bits 0-59 per second; TC_LEAP_MINUTE in 'a' as in dcf77_frame_t
+typedef struct tc_frame {
+    uint64_t a;
+    uint64_t b;
+} tc_frame_t;
+
+extern const tc_proto_t tc_dcf77, tc_msf, tc_wwvb, tc_jjy, tc_jjy60;
+
+// By name ("dcf77", "msf", "wwvb", "jjy", "jjy60"), NULL if unknown
+const tc_proto_t *tc_find(const char *name);
+
+// Transmitted protocol, set once at startup (default DCF77)
+void tc_set_proto(const tc_proto_t *p);
+const tc_proto_t *tc_proto(void);
+
+// Reentrant: frame sent during the minute starting at t_min; ntp_leap: NTP leap indicator (1 = insert)
+tc_frame_t tc_encode(const tc_proto_t *p, time_t t_min, const struct tz_cache *tz, uint8_t ntp_leap);
+// Field values back from a frame (v[] indexed by enum tc_src, 0 where the protocol has no such field); -1 on a parity error
+int tc_decode(const tc_proto_t *p, const tc_frame_t *f, unsigned v[TC_SRC_COUNT]);
+// Seconds in the frame: 60, or 61 with an inserted leap second
+int tc_seconds(const tc_frame_t *f);
+const tc_symbol_t *tc_symbol(const tc_proto_t *p, const tc_frame_t *f, int sec);
+// Every symbol is "attenuate from the start of the second, then full carrier" (what the PIO modulator runs)
+int tc_att_from_start(const tc_proto_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
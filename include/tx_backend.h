@@ -0,0 +1,86 @@
+#ifndef TX_BACKEND_H
+#define TX_BACKEND_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "hw_conf.h"
+#include "tx_clock.h"
+#include "tx_chan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TX_BACKEND_HW 0x0
+#define TX_BACKEND_VIRTUAL 0x1
+
+/*
+Transmitter backend: everything data_tx() and carrier_setup() need from the output stage.
+'ch' is the transmit channel (tx_chan.h), 0 to TX_MAX_CHANNELS - 1, each with its own pins.
+  carrier_start/stop: carrier on 'pin' on/off with the settings from carrier_plan()
+  att_open/close:     claim/release the channel's attenuator line (left in Hi-Z)
+  att_set:            attenuator edge, state as in tx_send(); deadline = intended edge time (CLOCK_REALTIME)
+  mod_start/push/stop: optional PIO-side modulator (NULL if unsupported), replaces att_* when used, one channel only.
+                      mod_push: one word per second (modulator.h), due = CLOCK_REALTIME second it starts;
+                      blocks while the FIFO is full, *phase_ns = observed modulator phase error or INT64_MIN.
+                      mod_stop: drain = let the pushed seconds play out first
+*/
+typedef struct tx_backend tx_backend_t;
+struct tx_backend {
+    const char *name;
+    void *priv;
+    tx_clock_t *clock; // Time source for event timestamps (set by the owner)
+    int  (*carrier_start)(tx_backend_t *be, int ch, unsigned int pin, const clk_vals_t *clk);
+    void (*carrier_stop)(tx_backend_t *be, int ch);
+    int  (*att_open)(tx_backend_t *be, int ch, unsigned int gpio_line);
+    int  (*att_set)(tx_backend_t *be, int ch, uint8_t state, const struct timespec *deadline);
+    void (*att_close)(tx_backend_t *be, int ch);
+    int  (*mod_start)(tx_backend_t *be, unsigned int gpio_line);
+    int  (*mod_push)(tx_backend_t *be, uint32_t word, const struct timespec *due, int64_t *phase_ns);
+    void (*mod_stop)(tx_backend_t *be, int drain);
+    void (*destroy)(tx_backend_t *be);
+};
+
+/*--------------------------- VIRTUAL BACKEND TRACE ------------------------*/
+
+// File: tx_trace_hdr_t followed by tx_trace_rec_t records, host byte order
+#define TX_TRACE_MAGIC "DCF77TR1"
+#define TX_TRACE_VERSION 1U
+
+enum tx_trace_event {
+    TX_EV_CARRIER_START = 1,
+    TX_EV_CARRIER_STOP  = 2,
+    TX_EV_ATT_HIZ       = 3, // Attenuator released (Hi-Z): attenuated, Carrier_MOD
+    TX_EV_ATT_LOW       = 4  // Attenuator driven LOW: full carrier, Carrier
+};
+
+typedef struct tx_trace_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+} tx_trace_hdr_t;
+
+typedef struct tx_trace_rec {
+    int64_t deadline_ns; // Intended time, CLOCK_REALTIME ns (== actual_ns for carrier events)
+    int64_t actual_ns;   // Time the event was applied
+    uint8_t event;       // enum tx_trace_event
+    uint8_t chan;        // Transmit channel
+    uint8_t reserved[6];
+} tx_trace_rec_t;
+
+/*--------------------------- VIRTUAL BACKEND TRACE ------------------------*/
+
+// Virtual backend: no hardware access, records every event. trace_path may be NULL (summary only)
+tx_backend_t *tx_backend_virtual_new(const char *trace_path);
+
+// Raspberry Pi 5 backend: PIO carrier + libgpiod attenuator (only with DCF77_HAVE_HW)
+tx_backend_t *tx_backend_hw_new(void);
+
+void tx_backend_free(tx_backend_t *be);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef TX_CHAN_H
+#define TX_CHAN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Transmit channel: one carrier state machine and one attenuator line, sending its own time.
+Every channel's edges go through the same schedule and RT thread, so channels cost a PIO state machine
+and two pins each, not a thread. From -C "key=value,...":
+  carrier=18    carrier GPIO 0-27 (PIO state machine output)
+  att=23        attenuator GPIO 0-27
+  offset=0      minutes added to the transmitted time (Default: -o)
+  zone=name     IANA zone (Default: -z, else the protocol's)
+  proto=dcf77   time code (Default: -P)
+*/
+
+#define TX_MAX_CHANNELS 4 // RP1 PIO: four state machines
+
+struct tc_proto;
+struct tz_cache;
+
+typedef struct tx_chan {
+    unsigned int carrier_pin;
+    unsigned int att_pin;
+    int t_toff;
+    uint8_t have_toff;
+    char zone[64];                // Empty: -z / protocol default
+    const struct tc_proto *proto; // NULL: -P
+    const struct tz_cache *tz;    // Resolved at startup, shared by channels with the same zone
+} tx_chan_t;
+
+// -1 (message on stderr) on an unknown key or bad value
+int tx_chan_parse(tx_chan_t *c, const char *spec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef TX_CLOCK_H
+#define TX_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TX_CLOCK_REALTIME 0x0
+#define TX_CLOCK_VIRTUAL 0x1
+
+/*
+Time source of the transmit loop. Deadlines are absolute UTC timespecs.
+  realtime: CLOCK_REALTIME timerfd (absolute, re-armed when the clock is set)
+  virtual:  sleep_until() jumps straight to the deadline, so hours of transmission run in milliseconds
+  disciplined: CLOCK_MONOTONIC timerfd through the time discipline's UTC mapping (discipline.h); clock steps are slewed
+Realtime and disciplined sleeps wait in epoll on the timerfd and a wake eventfd, one sleeping thread at a time.
+tx_clock_wake() ends a sleep at once (or the next one, if none is under way) when *abort is set (NULL: sleep through);
+no signal is involved, so there is no window in which a stop request is missed.
+
+Hybrid wait (tx_clock_spin_init, RT profile spin=core): sleep_until() sleeps on the clock it wraps until a margin
+before the deadline, then spins on now() to it. With margin 0 the margin adapts: every TX_SPIN_WINDOW wake-ups it
+becomes the p99 lateness of the sleeps plus TX_SPIN_GUARD_NS, and a sleep that wakes past its deadline raises it at once.
+Spin time, wake-ups past the deadline and the margin go to rt_metrics.
+*/
+#define TX_SPIN_WINDOW 256
+#define TX_SPIN_BUCKETS 128
+#define TX_SPIN_BUCKET_NS 8000LL // Lateness histogram: 8us buckets up to 1.024ms
+#define TX_SPIN_GUARD_NS 10000LL
+#define TX_SPIN_MIN_NS 20000LL
+#define TX_SPIN_MAX_NS (TX_SPIN_BUCKETS * TX_SPIN_BUCKET_NS + TX_SPIN_GUARD_NS)
+#define TX_SPIN_INIT_NS 200000LL // Adaptive start without a calibration
+
+struct tx_disc;
+struct rt_metrics;
+typedef struct tx_clock tx_clock_t;
+
+typedef struct tx_spin {
+    void (*coarse)(tx_clock_t *clk, const struct timespec *deadline); // The wrapped clock's sleep
+    int64_t margin_ns;
+    int64_t started_ns;   // CLOCK_MONOTONIC at init, for the spinning share
+    uint8_t adaptive;
+    uint16_t n;           // Wake-ups in the current window
+    uint16_t hist[TX_SPIN_BUCKETS];
+    struct rt_metrics *m;
+} tx_spin_t;
+
+struct tx_clock {
+    const char *name;
+    void (*now)(tx_clock_t *clk, struct timespec *ts);
+    void (*sleep_until)(tx_clock_t *clk, const struct timespec *deadline);
+    _Atomic int64_t virt_ns; // Virtual clock position (UTC ns)
+    atomic_bool *abort;
+    struct tx_disc *disc;
+    tx_spin_t *spin;
+    int timer_fd;            // -1 on the virtual clock
+    int wake_fd;
+    int epoll_fd;
+};
+
+// -1 if the timer or epoll fds could not be created (reported on stderr)
+int tx_clock_realtime_init(tx_clock_t *clk);
+void tx_clock_virtual_init(tx_clock_t *clk, time_t start);
+int tx_clock_disciplined_init(tx_clock_t *clk, struct tx_disc *disc);
+void tx_clock_close(tx_clock_t *clk);
+// Any thread, after setting *abort: the sleeper returns
+void tx_clock_wake(tx_clock_t *clk);
+// Clears a wake nobody consumed, before the next sleeper starts
+void tx_clock_drain(tx_clock_t *clk);
+// Wraps an initialised realtime or disciplined clock; margin_ns 0 = adaptive from init_ns (0: TX_SPIN_INIT_NS)
+void tx_clock_spin_init(tx_clock_t *clk, tx_spin_t *sp, int64_t margin_ns, int64_t init_ns, struct rt_metrics *m);
+
+static inline int64_t tx_ts_ns(const struct timespec *ts){ return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec; }
+
+static inline int64_t tx_clock_ns(tx_clock_t *clk){
+    struct timespec ts;
+    clk->now(clk, &ts);
+    return tx_ts_ns(&ts);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
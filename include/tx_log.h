@@ -0,0 +1,64 @@
+#ifndef TX_LOG_H
+#define TX_LOG_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Log of the transmit thread. The thread that calls tx_log_bind() (data_tx) never formats or writes: it stores a
+fixed-size record into a single-producer ring and moves on, lock-free and without syscalls. A low-priority thread
+polls the ring, formats the records and writes them to stderr, at most TX_LOG_RATE per second; a record that finds
+the ring full or goes over the rate is dropped and counted. Any other thread, or any thread before tx_log_start()
+and after tx_log_stop(), formats its records in place.
+*/
+
+#define TX_LOG_RECORDS 1024 // Power of two
+#define TX_LOG_POLL_MS 20
+#define TX_LOG_RATE 200     // Records written per second, the rest are dropped
+
+typedef enum tx_log_ev {
+    TX_LOG_TEXT,        // msg
+    TX_LOG_ERRNO,       // msg: strerror(i), like perror()
+    TX_LOG_MINUTE,      // a[0] minute start, local time without a newline (verbose)
+    TX_LOG_SECOND,      // i second within the minute, rewrites the seconds of the minute line
+    TX_LOG_TRIM,        // i PIO modulator trim, ticks
+    TX_LOG_EOL,         // End of the minute line
+    TX_LOG_IDLE,        // a[0] minute start, outside every transmit window
+    TX_LOG_CARRIER,     // i channel, a[0] GPIO, a[1] carrier mHz: the carrier plan
+    TX_LOG_FIRST_FRAME, // a[0] transmitter start to the end of the first complete frame, ns
+    TX_LOG_NTP,         // i servers answered, a[0..2] offset/delay/root distance ns, s server; i 0: none within a[0] ms
+} tx_log_ev_t;
+
+typedef struct tx_log_rec {
+    uint16_t ev;
+    uint16_t reserved;
+    int32_t i;
+    const char *msg; // String literal, never copied
+    int64_t a[3];
+    char s[24];      // Short copied string, truncated
+} tx_log_rec_t;
+
+struct rt_metrics;
+
+// Writer thread; drops are also counted in m->log_dropped when m is set
+int tx_log_start(struct rt_metrics *m);
+// Writes what is left in the ring and joins the writer
+void tx_log_stop(void);
+// The calling thread's records go through the ring from now on
+void tx_log_bind(void);
+uint64_t tx_log_dropped(void);
+
+void tx_log_push(const tx_log_rec_t *r);
+void tx_log_ev(tx_log_ev_t ev, int32_t i, int64_t a0);
+void tx_log_msg(const char *msg);             // msg must be a string literal
+void tx_log_errno(const char *msg, int err);  // msg must be a string literal
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef TZ_CACHE_H
+#define TZ_CACHE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "dcf77.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TZ_DEFAULT_ZONE "Europe/Berlin"
+#define TZ_FIRST_YEAR 1970
+#define TZ_LAST_YEAR 2137
+#define TZ_MAX_TRANS 4      // Per UTC year (real zones have 0 or 2)
+#define TZ_ANNOUNCE_SECS 3600 // DCF77 A1: set during the hour before a change
+
+typedef struct tz_trans {
+    int64_t at;         // UTC instant of the change
+    int32_t utc_offset; // Offset from 'at' on
+    uint8_t is_dst;
+} tz_trans_t;
+
+typedef struct tz_year {
+    int32_t utc_offset; // In effect at Jan 1 00:00 UTC
+    uint8_t is_dst;
+    uint8_t n_trans;
+    tz_trans_t trans[TZ_MAX_TRANS];
+} tz_year_t;
+
+// Transition table for [first_year, last_year]; read-only once built, safe to share between threads
+typedef struct tz_cache {
+    char zone[64];
+    int first_year;
+    int last_year;
+    tz_year_t *year;
+} tz_cache_t;
+
+typedef struct tz_info {
+    int32_t utc_offset;
+    uint8_t is_dst;
+    uint8_t announce; // A change happens within the next TZ_ANNOUNCE_SECS
+} tz_info_t;
+
+// Broken-down local time, fields in the ranges the time codes use
+typedef struct tz_local {
+    int year;  // Full year
+    int mon;   // 1-12
+    int mday;  // 1-31
+    int hour;  // 0-23
+    int min;   // 0-59
+    int wday;  // 1-7, Monday = 1, Sunday = 7
+    int yday;  // 1-366
+    tz_info_t info;
+} tz_local_t;
+
+// Build from the system tzfile of 'zone' (probes localtime_r once per week of the range)
+int tz_cache_init(tz_cache_t *tz, const char *zone, int first_year, int last_year);
+// Build from fixed rules: std_offset seconds, +1h during [start, end) (rule hours in local time,
+// Sundays: week 5 = last, else n-th of the month); start/end NULL: no DST
+int tz_cache_init_rules(tz_cache_t *tz, const char *name, int32_t std_offset, const DSTRule_t *start, const DSTRule_t *end, int first_year, int last_year);
+void tz_cache_free(tz_cache_t *tz);
+
+// O(1): offset, DST and announce flag at UTC instant t
+tz_info_t tz_lookup(const tz_cache_t *tz, time_t t);
+void tz_localtime(const tz_cache_t *tz, time_t t, tz_local_t *out);
+
+// "YYYY-MM-DD[THH:MM]" (UTC) or "@epoch" -> time_t, 0 on success
+int tz_parse_utc(const char *s, time_t *out);
+
+// Proleptic Gregorian calendar helpers (days since 1970-01-01)
+int64_t tz_days_from_civil(int y, int m, int d);
+void tz_civil_from_days(int64_t z, int *y, int *m, int *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,31 +1,197 @@
 #include <errno.h>
-#include <sched.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <gpiod.h>
 
 #include "hw_conf.h"
-#include "net_ntp.h"
-#include "args.h"
-#include "dcf77.h"
+#include "tx_log.h"
 
 struct tx_ctx {
     struct gpiod_chip *chip;
+#ifdef DCF77_GPIOD_V2
+    struct gpiod_line_request *req;
+    struct gpiod_line_config *cfg_hiz; // Prebuilt configs so an edge is a single reconfigure ioctl
+    struct gpiod_line_config *cfg_low;
+    unsigned int offset;
+#else
     struct gpiod_line *line;
+#endif
     int mode; // 0 = Hi-Z (input), 1 = drive LOW (output low)
+    int held; // 1 = line requested once by tx_edge_open() and kept for the whole run
 };
 
-void clk_delay(struct timespec tm) {
-    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &tm, NULL) == EINTR) { fprintf(stderr, "Interrupted clk sleep\n"); }
+tx_ctx_t *tx_ctx_new(void){
+    return calloc(1, sizeof(tx_ctx_t));
+}
+
+void tx_ctx_free(tx_ctx_t *ctx){
+    free(ctx);
 }
 
 void gpio_cleanup(tx_ctx_t *ctx){
-    fprintf(stderr, "Shutting down GPIO carrier\n");
-    tx_line_close(ctx);
+    tx_log_msg("Shutting down GPIO carrier");
+    tx_edge_close(ctx);
     tx_chip_close(ctx);
 }
 
+#ifdef DCF77_GPIOD_V2
+/*--------------------------- libgpiod v2 ------------------------*/
+
+// Line config for a single offset: input (Hi-Z) or output driven to value
+static struct gpiod_line_config *line_cfg_new(unsigned int offset, int output, int value){
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+    struct gpiod_line_config *cfg = gpiod_line_config_new();
+    if (!settings || !cfg) goto fail;
+
+    if (output) {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+        gpiod_line_settings_set_output_value(settings, value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    } else {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+    }
+    if (gpiod_line_config_add_line_settings(cfg, &offset, 1, settings) < 0) goto fail;
+
+    gpiod_line_settings_free(settings);
+    return cfg;
+
+fail:
+    if (settings) gpiod_line_settings_free(settings);
+    if (cfg) gpiod_line_config_free(cfg);
+    return NULL;
+}
+
+static struct gpiod_line_request *line_request(tx_ctx_t *ctx, const char *consumer_label, struct gpiod_line_config *cfg){
+    struct gpiod_request_config *req_cfg = gpiod_request_config_new();
+    if (!req_cfg) return NULL;
+    gpiod_request_config_set_consumer(req_cfg, consumer_label);
+    struct gpiod_line_request *req = gpiod_chip_request_lines(ctx->chip, req_cfg, cfg);
+    gpiod_request_config_free(req_cfg);
+    return req;
+}
+
+int tx_chip_init(tx_ctx_t *ctx){
+    if (!ctx || !GPIO_CHIP) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx-> mode = 0;
+    ctx->chip = gpiod_chip_open("/dev/" GPIO_CHIP);
+    if (!ctx->chip) {
+        tx_log_errno("gpiod_chip_open", errno);
+        tx_chip_close(ctx);
+        return -1;
+    }
+    return 1;
+}
+
+// v2 has no per-line handle: remember the offset, the kernel object is created on request
+int tx_line_init(tx_ctx_t *ctx, unsigned int gpio_line){
+    ctx->offset = gpio_line;
+    return 1;
+}
+
+void tx_chip_close(tx_ctx_t *ctx){
+    if (!ctx) return;
+
+    tx_line_close(ctx);
+    if (ctx->cfg_hiz) {
+        gpiod_line_config_free(ctx->cfg_hiz);
+        ctx->cfg_hiz = NULL;
+    }
+    if (ctx->cfg_low) {
+        gpiod_line_config_free(ctx->cfg_low);
+        ctx->cfg_low = NULL;
+    }
+    if (ctx->chip) {
+        gpiod_chip_close(ctx->chip);
+        ctx->chip = NULL;
+    }
+    ctx->mode = 0;
+    ctx->held = 0;
+}
+
+void tx_line_close(tx_ctx_t *ctx){
+    if (!ctx) return;
+
+    if (ctx->req) {
+        gpiod_line_request_release(ctx->req);
+        ctx->req = NULL;
+    }
+}
+
+int tx_req_out(tx_ctx_t *ctx, const char *consumer_label, int idle_value){
+    struct gpiod_line_config *cfg = line_cfg_new(ctx->offset, 1, idle_value);
+    ctx->req = cfg ? line_request(ctx, consumer_label, cfg) : NULL;
+    if (cfg) gpiod_line_config_free(cfg);
+    if (!ctx->req) {
+        tx_log_errno("gpiod_chip_request_lines(output)", errno);
+        tx_line_close(ctx);
+        return -1;
+    }
+    ctx->mode = 1;
+    return 1;
+}
+
+int tx_req_in(tx_ctx_t *ctx, const char *consumer_label){
+    struct gpiod_line_config *cfg = line_cfg_new(ctx->offset, 0, 0);
+    ctx->req = cfg ? line_request(ctx, consumer_label, cfg) : NULL;
+    if (cfg) gpiod_line_config_free(cfg);
+    if (!ctx->req) {
+        tx_log_errno("gpiod_chip_request_lines(input)", errno);
+        tx_line_close(ctx);
+        return -1;
+    }
+    ctx->mode = 0;
+    return 1;
+}
+
+int tx_clr_bit(tx_ctx_t *ctx){
+    // "Clear" == drive low
+    if (gpiod_line_request_set_value(ctx->req, ctx->offset, GPIOD_LINE_VALUE_INACTIVE) < 0) {
+        tx_log_errno("gpiod_line_request_set_value(0)", errno);
+    }
+    tx_line_close(ctx);
+    return 1;
+}
+
+int tx_edge_open(tx_ctx_t *ctx, unsigned int gpio_line){
+    tx_line_init(ctx, gpio_line);
+    ctx->cfg_hiz = line_cfg_new(gpio_line, 0, 0);
+    ctx->cfg_low = line_cfg_new(gpio_line, 1, 0);
+    if (!ctx->cfg_hiz || !ctx->cfg_low) {
+        tx_log_errno("gpiod_line_config_new", errno);
+        return -1;
+    }
+    ctx->req = line_request(ctx, "dcf77-att", ctx->cfg_hiz);
+    if (!ctx->req) {
+        tx_log_errno("gpiod_chip_request_lines", errno);
+        return -1;
+    }
+    ctx->mode = 0;
+    ctx->held = 1;
+    return 1;
+}
+
+int tx_edge_set(tx_ctx_t *ctx, uint8_t state){
+    const int mode = state ? 1 : 0;
+    if (ctx->mode == mode) return 1;
+
+    if (gpiod_line_request_reconfigure_lines(ctx->req, mode ? ctx->cfg_low : ctx->cfg_hiz) < 0) {
+        tx_log_errno("gpiod_line_request_reconfigure_lines", errno);
+        return -1;
+    }
+    ctx->mode = mode;
+    return 1;
+}
+
+/*--------------------------- libgpiod v2 ------------------------*/
+#else
+/*--------------------------- libgpiod v1 ------------------------*/
+
 int tx_chip_init(tx_ctx_t *ctx){
     if (!ctx || !GPIO_CHIP) {
         errno = EINVAL;
@@ -36,7 +202,7 @@ int tx_chip_init(tx_ctx_t *ctx){
     ctx-> mode = 0;
     ctx->chip = gpiod_chip_open_by_name(GPIO_CHIP);
     if (!ctx->chip) {
-        perror("gpiod_chip_open_by_name");
+        tx_log_errno("gpiod_chip_open_by_name", errno);
         tx_chip_close(ctx);
         return -1;
     }
@@ -47,7 +213,7 @@ int tx_line_init(tx_ctx_t *ctx, unsigned int gpio_line){
     
     ctx->line = gpiod_chip_get_line(ctx->chip, (unsigned int)gpio_line);
     if (!ctx->line) {
-        perror("gpiod_chip_get_line");
+        tx_log_errno("gpiod_chip_get_line", errno);
         tx_line_close(ctx);
         return -1;
     }
@@ -66,6 +232,7 @@ void tx_chip_close(tx_ctx_t *ctx){
         ctx->chip = NULL;
     }
     ctx->mode = 0;
+    ctx->held = 0;
 }
 
 void tx_line_close(tx_ctx_t *ctx){
@@ -79,7 +246,7 @@ void tx_line_close(tx_ctx_t *ctx){
 
 int tx_req_out(tx_ctx_t *ctx, const char *consumer_label, int idle_value){
     if (gpiod_line_request_output(ctx->line, consumer_label, idle_value) < 0) {
-        perror("gpiod_line_request_output");
+        tx_log_errno("gpiod_line_request_output", errno);
         tx_line_close(ctx);
         return -1;
     }
@@ -89,7 +256,7 @@ int tx_req_out(tx_ctx_t *ctx, const char *consumer_label, int idle_value){
 
 int tx_req_in(tx_ctx_t *ctx, const char *consumer_label){
     if (gpiod_line_request_input(ctx->line, consumer_label) < 0) {
-        perror("gpiod_line_request_input");
+        tx_log_errno("gpiod_line_request_input", errno);
         tx_line_close(ctx);
         return -1;
     }
@@ -100,36 +267,68 @@ int tx_req_in(tx_ctx_t *ctx, const char *consumer_label){
 int tx_clr_bit(tx_ctx_t *ctx){
     // "Clear" == drive low
     if (gpiod_line_set_value(ctx->line, 0) < 0) {
-        perror("gpiod_line_set_value(0)");
+        tx_log_errno("gpiod_line_set_value(0)", errno);
     }
     tx_line_close(ctx);
     return 1;
 }
 
+int tx_edge_open(tx_ctx_t *ctx, unsigned int gpio_line){
+    if (tx_line_init(ctx, gpio_line) < 0) return -1;
+    if (tx_req_in(ctx, "dcf77-att") < 0) return -1;
+    ctx->held = 1;
+    return 1;
+}
+
+int tx_edge_set(tx_ctx_t *ctx, uint8_t state){
+    const int mode = state ? 1 : 0;
+    if (ctx->mode == mode) return 1;
+
+    // GPIOHANDLE_SET_CONFIG_IOCTL: direction switch without releasing the line (libgpiod >= 1.5)
+    int ret = mode ? gpiod_line_set_direction_output(ctx->line, 0) : gpiod_line_set_direction_input(ctx->line);
+    if (ret < 0) {
+        tx_log_errno("gpiod_line_set_direction", errno);
+        return -1;
+    }
+    ctx->mode = mode;
+    return 1;
+}
+
+/*--------------------------- libgpiod v1 ------------------------*/
+#endif
+
+void tx_edge_close(tx_ctx_t *ctx){
+    if (!ctx) return;
+
+    if (ctx->held && ctx->mode) tx_edge_set(ctx, 0); // Leave the attenuator in Hi-Z
+    tx_line_close(ctx);
+    ctx->held = 0;
+}
+
 
 void gpio_in(tx_ctx_t *txt){
     if (tx_line_init(txt, GPIO_LINE) < 0) {
-        perror("In Req: Line init failed");
+        tx_log_errno("In Req: Line init failed", errno);
     }
     if (tx_req_in(txt, "dcf77-high_z") < 0) {
-        perror("In Req: High-Z mode failed");
+        tx_log_errno("In Req: High-Z mode failed", errno);
     }
 }
 
 void gpio_out(tx_ctx_t *txt){
     if (tx_line_init(txt, GPIO_LINE) < 0) {
-        perror("Out Req: Line init failed");
+        tx_log_errno("Out Req: Line init failed", errno);
     }
     
     if (tx_req_in(txt, "dcf77-high_z") < 0) {
-        perror("Out Req: High-Z mode failed");
+        tx_log_errno("Out Req: High-Z mode failed", errno);
     }
     
     tx_line_close(txt);
     tx_line_init(txt, GPIO_LINE);
     
     if (tx_req_out(txt, "dcf77-gnd", 0) < 0) {
-        perror("Out Req: Out mode failed");
+        tx_log_errno("Out Req: Out mode failed", errno);
     }
 }
 
@@ -137,7 +336,8 @@ void gpio_clr(tx_ctx_t *txt){
     tx_clr_bit(txt);
 }
 
-void tx_send(uint8_t state, tx_ctx_t *txt){
+// Per-edge request/release path, kept for contexts without tx_edge_open() and as the benchmark baseline
+void tx_send_legacy(uint8_t state, tx_ctx_t *txt){
     if (state){
         gpio_out(txt);
         gpio_clr(txt);
@@ -146,89 +346,12 @@ void tx_send(uint8_t state, tx_ctx_t *txt){
         gpio_in(txt);
         tx_line_close(txt);
     }
-    return;
 }
 
-
-void thread_setup(pthread_t thread, int core){
-    // CPU Affinity on specific core
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core, &cpuset); // RPi5 is quad-core
-
-    if (pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset) != 0) {
-        perror("pthread_setaffinity_np");
+void tx_send(uint8_t state, tx_ctx_t *txt){
+    if (txt->held) {
+        tx_edge_set(txt, state);
+        return;
     }
-    // Thread priority
-    struct sched_param param;
-    param.sched_priority = 99; // High priority (1-99)
-    pthread_setschedparam(thread, SCHED_FIFO, &param);
+    tx_send_legacy(state, txt);
 }
-
-void* data_tx(void *args){
-    thread_setup(pthread_self(), 3);
-
-    tx_ctx_t gpio_driver;
-    if (tx_chip_init(&gpio_driver) < 0){
-        perror("GPIO chip init failed");
-    }
-
-    parser_t* t_args = (parser_t *)args;
-
-
-    int timeout =  (t_args->t_lim > 0) ? t_args->t_lim : 960; //Default timeout after 16hrs -> 960 mins
-    
-    time_t start_transm;
-    uint8_t leap;
-    
-    if (!t_args->t_src){ const time_t start_time = time(NULL); start_transm = start_time; leap = 0;}
-    if (t_args->t_src){ ret_ntp *sync = ntp_get(); start_transm = sync->time_data; leap = sync->leap_sec;}
-    start_transm -= start_transm % 60; //Round down to the minute
-    start_transm += t_args->t_toff * (time_t)60;
-
-    struct timespec sec_swi;
-    for (time_t minute_start = start_transm; timeout-- && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire); minute_start += 60) {
-        if (t_args->verbose) verbose_time(minute_start);
-
-        tx_block_prep(minute_start, &leap);
-
-        for (int sec = 0; sec < 60 && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire); sec++) {
-            const bit_mod_t modulation = set_modulation(sec);
-            
-            sec_swi.tv_sec = minute_start + sec; // Wait until second turnover
-            sec_swi.tv_nsec = 0;
-            clk_delay(sec_swi);
-
-            if (t_args->verbose) fprintf(stderr, "\b\b\b:%02d", sec);    
-        
-            tx_send(modulation.state, &gpio_driver);
-            if (modulation.duration == 0) continue; //Last segment, skip ms delay
-            sec_swi.tv_nsec += modulation.duration * 1000000L;
-            clk_delay(sec_swi);
-
-            if (sec == 59 && modulation.duration != 0){
-                //Leap second logic: 
-                //  1. set_mod gave '0' for 59 sec
-                //      1a. Leap is set 
-                //      1b. we are in 23:59:00 min (leap: 59th = 0, 60th = No MOD)
-                //  2. already sent '0' for 59th
-                //  3. wait for 1sec (60th leap sec) before moving on next min
-                sec_swi.tv_sec++;
-                clk_delay(sec_swi);
-            }
-
-            tx_send(Carrier, &gpio_driver); //Attenuation Complete; Stop modulation
-        }
-        fprintf(stderr, "\n");
-    }
-
-    gpio_cleanup(&gpio_driver);
-    
-    pthread_mutex_lock(t_args->lck);
-    if (*t_args->exit == 0) {
-        *t_args->exit = 2;
-        pthread_cond_signal(t_args->ext);
-    }
-    pthread_mutex_unlock(t_args->lck);
-    return NULL;
-}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tx_backend.h"
+#include "modulator.h"
+#include "tx_log.h"
+
+#define MOD_DUE_RING 16 // > MOD_FIFO_DEPTH + the word being executed
+
+typedef struct hw_priv {
+    pio_carrier_t carrier[TX_MAX_CHANNELS];
+    tx_ctx_t *att[TX_MAX_CHANNELS];
+    pio_mod_t mod;
+    unsigned int mod_pin;
+    uint64_t mod_pushed;              // Words pushed, pre-roll not counted
+    int64_t mod_pull_ns[MOD_DUE_RING]; // Expected pull time of each pushed word
+    int64_t mod_end_ns;               // End of the last pushed second
+} hw_priv_t;
+
+static int hw_carrier_start(tx_backend_t *be, int ch, unsigned int pin, const clk_vals_t *clk){
+    hw_priv_t *hw = be->priv;
+    return pio_carrier_start(&hw->carrier[ch], pin, clk);
+}
+
+static void hw_carrier_stop(tx_backend_t *be, int ch){
+    hw_priv_t *hw = be->priv;
+    pio_carrier_stop(&hw->carrier[ch]);
+}
+
+static int hw_att_open(tx_backend_t *be, int ch, unsigned int gpio_line){
+    hw_priv_t *hw = be->priv;
+    if (tx_chip_init(hw->att[ch]) < 0){
+        tx_log_errno("GPIO chip init failed", errno);
+        return -1;
+    }
+    // Request the attenuator line once; every edge after this is a single direction reconfigure
+    if (tx_edge_open(hw->att[ch], gpio_line) < 0){
+        tx_log_errno("GPIO edge engine init failed, falling back to per-edge requests", errno);
+    }
+    return 1;
+}
+
+static int hw_att_set(tx_backend_t *be, int ch, uint8_t state, const struct timespec *deadline){
+    (void)deadline;
+    hw_priv_t *hw = be->priv;
+    tx_send(state, hw->att[ch]);
+    return 1;
+}
+
+static void hw_att_close(tx_backend_t *be, int ch){
+    hw_priv_t *hw = be->priv;
+    gpio_cleanup(hw->att[ch]);
+}
+
+static int hw_mod_start(tx_backend_t *be, unsigned int gpio_line){
+    hw_priv_t *hw = be->priv;
+    hw->mod_pin = gpio_line;
+    hw->mod_pushed = 0;
+    if (pio_mod_start(&hw->mod, gpio_line) < 0) return -1;
+    return 1;
+}
+
+static int hw_mod_push(tx_backend_t *be, uint32_t word, const struct timespec *due, int64_t *phase_ns){
+    hw_priv_t *hw = be->priv;
+    const int64_t pull_ns = tx_ts_ns(due) - (int64_t)MOD_LEAD_TICKS * MOD_TICK_NS;
+    *phase_ns = INT64_MIN;
+
+    if (hw->mod_pushed == 0) {
+        // Pre-roll: a minute-mark word sized so the state machine pulls the first real word on time
+        const int64_t wake_ns = pull_ns - MOD_PREROLL_NS;
+        const struct timespec wake = { .tv_sec = (time_t)(wake_ns / 1000000000LL), .tv_nsec = (long)(wake_ns % 1000000000LL) };
+        be->clock->sleep_until(be->clock, &wake);
+        uint32_t pre;
+        if (mod_word(0, (uint32_t)((pull_ns - tx_clock_ns(be->clock)) / MOD_TICK_NS), &pre) < 0) {
+            tx_log_msg("PIO modulator: first second missed");
+            return -1;
+        }
+        pio_mod_put(&hw->mod, pre);
+    }
+
+    const int was_full = pio_mod_level(&hw->mod) >= MOD_FIFO_DEPTH;
+    pio_mod_put(&hw->mod, word);
+    const int64_t t = tx_clock_ns(be->clock);
+    hw->mod_pull_ns[hw->mod_pushed % MOD_DUE_RING] = pull_ns;
+    hw->mod_pushed++;
+    hw->mod_end_ns = pull_ns + (int64_t)mod_word_period_ticks(word) * MOD_TICK_NS;
+
+    // A push that had to wait returned right after the pull that made room: that pull's phase
+    const uint64_t pulled = hw->mod_pushed - pio_mod_level(&hw->mod);
+    if (was_full && pulled > 0 && pulled + MOD_DUE_RING > hw->mod_pushed) {
+        *phase_ns = t - hw->mod_pull_ns[(pulled - 1) % MOD_DUE_RING];
+    }
+    return 1;
+}
+
+static void hw_mod_stop(tx_backend_t *be, int drain){
+    hw_priv_t *hw = be->priv;
+    if (drain && hw->mod_pushed) {
+        const struct timespec end = { .tv_sec = (time_t)(hw->mod_end_ns / 1000000000LL), .tv_nsec = (long)(hw->mod_end_ns % 1000000000LL) };
+        be->clock->sleep_until(be->clock, &end);
+    }
+    pio_mod_stop(&hw->mod, hw->mod_pin);
+}
+
+static void hw_destroy(tx_backend_t *be){
+    hw_priv_t *hw = be->priv;
+    for (int c = 0; c < TX_MAX_CHANNELS; c++) tx_ctx_free(hw->att[c]);
+    free(hw);
+    free(be);
+}
+
+tx_backend_t *tx_backend_hw_new(void){
+    tx_backend_t *be = calloc(1, sizeof(*be));
+    hw_priv_t *hw = calloc(1, sizeof(*hw));
+    if (!be || !hw) {
+        free(be);
+        free(hw);
+        return NULL;
+    }
+    for (int c = 0; c < TX_MAX_CHANNELS; c++) {
+        hw->att[c] = tx_ctx_new();
+        hw->carrier[c].sm = -1;
+        if (!hw->att[c]) {
+            for (int j = 0; j < c; j++) tx_ctx_free(hw->att[j]);
+            free(hw);
+            free(be);
+            return NULL;
+        }
+    }
+    hw->mod.sm = -1;
+
+    *be = (tx_backend_t){
+        .name = "hw",
+        .priv = hw,
+        .carrier_start = hw_carrier_start,
+        .carrier_stop = hw_carrier_stop,
+        .att_open = hw_att_open,
+        .att_set = hw_att_set,
+        .att_close = hw_att_close,
+        .mod_start = hw_mod_start,
+        .mod_push = hw_mod_push,
+        .mod_stop = hw_mod_stop,
+        .destroy = hw_destroy
+    };
+    return be;
+}
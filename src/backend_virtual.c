@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tx_backend.h"
+#include "modulator.h"
+
+#define TRACE_BUF_SIZE (64 * 1024)
+
+typedef struct virt_priv {
+    FILE *trace;
+    char *buf;
+    uint8_t att_state[TX_MAX_CHANNELS];
+    uint64_t events;
+    uint64_t edges;
+    int64_t late_sum_ns;
+    int64_t late_max_ns;
+    int64_t mod_skew_ns; // PIO modulator: accumulated trim vs. the nominal seconds
+    int64_t mod_end_ns;
+} virt_priv_t;
+
+static int64_t now_ns(tx_backend_t *be){
+    if (be->clock) return tx_clock_ns(be->clock);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return tx_ts_ns(&ts);
+}
+
+static void record(virt_priv_t *v, int ch, uint8_t event, int64_t deadline_ns, int64_t actual_ns){
+    v->events++;
+    if (!v->trace) return;
+    tx_trace_rec_t rec = {
+        .deadline_ns = deadline_ns,
+        .actual_ns = actual_ns,
+        .event = event,
+        .chan = (uint8_t)ch
+    };
+    fwrite(&rec, sizeof(rec), 1, v->trace);
+}
+
+static int virt_carrier_start(tx_backend_t *be, int ch, unsigned int pin, const clk_vals_t *clk){
+    (void)pin;
+    (void)clk;
+    const int64_t t = now_ns(be);
+    record(be->priv, ch, TX_EV_CARRIER_START, t, t);
+    return 1;
+}
+
+static void virt_carrier_stop(tx_backend_t *be, int ch){
+    const int64_t t = now_ns(be);
+    record(be->priv, ch, TX_EV_CARRIER_STOP, t, t);
+}
+
+static int virt_att_open(tx_backend_t *be, int ch, unsigned int gpio_line){
+    (void)gpio_line;
+    virt_priv_t *v = be->priv;
+    v->att_state[ch] = 0;
+    return 1;
+}
+
+static int virt_att_set(tx_backend_t *be, int ch, uint8_t state, const struct timespec *deadline){
+    virt_priv_t *v = be->priv;
+    const int64_t actual = now_ns(be);
+    state = state ? 1 : 0;
+    if (state == v->att_state[ch]) return 1; // Same as the hw edge engine: no transition, no event
+
+    const int64_t dl = tx_ts_ns(deadline);
+    const int64_t late = actual - dl;
+    v->edges++;
+    v->late_sum_ns += late;
+    if (late > v->late_max_ns) v->late_max_ns = late;
+
+    record(v, ch, state ? TX_EV_ATT_LOW : TX_EV_ATT_HIZ, dl, actual);
+    v->att_state[ch] = state;
+    return 1;
+}
+
+static void virt_att_close(tx_backend_t *be, int ch){
+    virt_priv_t *v = be->priv;
+    if (v->att_state[ch]) {
+        const int64_t t = now_ns(be);
+        record(v, ch, TX_EV_ATT_HIZ, t, t);
+        v->att_state[ch] = 0;
+    }
+}
+
+static void sleep_until_ns(tx_backend_t *be, int64_t ns){
+    const struct timespec ts = { .tv_sec = (time_t)(ns / 1000000000LL), .tv_nsec = (long)(ns % 1000000000LL) };
+    if (be->clock) be->clock->sleep_until(be->clock, &ts);
+    else clk_delay(ts);
+}
+
+static int virt_mod_start(tx_backend_t *be, unsigned int gpio_line){
+    (void)gpio_line;
+    virt_priv_t *v = be->priv;
+    v->att_state[0] = 0;
+    v->mod_skew_ns = 0;
+    v->mod_end_ns = 0;
+    return 1;
+}
+
+static void mod_edge(virt_priv_t *v, uint8_t state, int64_t deadline){
+    if (state == v->att_state[0]) return;
+    v->edges++;
+    v->late_sum_ns += v->mod_skew_ns;
+    if (v->mod_skew_ns > v->late_max_ns) v->late_max_ns = v->mod_skew_ns;
+    record(v, 0, state ? TX_EV_ATT_LOW : TX_EV_ATT_HIZ, deadline, deadline + v->mod_skew_ns);
+    v->att_state[0] = state;
+}
+
+// The modulator is cycle exact: each word expands into its edges at once, timed from the word itself
+static int virt_mod_push(tx_backend_t *be, uint32_t word, const struct timespec *due, int64_t *phase_ns){
+    virt_priv_t *v = be->priv;
+    const int64_t start = tx_ts_ns(due);
+    // FIFO back-pressure: the push returns once the word MOD_FIFO_DEPTH seconds ahead was pulled
+    sleep_until_ns(be, start - (int64_t)MOD_FIFO_DEPTH * 1000000000LL);
+
+    const uint32_t att = mod_word_att_ticks(word);
+    if (att) {
+        mod_edge(v, 0, start);
+        mod_edge(v, 1, start + (int64_t)att * MOD_TICK_NS);
+    } else {
+        mod_edge(v, 1, start);
+    }
+    *phase_ns = v->mod_skew_ns;
+    v->mod_skew_ns += ((int64_t)mod_word_period_ticks(word) - MOD_TICKS_SEC) * MOD_TICK_NS;
+    v->mod_end_ns = start + 1000000000LL + v->mod_skew_ns;
+    return 1;
+}
+
+static void virt_mod_stop(tx_backend_t *be, int drain){
+    virt_priv_t *v = be->priv;
+    if (drain && v->mod_end_ns) sleep_until_ns(be, v->mod_end_ns);
+    // pio_mod_stop() leaves the line in Hi-Z
+    if (v->att_state[0]) {
+        const int64_t t = now_ns(be);
+        record(v, 0, TX_EV_ATT_HIZ, t, t);
+        v->att_state[0] = 0;
+    }
+}
+
+static void virt_destroy(tx_backend_t *be){
+    virt_priv_t *v = be->priv;
+    if (v->edges) {
+        fprintf(stderr, "Virtual backend: %llu events, %llu edges, lateness mean=%.1fus max=%.1fus\n",
+                (unsigned long long)v->events, (unsigned long long)v->edges,
+                (double)v->late_sum_ns / (double)v->edges / 1000.0, (double)v->late_max_ns / 1000.0);
+    }
+    if (v->trace) fclose(v->trace);
+    free(v->buf);
+    free(v);
+    free(be);
+}
+
+tx_backend_t *tx_backend_virtual_new(const char *trace_path){
+    tx_backend_t *be = calloc(1, sizeof(*be));
+    virt_priv_t *v = calloc(1, sizeof(*v));
+    if (!be || !v) {
+        free(be);
+        free(v);
+        return NULL;
+    }
+
+    if (trace_path) {
+        v->trace = fopen(trace_path, "wb");
+        if (!v->trace) {
+            perror("Virtual backend: trace open");
+            free(v);
+            free(be);
+            return NULL;
+        }
+        // Large buffer: the RT thread only touches memory except for the occasional flush
+        v->buf = malloc(TRACE_BUF_SIZE);
+        if (v->buf) setvbuf(v->trace, v->buf, _IOFBF, TRACE_BUF_SIZE);
+
+        tx_trace_hdr_t hdr = { .version = TX_TRACE_VERSION, .rec_size = sizeof(tx_trace_rec_t) };
+        memcpy(hdr.magic, TX_TRACE_MAGIC, sizeof(hdr.magic));
+        fwrite(&hdr, sizeof(hdr), 1, v->trace);
+    }
+
+    *be = (tx_backend_t){
+        .name = "virtual",
+        .priv = v,
+        .carrier_start = virt_carrier_start,
+        .carrier_stop = virt_carrier_stop,
+        .att_open = virt_att_open,
+        .att_set = virt_att_set,
+        .att_close = virt_att_close,
+        .mod_start = virt_mod_start,
+        .mod_push = virt_mod_push,
+        .mod_stop = virt_mod_stop,
+        .destroy = virt_destroy
+    };
+    return be;
+}
@@ -1,54 +1,13 @@
-#include <piolib/piolib.h>
-#include <math.h>
-#include <float.h>
+#include <errno.h>
 #include <stdio.h>
 #include <piolib/piolib.h>
 
 #include "hw_conf.h"
-#include "args.h"
-
-const uint16_t carrier_freq_program_instructions[] = {
-    //      .wrap
-    0xe001, //  0:  set PINS, 1
-    0xa026, //  1:  mov X, ISR
-    0x0042, //  2:  jmp X--, 2     (High State Delay)
-    0xe000, //  3:  set PINS, 0
-    0xa026, //  4:  mov X, ISR
-    0x0045 //  5:  jmp X--, 5     (Low State Delay)
-    //      .wrap
-};
-
-clk_vals_t find_best(double f_pio, double f_target, uint32_t Loops_min, uint32_t Loops_max){
-    clk_vals_t vals = {0};
-    vals.err = DBL_MAX; //FP Max
-
-    for (uint32_t L = Loops_min; L <= Loops_max; ++L) {
-        double Cycle_per_Period = 2.0 * ((double)L + 3.0);
-        double clk_div_ideal = f_pio / (f_target * Cycle_per_Period);
-
-        //Divider value limits
-        if (clk_div_ideal < 1.0 || clk_div_ideal > 65535.0) continue;
-
-        //precision allowed up to 1/256
-        double clk_div_real = round(clk_div_ideal * 256.0) / 256.0;
-
-        double f_real = f_pio / (clk_div_real * Cycle_per_Period);
-        double err = fabs(f_real - f_target);
-
-        if (err <= vals.err) {
-            vals.loops = L;
-            vals.clk_div_ideal = clk_div_ideal;
-            vals.clk_div_real = clk_div_real;
-            vals.f_actual = f_real;
-            vals.err = err;
-        }
-    }
-    return vals;
-}
-
+#include "modulator.h"
+#include "tx_log.h"
 
 void pio_cleanup(struct pio_instance **pio_driver,int *sm_r, uint *sm_off, struct pio_program prog){
-    fprintf(stderr, "Shutting down PIO carrier\n");
+    tx_log_msg("Shutting down PIO carrier");
     if (*sm_r >= 0) {
         pio_sm_set_enabled(*pio_driver, *sm_r, false);
         pio_sm_unclaim(*pio_driver, *sm_r);
@@ -59,59 +18,130 @@ void pio_cleanup(struct pio_instance **pio_driver,int *sm_r, uint *sm_off, struc
     }
 }
 
+static const struct pio_program carrier_program = {
+    .instructions = carrier_freq_program_instructions,
+    .length = 6,
+    .origin = -1
+};
 
-void* carrier_conf(void *args) {
-    thread_setup(pthread_self(), 1);
-    
-    parser_t* t_args = (parser_t *)args;
-    clk_vals_t clock_settings = find_best(CLOCK_FREQ, TARGET_HZ, 30, 800);
-    if (t_args->verbose) fprintf(stderr, "Carrier config: GPIO=%u Clock=%.0f MHz \nFrequency requested=%.1fHz loop_count=%u clkdiv=%.9f\n", CARRIER_PIN, CLOCK_FREQ/1000000, clock_settings.f_actual,  clock_settings.loops, clock_settings.clk_div_real);
-    
-    if (pio_init() < 0) { perror("pio_init"); return NULL; }
-    
-    const struct pio_program carrier_program = {
-        .instructions = carrier_freq_program_instructions,
-        .length = 6,
-        .origin = -1
-    };
+// Every carrier state machine runs the same program: load it once, remove it with the last user
+static uint carrier_offset;
+static int carrier_users;
 
+int pio_carrier_start(pio_carrier_t *car, unsigned int pin, const clk_vals_t *clock_settings){
+    car->pio = NULL;
+    car->sm = -1;
+    car->offset = 0;
 
-    // PIO definitions: driver, state_machine, memory_offset
-    PIO g_pio = NULL;
-    int g_sm = -1;
-    uint g_offset = 0;
+    if (pio_init() < 0) { tx_log_errno("pio_init", errno); return -1; }
 
-    g_pio = pio0;
-    g_sm = pio_claim_unused_sm(g_pio, true);
-    g_offset = pio_add_program(g_pio, &carrier_program);
+    // PIO definitions: driver, state_machine, memory_offset
+    PIO g_pio = pio0;
+    // Not required: running out of state machines fails this channel instead of exiting in piolib
+    const int sm = pio_claim_unused_sm(g_pio, false);
+    if (sm < 0) { tx_log_msg("PIO: no free state machine for the carrier"); return -1; }
+    if (carrier_users == 0) {
+        if (!pio_can_add_program(g_pio, &carrier_program)) {
+            pio_sm_unclaim(g_pio, (uint)sm);
+            tx_log_msg("PIO: no instruction memory for the carrier program");
+            return -1;
+        }
+        carrier_offset = pio_add_program(g_pio, &carrier_program);
+    }
+    carrier_users++;
+    car->pio = g_pio;
+    car->sm = sm;
+    car->offset = carrier_offset;
+    int g_sm = car->sm;
+    uint g_offset = car->offset;
 
     // GPIO routing
-    pio_gpio_init(g_pio, CARRIER_PIN);
-    pio_sm_set_consecutive_pindirs(g_pio, g_sm, CARRIER_PIN, 1, true);
+    pio_gpio_init(g_pio, pin);
+    pio_sm_set_consecutive_pindirs(g_pio, g_sm, pin, 1, true);
     pio_sm_config c = pio_get_default_sm_config();
-    sm_config_set_set_pins(&c, CARRIER_PIN, 1);
+    sm_config_set_set_pins(&c, pin, 1);
 
     // Wrap program for continuous run
     sm_config_set_wrap(&c, g_offset + 0, g_offset + 5);
 
-    sm_config_set_clkdiv(&c, (float)clock_settings.clk_div_real);
+    sm_config_set_clkdiv_int_frac(&c, clock_settings->div_int, clock_settings->div_frac);
 
     pio_sm_init(g_pio, g_sm, g_offset, &c);
     pio_sm_set_enabled(g_pio, g_sm, false);
-    pio_sm_put_blocking(g_pio, g_sm, clock_settings.loops);
+    // High delay parked in ISR, low delay in OSR
+    pio_sm_put_blocking(g_pio, g_sm, clock_settings->loops);
+    pio_sm_put_blocking(g_pio, g_sm, clock_settings->loops_low);
     pio_sm_exec(g_pio, g_sm, pio_encode_pull(false, true));
     pio_sm_exec(g_pio, g_sm, pio_encode_mov(pio_isr, pio_osr));
+    pio_sm_exec(g_pio, g_sm, pio_encode_pull(false, true));
     pio_sm_set_enabled(g_pio, g_sm, true);
-    
-    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000L }; // 1ms
-    while (!atomic_load_explicit(t_args->stop_thread, memory_order_acquire)) nanosleep(&ts, NULL);
-    pio_cleanup(&g_pio, &g_sm, &g_offset, carrier_program);
-
-    pthread_mutex_lock(t_args->lck);
-    if (*t_args->exit == 0) {
-        *t_args->exit = 2;
-        pthread_cond_signal(t_args->ext);
+    return 1;
+}
+
+void pio_carrier_stop(pio_carrier_t *car){
+    if (!car->pio) return;
+    uint offset = --carrier_users == 0 ? car->offset : 0; // Program stays while other channels run it
+    pio_cleanup(&car->pio, &car->sm, &offset, carrier_program);
+    car->pio = NULL;
+}
+
+static const struct pio_program modulator_program = {
+    .instructions = modulator_program_instructions,
+    .length = MOD_PROGRAM_LEN,
+    .origin = -1
+};
+
+int pio_mod_start(pio_mod_t *mod, unsigned int pin){
+    mod->pio = NULL;
+    mod->sm = -1;
+    mod->offset = 0;
+
+    if (pio_init() < 0) { tx_log_errno("pio_init", errno); return -1; }
+
+    PIO g_pio = pio0;
+    const int sm = pio_claim_unused_sm(g_pio, false);
+    if (sm < 0) { tx_log_msg("PIO: no free state machine for the modulator"); return -1; }
+    if (!pio_can_add_program(g_pio, &modulator_program)) {
+        pio_sm_unclaim(g_pio, (uint)sm);
+        tx_log_msg("PIO: no instruction memory for the modulator program");
+        return -1;
+    }
+    mod->pio = g_pio;
+    mod->sm = sm;
+    mod->offset = pio_add_program(g_pio, &modulator_program);
+    int g_sm = mod->sm;
+    uint g_offset = mod->offset;
+
+    pio_gpio_init(g_pio, pin);
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_set_pins(&c, pin, 1);
+    sm_config_set_out_shift(&c, true, false, 32); // X from the low half, Y from the high half
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_wrap(&c, g_offset + 0, g_offset + MOD_PROGRAM_LEN - 1);
+    sm_config_set_clkdiv_int_frac(&c, MOD_CLKDIV, 0);
+
+    pio_sm_init(g_pio, g_sm, g_offset, &c);
+    // Output latch LOW, pin an input: only the direction changes, like the libgpiod attenuator
+    pio_sm_set_pins_with_mask(g_pio, g_sm, 0, 1u << pin);
+    pio_sm_set_pindirs_with_mask(g_pio, g_sm, 0, 1u << pin);
+    pio_sm_set_enabled(g_pio, g_sm, true); // Stalls on the first pull until a word arrives
+    return 1;
+}
+
+void pio_mod_put(pio_mod_t *mod, uint32_t word){
+    pio_sm_put_blocking(mod->pio, mod->sm, word);
+}
+
+uint pio_mod_level(pio_mod_t *mod){
+    return pio_sm_get_tx_fifo_level(mod->pio, mod->sm);
+}
+
+void pio_mod_stop(pio_mod_t *mod, unsigned int pin){
+    if (!mod->pio) return;
+    if (mod->sm >= 0) {
+        pio_sm_set_enabled(mod->pio, mod->sm, false);
+        pio_sm_set_pindirs_with_mask(mod->pio, mod->sm, 0, 1u << pin); // Leave the attenuator in Hi-Z
     }
-    pthread_mutex_unlock(t_args->lck);
-    return NULL;
+    pio_cleanup(&mod->pio, &mod->sm, &mod->offset, modulator_program);
+    mod->pio = NULL;
 }
@@ -0,0 +1,34 @@
+#include <stdio.h>
+
+#include "hw_conf.h"
+
+/*
+carrier-plan-gen: run carrier_plan_search() for every CARRIER_PLAN_CLOCKS x CARRIER_PLAN_TARGETS
+pair at build time and write generated/carrier_table.h, so startup is a table lookup.
+*/
+
+int main(int argc, char *argv[]){
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s carrier_table.h\n", argv[0]);
+        return 1;
+    }
+    FILE *out = fopen(argv[1], "w");
+    if (!out) { perror("carrier-plan-gen: fopen"); return 1; }
+
+    static const double clocks[] = CARRIER_PLAN_CLOCKS;
+    static const double targets[] = CARRIER_PLAN_TARGETS;
+
+    fprintf(out, "// Generated by carrier-plan-gen at build time, do not edit\n"
+                 "#ifndef CARRIER_TABLE_H\n#define CARRIER_TABLE_H\n\n"
+                 "static const carrier_plan_entry_t carrier_table[] = {\n");
+    for (size_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); ++c) {
+        for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); ++t) {
+            const clk_vals_t v = carrier_plan_search(clocks[c], targets[t]);
+            fprintf(out, "    { %.1f, %.1f, %u, %u, %u, %u }, // %.6f Hz, %+.3f ppb, duty %.4f%%, jitter %u clk\n",
+                    clocks[c], targets[t], v.loops, v.loops_low, v.div_int, v.div_frac,
+                    v.f_actual, v.err_ppb, v.duty * 100.0, v.jitter_clk);
+        }
+    }
+    fprintf(out, "};\n\n#endif\n");
+    return fclose(out) == 0 ? 0 : 1;
+}
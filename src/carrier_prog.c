@@ -0,0 +1,111 @@
+#include <math.h>
+#include <float.h>
+
+#include "hw_conf.h"
+
+#ifndef CARRIER_NO_TABLE
+#include "carrier_table.h"
+#endif
+
+const uint16_t carrier_freq_program_instructions[] = {
+    //      .wrap
+    0xe001, //  0:  set PINS, 1
+    0xa026, //  1:  mov X, ISR
+    0x0042, //  2:  jmp X--, 2     (High State Delay)
+    0xe000, //  3:  set PINS, 0
+    0xa027, //  4:  mov X, OSR
+    0x0045 //  5:  jmp X--, 5     (Low State Delay)
+    //      .wrap
+};
+
+clk_vals_t find_best(double f_pio, double f_target, uint32_t Loops_min, uint32_t Loops_max){
+    clk_vals_t vals = {0};
+    vals.err = DBL_MAX; //FP Max
+
+    for (uint32_t L = Loops_min; L <= Loops_max; ++L) {
+        double Cycle_per_Period = 2.0 * ((double)L + 3.0);
+        double clk_div_ideal = f_pio / (f_target * Cycle_per_Period);
+
+        //Divider value limits
+        if (clk_div_ideal < 1.0 || clk_div_ideal > 65535.0) continue;
+
+        //precision allowed up to 1/256
+        double clk_div_real = round(clk_div_ideal * 256.0) / 256.0;
+
+        double f_real = f_pio / (clk_div_real * Cycle_per_Period);
+        double err = fabs(f_real - f_target);
+
+        if (err <= vals.err) {
+            vals.loops = L;
+            vals.loops_low = L;
+            vals.clk_div_ideal = clk_div_ideal;
+            vals.clk_div_real = clk_div_real;
+            vals.f_actual = f_real;
+            vals.err = err;
+        }
+    }
+    if (vals.err < DBL_MAX) vals = carrier_plan_eval(f_pio, f_target, vals.loops, vals.loops_low, (uint16_t)vals.clk_div_real, (uint8_t)((vals.clk_div_real - floor(vals.clk_div_real)) * 256.0));
+    return vals;
+}
+
+clk_vals_t carrier_plan_eval(double f_pio, double f_target, uint32_t loops, uint32_t loops_low, uint16_t div_int, uint8_t div_frac){
+    clk_vals_t vals = {0};
+    const uint64_t period = (uint64_t)loops + loops_low + 6;
+    vals.loops = loops;
+    vals.loops_low = loops_low;
+    vals.div_int = div_int;
+    vals.div_frac = div_frac;
+    vals.clk_div_real = (double)div_int + div_frac / 256.0;
+    vals.clk_div_ideal = f_pio / (f_target * (double)period);
+    vals.f_actual = f_pio / (vals.clk_div_real * (double)period);
+    vals.err = fabs(vals.f_actual - f_target);
+    vals.err_ppb = (vals.f_actual - f_target) / f_target * 1e9;
+    vals.duty = (double)(loops + 3) / (double)period;
+    // A period spans period * div_frac / 256 carries of the FRAC accumulator: whole = every period alike
+    vals.jitter_clk = (period * div_frac) % 256 ? 1 : 0;
+    return vals;
+}
+
+// a better than b: least error, then no FRAC jitter, then duty closest to 50%
+static int plan_better(const clk_vals_t *a, const clk_vals_t *b){
+    const double tie = 1e-6; // ppb
+    if (fabs(a->err_ppb) < fabs(b->err_ppb) - tie) return 1;
+    if (fabs(a->err_ppb) > fabs(b->err_ppb) + tie) return 0;
+    if (a->jitter_clk != b->jitter_clk) return a->jitter_clk < b->jitter_clk;
+    return fabs(a->duty - 0.5) < fabs(b->duty - 0.5);
+}
+
+clk_vals_t carrier_plan_search(double f_pio, double f_target){
+    clk_vals_t best = {0};
+    best.err_ppb = DBL_MAX;
+    best.err = DBL_MAX;
+
+    // The divider must stay >= 1, which bounds the period at f_pio / f_target cycles
+    const uint64_t p_max = (uint64_t)(f_pio / f_target);
+    for (uint64_t period = 6; period <= p_max; ++period) {
+        const uint32_t high = (uint32_t)((period - 6) / 2), low = (uint32_t)(period - 6 - high);
+        if (fabs((double)(high + 3) / (double)period - 0.5) > CARRIER_DUTY_TOL) continue;
+
+        const double div256 = f_pio * 256.0 / (f_target * (double)period);
+        for (uint64_t d = (uint64_t)div256; d <= (uint64_t)div256 + 1; ++d) {
+            if (d < 256 || d >= 65536ULL * 256) continue;
+            const clk_vals_t c = carrier_plan_eval(f_pio, f_target, high, low, (uint16_t)(d >> 8), (uint8_t)(d & 0xff));
+            if (plan_better(&c, &best)) best = c;
+        }
+    }
+    return best;
+}
+
+clk_vals_t carrier_plan(double f_pio, double f_target, int *from_table){
+#ifndef CARRIER_NO_TABLE
+    for (size_t i = 0; i < sizeof(carrier_table) / sizeof(carrier_table[0]); ++i) {
+        const carrier_plan_entry_t *e = &carrier_table[i];
+        if (e->f_pio == f_pio && e->f_target == f_target) {
+            if (from_table) *from_table = 1;
+            return carrier_plan_eval(f_pio, f_target, e->loops, e->loops_low, e->div_int, e->div_frac);
+        }
+    }
+#endif
+    if (from_table) *from_table = 0;
+    return carrier_plan_search(f_pio, f_target);
+}
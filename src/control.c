@@ -0,0 +1,282 @@
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "args.h"
+#include "schedule.h"
+#include "discipline.h"
+#include "rt_metrics.h"
+#include "timecode.h"
+#include "hw_conf.h"
+#include "parse_num.h"
+
+typedef struct reply {
+    char *buf;
+    size_t len;
+    size_t off;
+} reply_t;
+
+static void out(reply_t *r, const char *fmt, ...){
+    if (r->off >= r->len) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(r->buf + r->off, r->len - r->off, fmt, ap);
+    va_end(ap);
+    if (n > 0) r->off += (size_t)n;
+    if (r->off >= r->len) r->off = r->len - 1; // Truncated: drop the terminator
+}
+
+static void format_windows(const tx_live_t *l, reply_t *r){
+    if (!l->n_win) { out(r, "off"); return; }
+    for (int i = 0; i < l->n_win; i++) {
+        out(r, "%s%02u:%02u-%02u:%02u", i ? "," : "", l->win_from[i] / 60, l->win_from[i] % 60, l->win_to[i] / 60, l->win_to[i] % 60);
+    }
+}
+
+static void cmd_status(parser_t *cli, reply_t *r){
+    tx_live_t *l = cli->live;
+    const int64_t on_air = atomic_load_explicit(&l->on_air, memory_order_relaxed);
+    char when[32] = "-";
+    if (on_air) {
+        const time_t t = (time_t)on_air;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%MZ", &tm);
+    }
+
+    out(r, "state=%s\n", !on_air ? "starting" : atomic_load_explicit(&cli->carrier_on, memory_order_relaxed) ? "transmitting" : "idle");
+    out(r, "on_air=%s\n", when);
+    out(r, "daemon=%u\n", cli->daemon);
+    out(r, "source=%s\n", atomic_load_explicit(&cli->t_src, memory_order_relaxed) == SET_NTP ? "ntp" : "local");
+    out(r, "discipline=%s\n", cli->disc ? "on" : "off");
+    out(r, "modulator=%s\n", cli->mod_sel == MOD_PIO ? "pio" : "cpu");
+    out(r, "verbose=%u\n", atomic_load_explicit(&cli->verbose, memory_order_relaxed));
+    out(r, "frames=%llu\n", (unsigned long long)atomic_load_explicit(&cli->metrics->frames_sent, memory_order_relaxed));
+
+    pthread_mutex_lock(&l->lck);
+    out(r, "window=");
+    format_windows(l, r);
+    out(r, "\ngeneration=%u\n", atomic_load_explicit(&l->gen, memory_order_relaxed));
+    for (int c = 0; c < cli->n_chan; c++) {
+        const tx_chan_t *ch = &cli->chan[c];
+        out(r, "channel.%d=%s carrier=%u att=%u zone=%s offset=%d\n", c, ch->proto->name, ch->carrier_pin, ch->att_pin, ch->zone, l->t_toff[c]);
+    }
+    pthread_mutex_unlock(&l->lck);
+}
+
+static int cmd_offset(parser_t *cli, char *arg, char *chan, reply_t *r){
+    long long v, c = -1;
+    if (!arg || parse_ll(arg, -525600, 525600, &v) < 0) { out(r, "error: offset takes minutes (-525600 to 525600)\n"); return -1; }
+    if (chan && parse_ll(chan, 0, cli->n_chan - 1, &c) < 0) { out(r, "error: no channel '%s'\n", chan); return -1; }
+
+    tx_live_t *l = cli->live;
+    pthread_mutex_lock(&l->lck);
+    for (int i = 0; i < cli->n_chan; i++) {
+        if (c < 0 || i == c) l->t_toff[i] = (int)v;
+    }
+    tx_live_commit(l);
+    pthread_mutex_unlock(&l->lck);
+    return 0;
+}
+
+static int cmd_source(parser_t *cli, const char *arg, reply_t *r){
+    uint8_t src;
+    if (arg && strcmp(arg, "local") == 0) src = SET_LOCAL;
+    else if (arg && strcmp(arg, "ntp") == 0) src = SET_NTP;
+    else { out(r, "error: source is local or ntp\n"); return -1; }
+
+    atomic_store_explicit(&cli->t_src, src, memory_order_relaxed);
+    if (cli->disc) {
+        // The discipline slews the difference between the two sources out like any other error
+        tx_disc_set_source(cli->disc, src == SET_NTP ? tx_disc_source_ntp : tx_disc_source_local, src == SET_NTP ? (void *)cli->ntp_servers : NULL);
+    } else {
+        out(r, "note: no time discipline (-D off), the source is read when the modulator restarts (SIGHUP)\n");
+    }
+    return 0;
+}
+
+static int parse_hhmm(const char *s, uint16_t *min){
+    unsigned int h, m;
+    int n = 0;
+    if (sscanf(s, "%2u:%2u%n", &h, &m, &n) != 2 || s[n] != '\0' || h > 24 || m > 59 || (h == 24 && m)) return -1;
+    *min = (uint16_t)(h * 60 + m);
+    return 0;
+}
+
+static int cmd_window(parser_t *cli, char *arg, reply_t *r){
+    uint16_t from[SCHED_MAX_WINDOWS], to[SCHED_MAX_WINDOWS];
+    int n = 0;
+    if (!arg) { out(r, "error: window takes off or HH:MM-HH:MM,...\n"); return -1; }
+    if (strcmp(arg, "off") != 0) {
+        if (cli->mod_sel == MOD_PIO) { out(r, "error: transmit windows need -M cpu\n"); return -1; }
+        char *save = NULL;
+        for (char *w = strtok_r(arg, ",", &save); w; w = strtok_r(NULL, ",", &save)) {
+            char *dash = strchr(w, '-');
+            if (n >= SCHED_MAX_WINDOWS) { out(r, "error: at most %d windows\n", SCHED_MAX_WINDOWS); return -1; }
+            if (!dash) { out(r, "error: window '%s' is not HH:MM-HH:MM\n", w); return -1; }
+            *dash = '\0';
+            if (parse_hhmm(w, &from[n]) < 0 || parse_hhmm(dash + 1, &to[n]) < 0 || from[n] % 1440 == to[n] % 1440) {
+                out(r, "error: invalid window '%s-%s'\n", w, dash + 1);
+                return -1;
+            }
+            from[n] %= 1440;
+            to[n] %= 1440;
+            n++;
+        }
+    }
+
+    tx_live_t *l = cli->live;
+    pthread_mutex_lock(&l->lck);
+    l->n_win = (uint8_t)n;
+    memcpy(l->win_from, from, sizeof(from[0]) * (size_t)n);
+    memcpy(l->win_to, to, sizeof(to[0]) * (size_t)n);
+    tx_live_commit(l);
+    pthread_mutex_unlock(&l->lck);
+    return 0;
+}
+
+size_t tx_ctl_exec(parser_t *cli, const char *line, char *buf, size_t len){
+    reply_t r = { .buf = buf, .len = len, .off = 0 };
+    char cmd[CTL_LINE_MAX];
+    snprintf(cmd, sizeof(cmd), "%s", line);
+
+    char *save = NULL;
+    char *verb = strtok_r(cmd, " \t\r\n", &save);
+    char *a1 = strtok_r(NULL, " \t\r\n", &save);
+    char *a2 = strtok_r(NULL, " \t\r\n", &save);
+    int rc = 0;
+
+    if (!verb) return 0;
+    if (strcmp(verb, "status") == 0) cmd_status(cli, &r);
+    else if (strcmp(verb, "offset") == 0) rc = cmd_offset(cli, a1, a2, &r);
+    else if (strcmp(verb, "source") == 0) rc = cmd_source(cli, a1, &r);
+    else if (strcmp(verb, "window") == 0) rc = cmd_window(cli, a1, &r);
+    else if (strcmp(verb, "verbose") == 0) {
+        if (a1 && (strcmp(a1, "0") == 0 || strcmp(a1, "1") == 0)) atomic_store_explicit(&cli->verbose, (uint8_t)(a1[0] - '0'), memory_order_relaxed);
+        else { out(&r, "error: verbose is 0 or 1\n"); rc = -1; }
+    }
+    else if (strcmp(verb, "help") == 0) {
+        out(&r, "status\noffset <minutes> [channel]\nsource local|ntp\nverbose 0|1\nwindow off|HH:MM-HH:MM,... (UTC)\n");
+    }
+    else { out(&r, "error: unknown command '%s' (try help)\n", verb); rc = -1; }
+
+    if (rc == 0) out(&r, "ok\n");
+    return r.off;
+}
+
+static void serve_client(tx_ctl_srv_t *srv, int cfd){
+    char line[CTL_LINE_MAX];
+    char reply[CTL_REPLY_MAX];
+    size_t have = 0;
+
+    for (;;) {
+        struct pollfd pfd[2] = { { .fd = cfd, .events = POLLIN }, { .fd = srv->wake_fd, .events = POLLIN } };
+        if (poll(pfd, 2, CTL_IDLE_MS) <= 0 || pfd[1].revents) return;
+        const ssize_t n = recv(cfd, line + have, sizeof(line) - 1 - have, 0);
+        if (n <= 0) return;
+        have += (size_t)n;
+        line[have] = '\0';
+
+        char *start = line, *nl;
+        while ((nl = strchr(start, '\n'))) {
+            *nl = '\0';
+            const size_t rlen = tx_ctl_exec(srv->cli, start, reply, sizeof(reply));
+            if (rlen && send(cfd, reply, rlen, MSG_NOSIGNAL) < 0) return;
+            start = nl + 1;
+        }
+        have = strlen(start);
+        if (have == sizeof(line) - 1) {
+            send(cfd, "error: line too long\n", 21, MSG_NOSIGNAL);
+            return;
+        }
+        memmove(line, start, have + 1);
+    }
+}
+
+static void *serve_loop(void *args){
+    tx_ctl_srv_t *srv = (tx_ctl_srv_t *)args;
+    // Only this thread touches client fds; tx_ctl_stop() just signals wake_fd, which stays readable
+    for (;;) {
+        struct pollfd pfd[2] = { { .fd = srv->fd, .events = POLLIN }, { .fd = srv->wake_fd, .events = POLLIN } };
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents) break;
+        if (!pfd[0].revents) continue;
+        int cfd = accept4(srv->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) continue;
+            break;
+        }
+        serve_client(srv, cfd);
+        close(cfd);
+    }
+    return NULL;
+}
+
+int tx_ctl_start(tx_ctl_srv_t *srv, parser_t *cli, const char *path){
+    memset(srv, 0, sizeof(*srv));
+    srv->cli = cli;
+    srv->fd = -1;
+    srv->wake_fd = -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Control: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    strcpy(srv->path, path);
+
+    srv->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (srv->wake_fd < 0) { perror("Control: eventfd"); return -1; }
+    // Non-blocking: a client gone between poll() and accept() must not hold up the loop
+    srv->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (srv->fd < 0) {
+        perror("Control: socket");
+        close(srv->wake_fd);
+        srv->wake_fd = -1;
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(srv->fd, 4) < 0) {
+        perror("Control: bind/listen");
+        close(srv->fd);
+        close(srv->wake_fd);
+        srv->fd = srv->wake_fd = -1;
+        return -1;
+    }
+
+    if (thread_create_low(&srv->tid, serve_loop, srv) != 0) {
+        perror("Control: pthread_create");
+        close(srv->fd);
+        close(srv->wake_fd);
+        unlink(path);
+        srv->fd = srv->wake_fd = -1;
+        return -1;
+    }
+    return 1;
+}
+
+void tx_ctl_stop(tx_ctl_srv_t *srv){
+    if (srv->fd < 0) return;
+    const uint64_t one = 1;
+    if (write(srv->wake_fd, &one, sizeof(one)) < 0) { /* Counter saturated: already signalled */ }
+    pthread_join(srv->tid, NULL);
+    close(srv->fd);
+    close(srv->wake_fd);
+    unlink(srv->path);
+    srv->fd = srv->wake_fd = -1;
+}
@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/mman.h>
+
+#include "dcf77.h"
+#include "tz_cache.h"
+#include "parse_num.h"
+#include "version.h"
+
+/*
+dcf77-gen: stream encoded frames for any time range, no hardware needed.
+Times are transmission minutes (UTC); the frame sent during minute t encodes t + 60 in the chosen zone.
+Formats:
+  raw     8 bytes per minute, little-endian dcf77_frame_t
+  pulses  one line per minute: 60 digits, pulse width of each second in 100ms units (0 = no modulation)
+  csv     minute_utc,encoded_local,frame  (e.g. 1711846740,2024-03-31T03:00+02:00,0x...)
+The output file is sized up front, written through a shared mapping, then truncated to what was written.
+*/
+
+#define FMT_RAW 0x0
+#define FMT_PULSES 0x1
+#define FMT_CSV 0x2
+
+#define CSV_HEADER "minute_utc,encoded_local,frame\n"
+#define CSV_MAX_LINE 64
+#define CHUNK 4096
+
+typedef struct gen_args {
+    time_t from;
+    long count;
+    uint8_t format;
+    uint8_t leap;
+    const char *zone;
+    const char *out;
+} gen_args_t;
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s --from time (--to time | -n minutes) -o file [-f raw|pulses|csv] [-z zone] [-L]\n"
+                "Required:\n"
+                "  -F, --from     time        (first transmission minute: YYYY-MM-DD[THH:MM] UTC or @epoch)\n"
+                "  -T, --to       time        (end of range, exclusive) or\n"
+                "  -n, --count    minutes\n"
+                "  -o, --output   file        (- for stdout)\n"
+                "Options:\n"
+                "  -f, --format   raw|pulses|csv (Default: raw)\n"
+                "  -z, --zone     name        (Default: " TZ_DEFAULT_ZONE ")\n"
+                "  -L, --leap                 (NTP leap indicator set, as in -s ntp)\n"
+                "  -h, --help                 (This message)\n", prog);
+}
+
+static int parse_args(int argc, char *argv[], gen_args_t *out){
+    *out = (gen_args_t){ .from = 0, .count = -1, .format = FMT_RAW, .zone = TZ_DEFAULT_ZONE };
+    int have_from = 0;
+    time_t to = 0;
+    int have_to = 0;
+
+    static const struct option longopts[] = {
+        {"from",   required_argument, 0, 'F'},
+        {"to",     required_argument, 0, 'T'},
+        {"count",  required_argument, 0, 'n'},
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'f'},
+        {"zone",   required_argument, 0, 'z'},
+        {"leap",   no_argument,       0, 'L'},
+        {"help",   no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "F:T:n:o:f:z:Lh", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'F': if (tz_parse_utc(optarg, &out->from) != 0) goto bad_time; have_from = 1; break;
+            case 'T': if (tz_parse_utc(optarg, &to) != 0) goto bad_time; have_to = 1; break;
+            case 'n': {
+                long long v;
+                if (parse_ll(optarg, 1, LONG_MAX, &v) < 0) { fprintf(stderr, "Error: invalid count '%s'\n\n", optarg); return -1; }
+                out->count = (long)v;
+                break;
+            }
+            case 'o': out->out = optarg; break;
+            case 'f':
+                if (strcmp(optarg, "raw") == 0) out->format = FMT_RAW;
+                else if (strcmp(optarg, "pulses") == 0) out->format = FMT_PULSES;
+                else if (strcmp(optarg, "csv") == 0) out->format = FMT_CSV;
+                else { fprintf(stderr, "Error: invalid format '%s' (use raw|pulses|csv)\n\n", optarg); return -1; }
+                break;
+            case 'z': out->zone = optarg; break;
+            case 'L': out->leap = 1; break;
+            case 'h': usage(stdout, argv[0]); exit(0);
+            default: usage(stderr, argv[0]); return -1;
+        }
+    }
+
+    if (!have_from || !out->out || (have_to == (out->count > 0))) {
+        fprintf(stderr, "Error: need --from, -o and exactly one of --to/--count\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+    out->from -= ((out->from % 60) + 60) % 60; // Minute boundary
+    if (have_to) out->count = (long)((to - out->from + 59) / 60);
+    if (out->count <= 0) { fprintf(stderr, "Error: empty range\n"); return -1; }
+    return 0;
+
+bad_time:
+    fprintf(stderr, "Error: invalid time '%s' (YYYY-MM-DD[THH:MM] or @epoch)\n\n", optarg);
+    return -1;
+}
+
+static char *put_num(char *p, long long v, int width){
+    char tmp[24];
+    int n = 0;
+    const int neg = v < 0;
+    unsigned long long u = neg ? (unsigned long long)(-v) : (unsigned long long)v;
+    do { tmp[n++] = (char)('0' + u % 10); u /= 10; } while (u);
+    while (n < width) tmp[n++] = '0';
+    if (neg) *p++ = '-';
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static char *put_record(char *p, uint8_t format, time_t t_min, dcf77_frame_t frame, const tz_cache_t *tz){
+    static const char hex[] = "0123456789abcdef";
+    switch (format) {
+        case FMT_RAW: {
+            const uint64_t le = htole64(frame);
+            memcpy(p, &le, sizeof(le));
+            return p + sizeof(le);
+        }
+        case FMT_PULSES:
+            for (int sec = 0; sec < 60; ++sec) {
+                const bit_mod_t mod = dcf77_modulation(frame, sec);
+                *p++ = (char)('0' + mod.duration / 100);
+            }
+            *p++ = '\n';
+            return p;
+        default: {
+            tz_local_t lt;
+            tz_localtime(tz, t_min + 60, &lt);
+            const int off = lt.info.utc_offset / 60;
+            const int aoff = off < 0 ? -off : off;
+            p = put_num(p, (long long)t_min, 1); *p++ = ',';
+            p = put_num(p, lt.year, 4); *p++ = '-'; p = put_num(p, lt.mon, 2); *p++ = '-'; p = put_num(p, lt.mday, 2);
+            *p++ = 'T'; p = put_num(p, lt.hour, 2); *p++ = ':'; p = put_num(p, lt.min, 2);
+            *p++ = off < 0 ? '-' : '+'; p = put_num(p, aoff / 60, 2); *p++ = ':'; p = put_num(p, aoff % 60, 2);
+            *p++ = ','; *p++ = '0'; *p++ = 'x';
+            for (int i = 60; i >= 0; i -= 4) *p++ = hex[(frame >> i) & 0xf];
+            *p++ = '\n';
+            return p;
+        }
+    }
+}
+
+static size_t max_record(uint8_t format){
+    if (format == FMT_RAW) return sizeof(uint64_t);
+    if (format == FMT_PULSES) return 61;
+    return CSV_MAX_LINE;
+}
+
+// stdout: plain buffered writes
+static int gen_stream(const gen_args_t *a, const tz_cache_t *tz){
+    dcf77_frame_t frames[CHUNK];
+    char *buf = malloc(CHUNK * CSV_MAX_LINE);
+    if (!buf) return -1;
+    if (a->format == FMT_CSV) fputs(CSV_HEADER, stdout);
+    for (long done = 0; done < a->count; done += CHUNK) {
+        const long n = (a->count - done) < CHUNK ? (a->count - done) : CHUNK;
+        const time_t t0 = a->from + (time_t)done * 60;
+        dcf77_encode_range(t0, (size_t)n, tz, a->leap, frames);
+        char *p = buf;
+        for (long i = 0; i < n; ++i) p = put_record(p, a->format, t0 + (time_t)i * 60, frames[i], tz);
+        fwrite(buf, 1, (size_t)(p - buf), stdout);
+    }
+    free(buf);
+    return ferror(stdout) ? -1 : 0;
+}
+
+static int gen_mmap(const gen_args_t *a, const tz_cache_t *tz){
+    const size_t bound = sizeof(CSV_HEADER) + (size_t)a->count * max_record(a->format);
+    int fd = open(a->out, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { perror("open"); return -1; }
+    if (ftruncate(fd, (off_t)bound) < 0) { perror("ftruncate"); close(fd); return -1; }
+
+    char *map = mmap(NULL, bound, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) { perror("mmap"); close(fd); return -1; }
+    madvise(map, bound, MADV_SEQUENTIAL);
+
+    char *p = map;
+    if (a->format == FMT_CSV) { memcpy(p, CSV_HEADER, sizeof(CSV_HEADER) - 1); p += sizeof(CSV_HEADER) - 1; }
+
+    dcf77_frame_t frames[CHUNK];
+    for (long done = 0; done < a->count; done += CHUNK) {
+        const long n = (a->count - done) < CHUNK ? (a->count - done) : CHUNK;
+        const time_t t0 = a->from + (time_t)done * 60;
+        dcf77_encode_range(t0, (size_t)n, tz, a->leap, frames);
+        for (long i = 0; i < n; ++i) p = put_record(p, a->format, t0 + (time_t)i * 60, frames[i], tz);
+    }
+
+    const size_t used = (size_t)(p - map);
+    munmap(map, bound);
+    int rc = ftruncate(fd, (off_t)used);
+    if (rc < 0) perror("ftruncate");
+    close(fd);
+    return rc;
+}
+
+int main(int argc, char *argv[]){
+    gen_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+
+    tz_cache_t tz;
+    if (tz_cache_init(&tz, args.zone, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+        if (strcmp(args.zone, TZ_DEFAULT_ZONE) != 0) return 1;
+        tz_cache_init_rules(&tz, TZ_DEFAULT_ZONE, 3600, &startRule, &endRule, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    const int rc = strcmp(args.out, "-") == 0 ? gen_stream(&args, &tz) : gen_mmap(&args, &tz);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (rc == 0 && strcmp(args.out, "-") != 0) {
+        const double dt = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+        fprintf(stderr, "dcf77-gen v%s: %ld frames in %.3fs (%.0f frames/s)\n", DCF77_PROJECT_VERSION, args.count, dt, (double)args.count / dt);
+    }
+    tz_cache_free(&tz);
+    return rc == 0 ? 0 : 1;
+}
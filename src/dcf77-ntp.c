@@ -0,0 +1,205 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net_ntp.h"
+#include "parse_num.h"
+
+/*
+dcf77-ntp: run the transmitter's NTP client on its own and print every server's sample,
+or act as a local stand-in server with a known offset, so the client can be checked without the internet:
+
+  dcf77-ntp --serve 12300 --offset 250 --hold 5 --drop 1 &
+  dcf77-ntp -N 127.0.0.1:12300,192.0.2.1     (offset ~ +250ms, second server times out)
+*/
+
+typedef struct ntp_args {
+    const char *servers;
+    int timeout_ms;
+    const char *serve;
+    int offset_ms;
+    int drift_ppm;
+    int64_t start_ns;
+    int hold_ms;
+    int drop;
+    int leap;
+    int stratum;
+    long count;
+} ntp_args_t;
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s [-N servers] [-t ms]\n"
+                "       %s --serve [addr:]port [--offset ms] [--drift ppm] [--hold ms] [--drop n] [--leap 0-3] [--stratum n] [-n replies]\n"
+                "Query:\n"
+                "  -N, --ntp      host,...    (Default: " NTP_DEFAULT_SERVERS ")\n"
+                "  -t, --timeout  ms          (Default: %d)\n"
+                "Stand-in server:\n"
+                "  -s, --serve    [addr:]port (UDP, Default addr: 127.0.0.1)\n"
+                "  -o, --offset   ms          (Server clock - local clock)\n"
+                "  -r, --drift    ppm         (Server clock runs this much fast, from the first request on)\n"
+                "  -d, --hold     ms          (Between receive and transmit timestamps)\n"
+                "  -D, --drop     n           (Ignore the first n requests, to exercise retries)\n"
+                "  -L, --leap     0-3         (Leap indicator to send, 3 = unsynchronised)\n"
+                "  -S, --stratum  n           (Default: 1, 0 = kiss-o'-death)\n"
+                "  -n, --count    replies     (Exit after this many, Default: run until killed)\n"
+                "  -h, --help                 (This message)\n", prog, prog, NTP_TIMEOUT_MS);
+}
+
+static int parse_args(int argc, char *argv[], ntp_args_t *out){
+    *out = (ntp_args_t){ .servers = NTP_DEFAULT_SERVERS, .timeout_ms = NTP_TIMEOUT_MS, .stratum = 1, .count = -1 };
+
+    static const struct option longopts[] = {
+        {"ntp",     required_argument, 0, 'N'},
+        {"timeout", required_argument, 0, 't'},
+        {"serve",   required_argument, 0, 's'},
+        {"offset",  required_argument, 0, 'o'},
+        {"drift",   required_argument, 0, 'r'},
+        {"hold",    required_argument, 0, 'd'},
+        {"drop",    required_argument, 0, 'D'},
+        {"leap",    required_argument, 0, 'L'},
+        {"stratum", required_argument, 0, 'S'},
+        {"count",   required_argument, 0, 'n'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c, v;
+    while ((c = getopt_long(argc, argv, "N:t:s:o:r:d:D:L:S:n:h", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'N': out->servers = optarg; break;
+            case 's': out->serve = optarg; break;
+            case 't': if (parse_int(optarg, 1, 60000, &out->timeout_ms)) goto bad; break;
+            case 'o': if (parse_int(optarg, -86400000, 86400000, &out->offset_ms)) goto bad; break;
+            case 'r': if (parse_int(optarg, -100000, 100000, &out->drift_ppm)) goto bad; break;
+            case 'd': if (parse_int(optarg, 0, 10000, &out->hold_ms)) goto bad; break;
+            case 'D': if (parse_int(optarg, 0, INT_MAX, &out->drop)) goto bad; break;
+            case 'L': if (parse_int(optarg, 0, 3, &out->leap)) goto bad; break;
+            case 'S': if (parse_int(optarg, 0, 16, &out->stratum)) goto bad; break;
+            case 'n': if (parse_int(optarg, 1, INT_MAX, &v)) goto bad; out->count = v; break;
+            case 'h':
+                usage(stdout, argv[0]);
+                exit(0);
+            default:
+                usage(stderr, argv[0]);
+                return -1;
+        }
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "Error: invalid value '%s'\n\n", optarg);
+    usage(stderr, argv[0]);
+    return -1;
+}
+
+static void ns_to_ntp(int64_t ns, uint32_t *s, uint32_t *f){
+    *s = htonl((uint32_t)(ns / 1000000000LL + (int64_t)NTP_TIMESTAMP_DELTA));
+    *f = htonl((uint32_t)(((uint64_t)(ns % 1000000000LL) << 32) / 1000000000ULL));
+}
+
+static int64_t server_ns(ntp_args_t *a){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t now = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    if (!a->start_ns) a->start_ns = now;
+    return now + (int64_t)a->offset_ms * 1000000LL + (now - a->start_ns) / 1000000 * a->drift_ppm;
+}
+
+static int serve(ntp_args_t *a){
+    char host[64] = "127.0.0.1";
+    const char *port = a->serve;
+    const char *colon = strrchr(a->serve, ':');
+    if (colon) {
+        const int bracket = a->serve[0] == '[' && colon[-1] == ']'; // [v6]:port
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - a->serve) - 2 * bracket, a->serve + bracket);
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM, .ai_flags = AI_PASSIVE }, *ai;
+    const int rc = getaddrinfo(host, port, &hints, &ai);
+    if (rc != 0) {
+        fprintf(stderr, "%s: %s\n", a->serve, gai_strerror(rc));
+        return 1;
+    }
+    const int fd = socket(ai->ai_family, SOCK_DGRAM, 0);
+    if (fd < 0 || bind(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+        perror("bind");
+        freeaddrinfo(ai);
+        return 1;
+    }
+    freeaddrinfo(ai);
+    fprintf(stderr, "Serving NTP on %s:%s, offset %+dms, drift %+dppm, hold %dms\n", host, port, a->offset_ms, a->drift_ppm, a->hold_ms);
+
+    long replies = 0;
+    int dropped = 0;
+    while (a->count < 0 || replies < a->count) {
+        ntp_packet pkt;
+        struct sockaddr_storage peer;
+        socklen_t plen = sizeof(peer);
+        const ssize_t len = recvfrom(fd, &pkt, sizeof(pkt), 0, (struct sockaddr *)&peer, &plen);
+        const int64_t t2 = server_ns(a);
+        if (len < (ssize_t)sizeof(pkt) || (pkt.li_vn_mode & 0x7) != 3) continue;
+        if (dropped < a->drop) { dropped++; continue; }
+
+        if (a->hold_ms) {
+            const struct timespec hold = { .tv_sec = a->hold_ms / 1000, .tv_nsec = (a->hold_ms % 1000) * 1000000L };
+            nanosleep(&hold, NULL);
+        }
+        pkt.origTm_s = pkt.txTm_s;
+        pkt.origTm_f = pkt.txTm_f;
+        pkt.li_vn_mode = (uint8_t)((a->leap << 6) | (4 << 3) | 4);
+        pkt.stratum = (uint8_t)a->stratum;
+        pkt.poll = 4;
+        pkt.precision = (uint8_t)-20;
+        pkt.rootDelay = 0;
+        pkt.rootDispersion = htonl(1 << 6); // ~1ms
+        pkt.refId = htonl(0x4c4f434c); // "LOCL"
+        ns_to_ntp(t2, &pkt.rxTm_s, &pkt.rxTm_f);
+        pkt.refTm_s = pkt.rxTm_s;
+        pkt.refTm_f = 0;
+        ns_to_ntp(server_ns(a), &pkt.txTm_s, &pkt.txTm_f);
+        sendto(fd, &pkt, sizeof(pkt), 0, (struct sockaddr *)&peer, plen);
+        replies++;
+    }
+    close(fd);
+    return 0;
+}
+
+static int query(const ntp_args_t *a){
+    ntp_sample_t s[NTP_MAX_SERVERS];
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    const int n = ntp_query(a->servers, a->timeout_ms, s, NTP_MAX_SERVERS);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (n < 0) {
+        fprintf(stderr, "Error: invalid server list '%s'\n", a->servers);
+        return 1;
+    }
+    const int best = ntp_best(s, n);
+
+    printf("  %-32s %7s %12s %10s %10s %4s\n", "server", "stratum", "offset ms", "delay ms", "rootd ms", "leap");
+    for (int i = 0; i < n; i++) {
+        if (!s[i].valid) {
+            printf("  %-32s %s\n", s[i].server, s[i].error);
+            continue;
+        }
+        printf("%c %-32s %7u %+12.3f %10.3f %10.3f %4u\n", i == best ? '*' : ' ', s[i].server, s[i].stratum,
+               s[i].offset_ns / 1e6, s[i].delay_ns / 1e6, s[i].root_dist_ns / 1e6, s[i].leap);
+    }
+    printf("Query took %.1fms\n", (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6);
+    return best < 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    ntp_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+    return args.serve ? serve(&args) : query(&args);
+}
@@ -7,22 +7,86 @@
 #include <getopt.h>
 #include <signal.h>
 #include <stdatomic.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
 
 #include "args.h"
 #include "hw_conf.h"
+#include "tx_backend.h"
+#include "rt_metrics.h"
+#include "rt_profile.h"
+#include "discipline.h"
+#include "tx_clock.h"
 #include "net_ntp.h"
 #include "dcf77.h"
+#include "timecode.h"
+#include "tz_cache.h"
+#include "tx_chan.h"
+#include "schedule.h"
+#include "control.h"
+#include "flight_rec.h"
+#include "tx_log.h"
+#include "parse_num.h"
 #include "version.h"
 
 static atomic_bool stop_thread = 0;
-static pthread_mutex_t lck = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  ext = PTHREAD_COND_INITIALIZER;
+static atomic_int run_events = 0;
+static int run_efd = -1;
+static atomic_bool stop_seen = 0;
+static struct timespec stop_ts; // First SIGINT/SIGTERM, CLOCK_MONOTONIC
+
+static rt_metrics_t metrics;
+static rt_profile_t rt_prof;
+static tx_disc_cfg_t disc_cfg;
+static tx_disc_t disc;
+static tx_chan_t chans[TX_MAX_CHANNELS];
+static tz_cache_t zone_cache[TX_MAX_CHANNELS]; // One per distinct zone
+static int n_zones;
+static tx_clock_t tx_clock;
+static tx_spin_t tx_spin;
+static int64_t calib_p99_ns; // Startup calibration, seeds the adaptive spin margin
+static tx_live_t live;
+static flight_rec_t flight_rec;
+
+#ifdef DCF77_HAVE_HW
+#define DEFAULT_BACKEND TX_BACKEND_HW
+#define DEFAULT_BACKEND_NAME "hw"
+#else
+#define DEFAULT_BACKEND TX_BACKEND_VIRTUAL
+#define DEFAULT_BACKEND_NAME "virtual"
+#endif
+
+// Signals arrive on a signalfd read by main(): no handler runs, so the stop path needs no async-signal-safe tricks
+static void on_signal(int sig){
+    if (sig == SIGHUP) {
+        atomic_fetch_or_explicit(&run_events, RUN_EV_RESTART, memory_order_release);
+        return;
+    }
+    if (!atomic_exchange_explicit(&stop_seen, 1, memory_order_acq_rel)) clock_gettime(CLOCK_MONOTONIC, &stop_ts);
+    atomic_store_explicit(&stop_thread, 1, memory_order_release);
+    tx_clock_wake(&tx_clock); // Ends the edge thread's sleep now, not at its deadline
+    atomic_fetch_or_explicit(&run_events, RUN_EV_STOP, memory_order_release);
+}
 
-static int thread_exit = 0;
+static void read_signals(int sig_fd){
+    struct signalfd_siginfo si;
+    while (read(sig_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) on_signal((int)si.ssi_signo);
+}
+
+static double ms_since(const struct timespec *t0){
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (double)(t1.tv_sec - t0->tv_sec) * 1e3 + (double)(t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
 
-static void handle_signal(int sig){
-    (void)sig;
+// Stop the modulator thread: the wake fd ends its clock sleep, under way or next, so this is bounded
+static void tx_thread_stop(pthread_t tid){
     atomic_store_explicit(&stop_thread, 1, memory_order_release);
+    tx_clock_wake(&tx_clock);
+    pthread_join(tid, NULL);
+    tx_clock_drain(&tx_clock);
 }
 
 /*
@@ -74,59 +138,102 @@ struct tm {
 <------------------------------------------------------------------------------------------------------->
 */
 
-void verbose_time(time_t t) {
-    char buf[32];
-    struct tm tm;
-    localtime_r(&t, &tm);
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
-    fputs(buf,stderr);
-}
-
 void usage(FILE *out, const char *prog){
-    fprintf(out,"Usage: sudo %s -s [local|ntp] [-l minutes] [-o minutes] [-v]\n"
+    fprintf(out,"Usage: sudo %s -s [local|ntp] [-l minutes] [-o minutes] [-N servers] [-P protocol] [-z zone] [-C channel]... [-b hw|virtual] [-t file] [-c realtime|virtual] [-D discipline] [-S time] [-M cpu|pio] [-K] [-R profile] [-k] [-m socket] [-d] [-u socket] [-r file] [-v]\n"
                 "Required:\n"
                 "  -s, --source   local|ntp   (required)\n"
                 "Options:\n"
                 "  -l, --limit    minutes     (>0 if provided, Default: 960mins (16 hours))\n"
-                "  -o, --offset   minutes     (Transmit offset time from Germany local time)\n"
+                "  -N, --ntp      host,...    (NTP servers queried in parallel, host[:port] or [v6]:port, Default: pool.ntp.org x4)\n"
+                "  -o, --offset   minutes     (Transmit offset time from the zone's local time)\n"
+                "  -P, --protocol " TC_NAMES " (Time code and carrier, Default: dcf77)\n"
+                "  -z, --zone     name        (IANA time zone to transmit, Default: the protocol's, " TZ_DEFAULT_ZONE " for dcf77)\n"
+                "  -C, --channel  key=val,... (Extra transmitter, up to 4: carrier,att GPIO, offset, zone, proto;\n"
+                "                              Default: one channel, carrier=18,att=23 with -o/-z/-P)\n"
+                "  -b, --backend  hw|virtual  (Default: " DEFAULT_BACKEND_NAME ")\n"
+                "  -t, --trace    file        (virtual backend: binary event trace output)\n"
+                "  -c, --clock    realtime|virtual (virtual: jump to each deadline, requires -b virtual)\n"
+                "  -D, --discipline off|key=val,... (Resync the realtime clock: poll s, bound us, slew ppm, step ms;\n"
+                "                              Default: poll=64 (ntp) / 8 (local),bound=1000,slew=500,step=500)\n"
+                "  -S, --start    time        (virtual clock start: YYYY-MM-DD[THH:MM] UTC or @epoch, Default: now)\n"
+                "  -M, --modulator cpu|pio    (pio: a PIO state machine times the attenuator edges, Default: cpu)\n"
+                "  -K, --keep-carrier         (SIGHUP restarts the modulator only, carrier keeps running)\n"
+                "  -R, --rt       key=val,... (RT profile or @file: main,tx,spin cores, margin us, prio,main-prio,tx-prio,\n"
+                "                              slack ns, calib ms, budget us, strict 0|1; Default: main=2,tx=3,prio=99,calib=1000,budget=1000)\n"
+                "  -k, --check                (Run the RT self-check and latency calibration, then exit; -s not needed)\n"
+                "  -m, --metrics  socket      (Unix socket serving edge timing metrics, Prometheus text)\n"
+                "  -d, --daemon               (Run until stopped, no -l limit)\n"
+                "  -u, --control  socket      (Unix socket for status and live changes: offset, source, verbose, window)\n"
+                "  -r, --recorder file        (Flight recorder of every edge, read with dcf77-trace, e.g. " FR_DEFAULT_PATH ")\n"
                 "  -v, --verbose\n"
                 "  -h, --help                 (This message)\n", prog);
 }
 
-static int parse_int10(const char *s, int *out){
-    errno = 0;
-    char *end = NULL;
-    long v = strtol(s, &end, 10);
-
-    if (s == end) return -1;                 // no digits
-    if (*end != '\0') return -1;             // trailing junk (rejects "2312.042")
-    if (errno == ERANGE) return -1;          // overflow/underflow
-    if (v < INT_MIN || v > INT_MAX) return -1;
-
-    *out = (int)v;
-    return 0;
-}
-
 static int parse_source(const char *s, uint8_t *out){
     if (strcmp(s, "local") == 0) { *out = SET_LOCAL; return 0;}
     if (strcmp(s, "ntp") == 0)   { *out = SET_NTP; return 0;}
     return -1;
 }
 
+static int parse_backend(const char *s, uint8_t *out){
+    if (strcmp(s, "hw") == 0)      { *out = TX_BACKEND_HW; return 0;}
+    if (strcmp(s, "virtual") == 0) { *out = TX_BACKEND_VIRTUAL; return 0;}
+    return -1;
+}
+
 int parse_arguments(int argc, char *argv[], parser_t *out){
     if (!out) return -1;
 
+    rt_profile_defaults(&rt_prof);
+    tx_disc_cfg_defaults(&disc_cfg);
     *out = (parser_t){
         .t_src = 0x2,
         .t_lim = 0,
         .t_toff = 0,
-        .verbose = 0
+        .zone = NULL,
+        .chan = chans,
+        .n_chan = 0,
+        .ntp_servers = NTP_DEFAULT_SERVERS,
+        .verbose = 0,
+        .backend_sel = DEFAULT_BACKEND,
+        .trace_path = NULL,
+        .metrics_path = NULL,
+        .control_path = NULL,
+        .rec_path = NULL,
+        .rec = NULL,
+        .daemon = 0,
+        .live = &live,
+        .clock_sel = TX_CLOCK_REALTIME,
+        .mod_sel = MOD_CPU,
+        .keep_carrier = 0,
+        .check_only = 0,
+        .rt = &rt_prof,
+        .disc_cfg = &disc_cfg,
+        .disc = NULL,
+        .have_start = 0
     };
 
     static const struct option longopts[] = {
         {"source",  required_argument, 0, 's'},
         {"limit",   required_argument, 0, 'l'},
         {"offset",  required_argument, 0, 'o'},
+        {"ntp",     required_argument, 0, 'N'},
+        {"protocol", required_argument, 0, 'P'},
+        {"zone",    required_argument, 0, 'z'},
+        {"channel", required_argument, 0, 'C'},
+        {"backend", required_argument, 0, 'b'},
+        {"trace",   required_argument, 0, 't'},
+        {"clock",   required_argument, 0, 'c'},
+        {"start",   required_argument, 0, 'S'},
+        {"discipline", required_argument, 0, 'D'},
+        {"modulator", required_argument, 0, 'M'},
+        {"keep-carrier", no_argument, 0, 'K'},
+        {"rt",      required_argument, 0, 'R'},
+        {"check",   no_argument,       0, 'k'},
+        {"metrics", required_argument, 0, 'm'},
+        {"daemon",  no_argument,       0, 'd'},
+        {"control", required_argument, 0, 'u'},
+        {"recorder", required_argument, 0, 'r'},
         {"verbose", no_argument,       0, 'v'},
         {"help",    no_argument,       0, 'h'},
         {0, 0, 0, 0}
@@ -135,19 +242,22 @@ int parse_arguments(int argc, char *argv[], parser_t *out){
     optind = 1;
 
     int c;
-    while ((c = getopt_long(argc, argv, "s:l:o:vh", longopts, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "s:l:o:N:P:z:C:b:t:c:S:D:M:KR:km:du:r:vh", longopts, NULL)) != -1) {
         switch (c) {
-            case 's':
-                if (parse_source(optarg, &out->t_src) != 0) {
+            case 's': {
+                uint8_t src;
+                if (parse_source(optarg, &src) != 0) {
                     fprintf(stderr, "Error: invalid source '%s' (use local|ntp)\n\n", optarg);
                     usage(stderr, argv[0]);
                     return -1;
                 }
+                out->t_src = src;
                 break;
+            }
 
             case 'l': {
                 int v;
-                if (parse_int10(optarg, &v) != 0 || v <= 0) {
+                if (parse_int(optarg, 1, INT_MAX, &v) != 0) {
                     fprintf(stderr, "Error: invalid limit '%s' (must be integer > 0)\n\n", optarg);
                     usage(stderr, argv[0]);
                     return -1;
@@ -158,7 +268,7 @@ int parse_arguments(int argc, char *argv[], parser_t *out){
 
             case 'o': {
                 int v;
-                if (parse_int10(optarg, &v) != 0) {
+                if (parse_int(optarg, INT_MIN, INT_MAX, &v) != 0) {
                     fprintf(stderr, "Error: invalid offset '%s' (must be integer)\n\n", optarg);
                     usage(stderr, argv[0]);
                     return -1;
@@ -167,6 +277,120 @@ int parse_arguments(int argc, char *argv[], parser_t *out){
                 break;
             }
 
+            case 'N':
+                out->ntp_servers = optarg;
+                break;
+
+            case 'P': {
+                const tc_proto_t *p = tc_find(optarg);
+                if (!p) {
+                    fprintf(stderr, "Error: invalid protocol '%s' (use " TC_NAMES ")\n\n", optarg);
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                tc_set_proto(p);
+                break;
+            }
+
+            case 'z':
+                out->zone = optarg;
+                break;
+
+            case 'C':
+                if (out->n_chan >= TX_MAX_CHANNELS) {
+                    fprintf(stderr, "Error: at most %d channels\n\n", TX_MAX_CHANNELS);
+                    return -1;
+                }
+                out->chan[out->n_chan] = (tx_chan_t){ .carrier_pin = CARRIER_PIN, .att_pin = GPIO_LINE };
+                if (tx_chan_parse(&out->chan[out->n_chan], optarg) != 0) {
+                    fprintf(stderr, "\n");
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                out->n_chan++;
+                break;
+
+            case 'b':
+                if (parse_backend(optarg, &out->backend_sel) != 0) {
+                    fprintf(stderr, "Error: invalid backend '%s' (use hw|virtual)\n\n", optarg);
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                break;
+
+            case 't':
+                out->trace_path = optarg;
+                break;
+
+            case 'c':
+                if (strcmp(optarg, "realtime") == 0) out->clock_sel = TX_CLOCK_REALTIME;
+                else if (strcmp(optarg, "virtual") == 0) out->clock_sel = TX_CLOCK_VIRTUAL;
+                else {
+                    fprintf(stderr, "Error: invalid clock '%s' (use realtime|virtual)\n\n", optarg);
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                break;
+
+            case 'S':
+                if (tz_parse_utc(optarg, &out->start) != 0) {
+                    fprintf(stderr, "Error: invalid start '%s' (YYYY-MM-DD[THH:MM] or @epoch)\n\n", optarg);
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                out->have_start = 1;
+                break;
+
+            case 'M':
+                if (strcmp(optarg, "cpu") == 0) out->mod_sel = MOD_CPU;
+                else if (strcmp(optarg, "pio") == 0) out->mod_sel = MOD_PIO;
+                else {
+                    fprintf(stderr, "Error: invalid modulator '%s' (use cpu|pio)\n\n", optarg);
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                break;
+
+            case 'D':
+                if (tx_disc_cfg_parse(out->disc_cfg, optarg) != 0) {
+                    fprintf(stderr, "\n");
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                break;
+
+            case 'K':
+                out->keep_carrier = 1;
+                break;
+
+            case 'R':
+                if (rt_profile_parse(out->rt, optarg) != 0) {
+                    fprintf(stderr, "\n");
+                    usage(stderr, argv[0]);
+                    return -1;
+                }
+                break;
+
+            case 'k':
+                out->check_only = 1;
+                break;
+
+            case 'm':
+                out->metrics_path = optarg;
+                break;
+
+            case 'd':
+                out->daemon = 1;
+                break;
+
+            case 'u':
+                out->control_path = optarg;
+                break;
+
+            case 'r':
+                out->rec_path = optarg;
+                break;
+
             case 'v':
                 out->verbose = 1;
                 break;
@@ -192,58 +416,383 @@ int parse_arguments(int argc, char *argv[], parser_t *out){
         return -1;
     }
 
-    if (out->t_src == 0x2) {
+    if (out->daemon && out->t_lim > 0) {
+        fprintf(stderr, "Error: -d/--daemon runs without a limit, drop -l\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+
+    if (out->t_src == 0x2 && !out->check_only) {
         fprintf(stderr, "Error: missing required option -s/--source\n\n");
         usage(stderr, argv[0]);
         return -1;
     }
 
+#ifndef DCF77_HAVE_HW
+    if (out->backend_sel == TX_BACKEND_HW) {
+        fprintf(stderr, "Error: built without the hw backend (piolib/libgpiod), use -b virtual\n\n");
+        return -1;
+    }
+#endif
+
+    if (out->clock_sel == TX_CLOCK_VIRTUAL && out->backend_sel != TX_BACKEND_VIRTUAL) {
+        fprintf(stderr, "Error: -c virtual requires -b virtual\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+
+    if (out->have_start && out->clock_sel != TX_CLOCK_VIRTUAL) {
+        fprintf(stderr, "Error: -S/--start requires -c virtual\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+
+    // Without -C: one channel on the default pins; channel keys left out fall back to -o/-z/-P
+    if (out->n_chan == 0) out->chan[out->n_chan++] = (tx_chan_t){ .carrier_pin = CARRIER_PIN, .att_pin = GPIO_LINE };
+    for (int i = 0; i < out->n_chan; i++) {
+        tx_chan_t *ch = &out->chan[i];
+        if (!ch->proto) ch->proto = tc_proto();
+        if (!ch->have_toff) ch->t_toff = out->t_toff;
+        if (!ch->zone[0]) snprintf(ch->zone, sizeof(ch->zone), "%s", out->zone ? out->zone : ch->proto->zone);
+
+        for (int j = 0; j < i; j++) {
+            const tx_chan_t *o = &out->chan[j];
+            const unsigned int pins[4] = { ch->carrier_pin, ch->att_pin, o->carrier_pin, o->att_pin };
+            if (pins[0] == pins[2] || pins[0] == pins[3] || pins[1] == pins[2] || pins[1] == pins[3]) {
+                fprintf(stderr, "Error: channels %d and %d share a GPIO\n\n", j, i);
+                return -1;
+            }
+        }
+        if (ch->carrier_pin == ch->att_pin) {
+            fprintf(stderr, "Error: channel %d uses GPIO %u for both carrier and attenuator\n\n", i, ch->carrier_pin);
+            return -1;
+        }
+    }
+
+    if (out->mod_sel == MOD_PIO && out->n_chan > 1) {
+        fprintf(stderr, "Error: -M pio drives a single channel, use -M cpu with -C\n\n");
+        return -1;
+    }
+
+    if (out->mod_sel == MOD_PIO && !tc_att_from_start(out->chan[0].proto)) {
+        fprintf(stderr, "Error: -M pio cannot time %s pulses (attenuation must start each second), use -M cpu\n\n", out->chan[0].proto->name);
+        return -1;
+    }
+
+    if (!out->zone) out->zone = out->chan[0].zone;
+
+    if (out->trace_path && out->backend_sel != TX_BACKEND_VIRTUAL) {
+        fprintf(stderr, "Error: -t/--trace requires -b virtual\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    // Lock memory
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
-        perror("mlockall failed");
+// One cache per distinct zone; a protocol's default zone falls back to its built-in rules without a tzfile
+static int zones_init(parser_t *cli){
+    for (int c = 0; c < cli->n_chan; c++) {
+        tx_chan_t *ch = &cli->chan[c];
+        for (int z = 0; z < n_zones && !ch->tz; z++) {
+            if (strcmp(zone_cache[z].zone, ch->zone) == 0) ch->tz = &zone_cache[z];
+        }
+        if (ch->tz) continue;
+
+        tz_cache_t *tz = &zone_cache[n_zones];
+        const tc_proto_t *p = ch->proto;
+        if (tz_cache_init(tz, ch->zone, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+            if (strcmp(ch->zone, p->zone) != 0) {
+                fprintf(stderr, "Error: unknown time zone '%s'\n", ch->zone);
+                return -1;
+            }
+            fprintf(stderr, "Using built-in rules for %s\n", p->zone);
+            tz_cache_init_rules(tz, p->zone, p->std_offset, p->dst_start, p->dst_end, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+        }
+        n_zones++;
+        ch->tz = tz;
     }
-    thread_setup(pthread_self(),2);
-    
-    signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal);
-    
-    setenv("TZ", "Europe/Berlin", 1);
-    tzset();
+    return 0;
+}
 
-    
+static void zones_free(void){
+    while (n_zones > 0) tz_cache_free(&zone_cache[--n_zones]);
+}
+
+// Host checks and wake-up latency calibration before anything is transmitted; -1: do not start
+static int rt_startup_check(const parser_t *cli, int mlock_ok){
+    const rt_profile_t *rt = cli->rt;
+    const int verbose = cli->verbose || cli->check_only;
+    int fails = rt_selfcheck(rt, mlock_ok, verbose, stderr);
+
+    rt_calib_t cal;
+    const int rc = rt_calibrate(rt, &cal);
+    if (rc < 0) {
+        fprintf(stderr, "  [FAIL] latency calibration could not run\n");
+        fails++;
+    } else if (cal.samples) {
+        calib_p99_ns = cal.p99_ns;
+        // With the PIO modulator the edges do not depend on wake-up latency: the result is informational
+        const int binding = cli->mod_sel == MOD_CPU;
+        if (!cal.setup_ok || (binding && !rc)) fails++;
+        fprintf(stderr, "  [%s] wake-up latency core %d prio %d, %u samples: min %.1fus avg %.1fus p99 %.1fus max %.1fus (%s %.0fus budget%s)\n",
+                !cal.setup_ok || (binding && !rc) ? "FAIL" : rc ? " ok " : "warn", cal.core, cal.prio, cal.samples,
+                cal.min_ns / 1e3, cal.avg_ns / 1e3, cal.p99_ns / 1e3, cal.max_ns / 1e3, rc ? "within" : "exceeds", rt->budget_ns / 1e3,
+                !cal.setup_ok ? ", not on the requested core/priority" : binding ? "" : ", PIO times the edges");
+    }
+
+    if (fails) fprintf(stderr, "RT self-check: %d check%s failed%s\n", fails, fails == 1 ? "" : "s", rt->strict ? ", not starting (strict=1)" : "");
+    else if (verbose) fprintf(stderr, "RT self-check: host meets the edge timing budget\n");
+    return (fails && (rt->strict || cli->check_only)) ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
     parser_t cli_vars;
     if (parse_arguments(argc, argv, &cli_vars) != 0) {
         return 1;
     }
+
+    // Read from a signalfd in the event loop below: blocked before any thread is created, so all of them inherit it
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    sigaddset(&sigs, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    // Lock memory
+    const int mlock_ok = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    if (!mlock_ok) perror("mlockall failed");
+    rt_thread_setup(rt_prof.main_core, rt_prof.main_prio, rt_prof.slack_ns);
+
+    // The virtual clock never sleeps: nothing to check
+    if (cli_vars.check_only || cli_vars.clock_sel == TX_CLOCK_REALTIME) {
+        const int rc = rt_startup_check(&cli_vars, mlock_ok);
+        if (cli_vars.check_only) return rc < 0 ? 1 : 0;
+        if (rc < 0) return 1;
+    }
+
+    run_efd = eventfd(0, EFD_CLOEXEC);
+    if (run_efd < 0) {
+        perror("eventfd");
+        return 1;
+    }
+    // main() sleeps in one epoll set: signals and the transmit thread's events
+    const int sig_fd = signalfd(-1, &sigs, SFD_CLOEXEC | SFD_NONBLOCK);
+    const int loop_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.fd = sig_fd };
+    int ep_rc = (sig_fd < 0 || loop_fd < 0) ? -1 : epoll_ctl(loop_fd, EPOLL_CTL_ADD, sig_fd, &lev);
+    lev.data.fd = run_efd;
+    if (ep_rc == 0) ep_rc = epoll_ctl(loop_fd, EPOLL_CTL_ADD, run_efd, &lev);
+    if (ep_rc < 0) {
+        perror("signalfd/epoll");
+        return 1;
+    }
+
+    // Transition tables for the transmitted zones, built once: the encoder never calls localtime_r
+    if (zones_init(&cli_vars) < 0) {
+        zones_free();
+        return 1;
+    }
+    dcf77_set_zone(cli_vars.chan[0].tz);
+    tx_live_init(&live, cli_vars.chan, cli_vars.n_chan);
+
+    setenv("TZ", cli_vars.zone, 1); // Verbose log timestamps only
+    tzset();
     cli_vars.stop_thread = &stop_thread;
-    cli_vars.lck = &lck;
-    cli_vars.ext = &ext;
-    cli_vars.exit = &thread_exit;
+    cli_vars.events = &run_events;
+    cli_vars.evfd = run_efd;
+    cli_vars.metrics = &metrics;
     
     if (cli_vars.verbose) printf("%s v%s\n", DCF77_PROJECT_NAME, DCF77_PROJECT_VERSION);
+    for (int c = 0; c < cli_vars.n_chan && cli_vars.verbose; c++) {
+        const tx_chan_t *ch = &cli_vars.chan[c];
+        printf("Channel %d: %s, %.1fkHz carrier on GPIO %u, attenuator GPIO %u, zone %s, offset %+d min\n", c, ch->proto->name,
+               ch->proto->carrier_hz / 1e3, ch->carrier_pin, ch->att_pin, ch->zone, ch->t_toff);
+    }
+
+#ifdef DCF77_HAVE_HW
+    if (cli_vars.backend_sel == TX_BACKEND_HW) cli_vars.backend = tx_backend_hw_new();
+#endif
+    if (cli_vars.backend_sel == TX_BACKEND_VIRTUAL) cli_vars.backend = tx_backend_virtual_new(cli_vars.trace_path);
+    if (!cli_vars.backend) {
+        fprintf(stderr, "Error: backend init failed\n");
+        zones_free();
+        return 1;
+    }
+    if (cli_vars.verbose) printf("Backend: %s\n", cli_vars.backend->name);
+    if (cli_vars.mod_sel == MOD_PIO && !cli_vars.backend->mod_start) {
+        fprintf(stderr, "Error: backend '%s' has no PIO modulator\n", cli_vars.backend->name);
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
+
+    int clk_rc = 1;
+    if (cli_vars.clock_sel == TX_CLOCK_VIRTUAL) tx_clock_virtual_init(&tx_clock, cli_vars.have_start ? cli_vars.start : time(NULL));
+    else if (disc_cfg.enabled) {
+        // Deadlines run on CLOCK_MONOTONIC, steered towards the time source for as long as we transmit
+        int rc = -1;
+        if (cli_vars.t_src == SET_NTP) {
+            rc = tx_disc_start(&disc, &disc_cfg, tx_disc_source_ntp, (void *)cli_vars.ntp_servers, &metrics);
+            if (rc < 0) fprintf(stderr, "NTP: no server answered within %dms, disciplining to the local clock\n", NTP_TIMEOUT_MS);
+        }
+        if (rc < 0) rc = tx_disc_start(&disc, &disc_cfg, tx_disc_source_local, NULL, &metrics);
+        if (rc < 0) {
+            fprintf(stderr, "Error: time discipline init failed\n");
+            tx_backend_free(cli_vars.backend);
+            zones_free();
+            return 1;
+        }
+        if (cli_vars.verbose) printf("Time discipline: %s source, poll %us, bound %.3fms\n", disc.source == tx_disc_source_ntp ? "ntp" : "local",
+                                     disc.cfg.poll_s, disc.cfg.bound_ns / 1e6);
+        clk_rc = tx_clock_disciplined_init(&tx_clock, &disc);
+        cli_vars.disc = &disc;
+    }
+    else clk_rc = tx_clock_realtime_init(&tx_clock);
+    if (clk_rc < 0) {
+        fprintf(stderr, "Error: clock init failed\n");
+        if (cli_vars.disc) tx_disc_stop(cli_vars.disc);
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
+    // Only a clock that really sleeps can spin the rest
+    if (rt_prof.spin_core != RT_CORE_NONE && cli_vars.clock_sel != TX_CLOCK_VIRTUAL) {
+        tx_clock_spin_init(&tx_clock, &tx_spin, rt_prof.spin_margin_ns, calib_p99_ns, &metrics);
+        if (cli_vars.verbose) printf("Hybrid wait: core %d, margin %.1fus%s\n", rt_prof.spin_core, tx_spin.margin_ns / 1e3,
+                                     tx_spin.adaptive ? " (adaptive)" : "");
+    }
+    tx_clock.abort = &stop_thread;
+    cli_vars.clock = &tx_clock;
+    cli_vars.backend->clock = &tx_clock;
+
+    rt_metrics_srv_t metrics_srv = { .fd = -1 };
+    if (cli_vars.metrics_path && rt_metrics_serve_start(&metrics_srv, &metrics, cli_vars.metrics_path) < 0) {
+        fprintf(stderr, "Error: metrics endpoint init failed\n");
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
+
+    if (cli_vars.rec_path) {
+        if (fr_open(&flight_rec, cli_vars.rec_path, cli_vars.chan, cli_vars.n_chan) < 0) {
+            fprintf(stderr, "Error: flight recorder init failed\n");
+            rt_metrics_serve_stop(&metrics_srv);
+            tx_backend_free(cli_vars.backend);
+            zones_free();
+            return 1;
+        }
+        cli_vars.rec = &flight_rec;
+    }
+
+    tx_ctl_srv_t ctl_srv = { .fd = -1 };
+    if (cli_vars.control_path && tx_ctl_start(&ctl_srv, &cli_vars, cli_vars.control_path) < 0) {
+        fprintf(stderr, "Error: control socket init failed\n");
+        rt_metrics_serve_stop(&metrics_srv);
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
+
+    // Carrier: one-shot setup, the PIO runs it from here on
+    if (carrier_setup(&cli_vars) < 0) {
+        fprintf(stderr, "Error: carrier init failed\n");
+        tx_ctl_stop(&ctl_srv);
+        rt_metrics_serve_stop(&metrics_srv);
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
 
-    //Carrier Initialization thread
-    pthread_t carrier_tid;
-    pthread_create(&carrier_tid, NULL, carrier_conf, &cli_vars);
+    // The attenuator thread only queues its messages: this thread writes them
+    if (tx_log_start(&metrics) < 0) {
+        fprintf(stderr, "Error: log thread init failed\n");
+        carrier_shutdown(&cli_vars);
+        tx_ctl_stop(&ctl_srv);
+        rt_metrics_serve_stop(&metrics_srv);
+        tx_backend_free(cli_vars.backend);
+        zones_free();
+        return 1;
+    }
 
-    //Attenuator Initialization thread
+    //Attenuator thread
     pthread_t attenuator_tid;
     pthread_create(&attenuator_tid, NULL, data_tx, &cli_vars);
 
+    // Block until a signal or the end of transmission: nothing polls in the meantime
+    int tx_running = 1;
+    for (;;) {
+        struct epoll_event pe[2];
+        const int n = epoll_wait(loop_fd, pe, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t cnt;
+            if (pe[i].data.fd == sig_fd) read_signals(sig_fd);
+            else if (read(run_efd, &cnt, sizeof(cnt)) < 0) { /* Counted again below */ }
+        }
+        const int ev = atomic_exchange_explicit(&run_events, 0, memory_order_acq_rel);
+        if (ev & RUN_EV_STOP) break;
+        if (ev & RUN_EV_RESTART) {
+            struct timespec t0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            tx_thread_stop(attenuator_tid);
+            tx_running = 0;
+            atomic_fetch_and_explicit(&run_events, ~RUN_EV_DONE, memory_order_acq_rel); // Posted by the old thread
+            if (!cli_vars.keep_carrier) {
+                carrier_shutdown(&cli_vars);
+                if (carrier_setup(&cli_vars) < 0) {
+                    fprintf(stderr, "Error: carrier restart failed\n");
+                    break;
+                }
+            }
+            read_signals(sig_fd); // A stop that came in during the restart wins
+            if (atomic_load_explicit(&stop_seen, memory_order_acquire)) break;
+            atomic_store_explicit(&stop_thread, 0, memory_order_release);
+            pthread_create(&attenuator_tid, NULL, data_tx, &cli_vars);
+            tx_running = 1;
+            fprintf(stderr, "Modulator restarted in %.3f ms (carrier %s)\n", ms_since(&t0), cli_vars.keep_carrier ? "kept running" : "restarted");
+            continue;
+        }
+        if (ev & RUN_EV_DONE) break;
+    }
 
-    pthread_mutex_lock(&lck);
-    while (thread_exit == 0 && !atomic_load_explicit(&stop_thread, memory_order_acquire)) {
-        pthread_cond_wait(&ext, &lck);
+    tx_ctl_stop(&ctl_srv);
+    if (tx_running) tx_thread_stop(attenuator_tid); // Attenuator first, then the carrier
+    carrier_shutdown(&cli_vars);
+    const double off_ms = ms_since(&stop_ts);
+    tx_log_stop(); // Up to a poll interval: after the carrier is off
+    if (atomic_load_explicit(&stop_seen, memory_order_acquire)) fprintf(stderr, "Shutdown: carrier off %.3f ms after signal\n", off_ms);
+    if (cli_vars.disc) {
+        tx_disc_stop(cli_vars.disc);
+        if (cli_vars.verbose) fprintf(stderr, "Time discipline: %llu samples, %llu out of bound, %llu missed, %llu steps, last error %+.3fms, drift %+.3fppm\n",
+                                      (unsigned long long)disc.samples, (unsigned long long)disc.out_of_bound, (unsigned long long)disc.misses,
+                                      (unsigned long long)disc.steps, disc.last_err_ns / 1e6, disc.freq * 1e6);
     }
-    pthread_mutex_unlock(&lck);
 
-    handle_signal(SIGINT); //Trigger interrupt behavior to shutdown carrier after attenuator finished
+    if (tx_clock.spin && cli_vars.verbose) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const double run_ns = (double)(tx_ts_ns(&now) - tx_spin.started_ns);
+        const double spin_ns = (double)atomic_load_explicit(&metrics.spin_ns, memory_order_relaxed);
+        fprintf(stderr, "Hybrid wait: %llu waits, %.3fs spinning (%.2f%% of core %d), %llu woke past the deadline, margin %.1fus\n",
+                (unsigned long long)atomic_load_explicit(&metrics.spin_waits, memory_order_relaxed), spin_ns / 1e9,
+                run_ns > 0 ? 100.0 * spin_ns / run_ns : 0.0, rt_prof.spin_core,
+                (unsigned long long)atomic_load_explicit(&metrics.spin_overshoots, memory_order_relaxed), tx_spin.margin_ns / 1e3);
+    }
 
-    pthread_join(attenuator_tid, NULL);// Await attenuator thread to exit first
-    pthread_join(carrier_tid, NULL); //Await carrier thread to exit first
+    rt_metrics_serve_stop(&metrics_srv);
+    tx_backend_free(cli_vars.backend);
+    zones_free();
+    tx_live_destroy(&live);
+    fr_close(&flight_rec);
+    tx_clock_close(&tx_clock);
+    close(loop_fd);
+    close(sig_fd);
+    close(run_efd);
     return 0;
 }
@@ -0,0 +1,370 @@
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dcf77.h"
+#include "timecode.h"
+#include "tz_cache.h"
+#include "schedule.h"
+#include "modulator.h"
+#include "pio_emu.h"
+#include "tx_clock.h"
+#include "hw_conf.h"
+#include "parse_num.h"
+#include "version.h"
+
+/*
+dcf77-pioemu: run our PIO programs on the software model (pio_emu.h), no Pi needed.
+  modulator (default): check every attenuator edge against the CPU schedule (sched_compile_minute)
+                       for the same minutes. Words are pushed as the FIFO drains, like the hw backend.
+                       Expected edge cycle = MOD_LEAD_TICKS + (edge time - first minute) / MOD_TICK_NS.
+  carrier (-C):        run carrier_freq_program_instructions set up like pio_carrier_start() and
+                       measure period, duty cycle and divider jitter in system clocks. Fails if the
+                       program does not take (H + 3) + (L + 3) cycles per period or misses the planned frequency.
+*/
+
+#define MODE_MODULATOR 0x0
+#define MODE_CARRIER 0x1
+
+#define CARRIER_CYCLES 20000000ULL // Tens of thousands of carrier periods
+#define CARRIER_TOL_PPB 0.001      // Allowed gap between the emulated and the planned frequency
+#define FRAC_PERIODS 256            // The divider's FRAC accumulator repeats after 256 periods
+
+typedef struct emu_args {
+    uint8_t mode;
+    time_t from;
+    long count;
+    uint8_t leap;
+    uint8_t verbose;
+    const char *zone;
+    const tc_proto_t *proto;
+    uint64_t cycles;
+    uint32_t loops;  // 0 = carrier_plan()
+    uint32_t loops_low;
+    double clkdiv;
+} emu_args_t;
+
+// Carrier pin statistics, in system clocks
+typedef struct carrier_stats {
+    uint64_t rise_clk, rise_cycle, fall_clk;
+    uint64_t first_rise_clk;
+    uint64_t whole_clk;      // Rise after the last whole FRAC_PERIODS block
+    uint64_t periods;
+    uint64_t per_min, per_max;
+    uint64_t cyc_min, cyc_max;
+    uint64_t high_min, high_max, high_sum;
+    uint64_t per_ref;        // First period: deviations from it keep the variance sums small
+    double dev_sum, dev_sq_sum;
+    int have_rise;
+} carrier_stats_t;
+
+#define EXPECT_RING 512 // Two minutes of edges, power of two
+
+// Edges the CPU schedule wants, matched in order against the transitions the model produces
+typedef struct edge_check {
+    int64_t cycle[EXPECT_RING];
+    uint8_t low[EXPECT_RING];
+    uint8_t sec[EXPECT_RING];
+    time_t minute[EXPECT_RING];
+    uint32_t head, tail;
+    uint32_t last_dir;
+    uint8_t verbose;
+    long edges, bad;
+    int64_t worst;
+} edge_check_t;
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s --from time [-n minutes] [-P protocol] [-z zone] [-L] [-v]\n"
+                "       %s -C [-P protocol] [--cycles n] [--loops H [--low L] --clkdiv d]\n"
+                "Modulator:\n"
+                "  -F, --from     time        (first transmission minute: YYYY-MM-DD[THH:MM] UTC or @epoch)\n"
+                "  -n, --count    minutes     (Default: 60)\n"
+                "  -P, --protocol " TC_NAMES " (Default: dcf77; the carrier check uses its frequency)\n"
+                "  -z, --zone     name        (Default: the protocol's)\n"
+                "  -L, --leap                 (NTP leap indicator set, as in -s ntp)\n"
+                "  -v, --verbose              (Print every mismatching edge)\n"
+                "Carrier:\n"
+                "  -C, --carrier              (Check the carrier program instead)\n"
+                "  -c, --cycles   n           (State machine cycles to run, Default: 20000000)\n"
+                "  -l, --loops    H           (High delay loops, with --clkdiv; Default: carrier_plan())\n"
+                "  -w, --low      L           (Low delay loops, Default: H)\n"
+                "  -d, --clkdiv   d           (Clock divider, 1/256 resolution)\n"
+                "  -h, --help                 (This message)\n", prog, prog);
+}
+
+static int parse_args(int argc, char *argv[], emu_args_t *out){
+    *out = (emu_args_t){ .mode = MODE_MODULATOR, .count = 60, .proto = &tc_dcf77, .cycles = CARRIER_CYCLES };
+    int have_from = 0;
+
+    static const struct option longopts[] = {
+        {"from",    required_argument, 0, 'F'},
+        {"count",   required_argument, 0, 'n'},
+        {"protocol", required_argument, 0, 'P'},
+        {"zone",    required_argument, 0, 'z'},
+        {"leap",    no_argument,       0, 'L'},
+        {"verbose", no_argument,       0, 'v'},
+        {"carrier", no_argument,       0, 'C'},
+        {"cycles",  required_argument, 0, 'c'},
+        {"loops",   required_argument, 0, 'l'},
+        {"low",     required_argument, 0, 'w'},
+        {"clkdiv",  required_argument, 0, 'd'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    long long v;
+    while ((c = getopt_long(argc, argv, "F:n:P:z:LvCc:l:w:d:h", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'F':
+                if (tz_parse_utc(optarg, &out->from) != 0) {
+                    fprintf(stderr, "Error: invalid time '%s' (YYYY-MM-DD[THH:MM] or @epoch)\n\n", optarg);
+                    return -1;
+                }
+                have_from = 1;
+                break;
+            case 'n': if (parse_ll(optarg, 1, LONG_MAX, &v) < 0) goto bad_num; out->count = (long)v; break;
+            case 'P':
+                if (!(out->proto = tc_find(optarg))) { fprintf(stderr, "Error: invalid protocol '%s' (use " TC_NAMES ")\n\n", optarg); return -1; }
+                break;
+            case 'z': out->zone = optarg; break;
+            case 'L': out->leap = 1; break;
+            case 'v': out->verbose = 1; break;
+            case 'C': out->mode = MODE_CARRIER; break;
+            case 'c': if (parse_ll(optarg, 0, LLONG_MAX, &v) < 0) goto bad_num; out->cycles = (uint64_t)v; break;
+            case 'l': if (parse_ll(optarg, 0, UINT32_MAX, &v) < 0) goto bad_num; out->loops = (uint32_t)v; break;
+            case 'w': if (parse_ll(optarg, 0, UINT32_MAX, &v) < 0) goto bad_num; out->loops_low = (uint32_t)v; break;
+            case 'd': out->clkdiv = strtod(optarg, NULL); break;
+            case 'h': usage(stdout, argv[0]); exit(0);
+            default: usage(stderr, argv[0]); return -1;
+        }
+    }
+    if (out->mode == MODE_CARRIER) {
+        if ((out->loops == 0) != (out->clkdiv == 0.0) || out->cycles == 0 || (out->clkdiv != 0.0 && (out->clkdiv < 1.0 || out->clkdiv >= 65536.0))) {
+            fprintf(stderr, "Error: need both --loops and --clkdiv (1..65535), and --cycles > 0\n\n");
+            usage(stderr, argv[0]);
+            return -1;
+        }
+        return 0;
+    }
+    if (!have_from) {
+        fprintf(stderr, "Error: need --from\n\n");
+        usage(stderr, argv[0]);
+        return -1;
+    }
+    out->from -= ((out->from % 60) + 60) % 60;
+    return 0;
+
+bad_num:
+    fprintf(stderr, "Error: invalid value '%s'\n\n", optarg);
+    usage(stderr, argv[0]);
+    return -1;
+}
+
+static void expect(edge_check_t *chk, int64_t cycle, uint8_t low, const tx_edge_t *e, time_t minute){
+    const uint32_t i = chk->head++ % EXPECT_RING;
+    chk->cycle[i] = cycle;
+    chk->low[i] = low;
+    chk->sec[i] = e->sec;
+    chk->minute[i] = minute;
+    chk->edges++;
+}
+
+static void on_pins(void *arg, uint64_t cycle, uint64_t sysclk, uint32_t pins, uint32_t pindirs){
+    (void)pins;
+    (void)sysclk;
+    edge_check_t *chk = arg;
+    const uint32_t dir = (pindirs >> GPIO_LINE) & 1;
+    if (dir == chk->last_dir) return;
+    chk->last_dir = dir;
+
+    if (chk->tail == chk->head) {
+        chk->bad++;
+        if (chk->verbose) fprintf(stderr, "Cycle %llu: unexpected %s edge\n", (unsigned long long)cycle, dir ? "LOW" : "Hi-Z");
+        return;
+    }
+    const uint32_t i = chk->tail++ % EXPECT_RING;
+    const int64_t diff = (int64_t)cycle - chk->cycle[i];
+    const int64_t adiff = diff < 0 ? -diff : diff;
+    if (adiff > chk->worst) chk->worst = adiff;
+    if (diff || chk->low[i] != dir) {
+        chk->bad++;
+        if (chk->verbose) fprintf(stderr, "Minute %lld sec %d: %s edge off by %lld cycles\n", (long long)chk->minute[i], chk->sec[i], chk->low[i] ? "LOW" : "Hi-Z", (long long)diff);
+    }
+}
+
+static void on_carrier(void *arg, uint64_t cycle, uint64_t sysclk, uint32_t pins, uint32_t pindirs){
+    (void)pindirs;
+    carrier_stats_t *st = arg;
+    if (!((pins >> CARRIER_PIN) & 1)) {
+        st->fall_clk = sysclk;
+        return;
+    }
+    if (st->have_rise) {
+        const uint64_t per = sysclk - st->rise_clk, cyc = cycle - st->rise_cycle, high = st->fall_clk - st->rise_clk;
+        if (!st->periods || per < st->per_min) st->per_min = per;
+        if (!st->periods || per > st->per_max) st->per_max = per;
+        if (!st->periods || cyc < st->cyc_min) st->cyc_min = cyc;
+        if (!st->periods || cyc > st->cyc_max) st->cyc_max = cyc;
+        if (!st->periods || high < st->high_min) st->high_min = high;
+        if (!st->periods || high > st->high_max) st->high_max = high;
+        st->high_sum += high;
+        if (!st->periods) st->per_ref = per;
+        const double dev = (double)per - (double)st->per_ref;
+        st->dev_sum += dev;
+        st->dev_sq_sum += dev * dev;
+        if (++st->periods % FRAC_PERIODS == 0) st->whole_clk = sysclk;
+    } else {
+        st->first_rise_clk = sysclk;
+        st->have_rise = 1;
+    }
+    st->rise_clk = sysclk;
+    st->rise_cycle = cycle;
+}
+
+static int run_carrier(const emu_args_t *args){
+    int from_table = 0;
+    const double target = args->proto->carrier_hz;
+    clk_vals_t cv = carrier_plan(CLOCK_FREQ, target, &from_table);
+    if (args->loops) {
+        const uint32_t d = (uint32_t)round(args->clkdiv * 256.0);
+        cv = carrier_plan_eval(CLOCK_FREQ, target, args->loops, args->loops_low ? args->loops_low : args->loops, (uint16_t)(d >> 8), (uint8_t)(d & 0xff));
+    }
+
+    pio_emu_t emu;
+    carrier_stats_t st = {0};
+    pio_emu_init(&emu, carrier_freq_program_instructions, 6, 0, 5);
+    emu.set_base = CARRIER_PIN;
+    pio_emu_set_clkdiv_int_frac(&emu, cv.div_int, cv.div_frac);
+
+    // Setup exactly as pio_carrier_start(): high loops into ISR, low loops left in OSR
+    pio_emu_put(&emu, cv.loops);
+    pio_emu_put(&emu, cv.loops_low);
+    if (pio_emu_exec(&emu, 0x80a0) < 0 || pio_emu_exec(&emu, 0xa0c7) < 0 || pio_emu_exec(&emu, 0x80a0) < 0) { // pull block; mov ISR, OSR; pull block
+        fprintf(stderr, "Carrier setup failed\n");
+        return 1;
+    }
+    emu.watch = on_carrier;
+    emu.watch_arg = &st;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (pio_emu_run(&emu, args->cycles) < 0) { fprintf(stderr, "Unsupported instruction at pc=%u\n", emu.pc); return 1; }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (st.periods < FRAC_PERIODS) { fprintf(stderr, "Fewer than %d carrier periods in %llu cycles\n", FRAC_PERIODS, (unsigned long long)args->cycles); return 1; }
+
+    // Exact mean period: whole accumulator cycles only, so no partial FRAC phase is left over
+    const double ns_clk = 1e9 / CLOCK_FREQ;
+    const double mean = (double)(st.whole_clk - st.first_rise_clk) / (double)(st.periods - st.periods % FRAC_PERIODS);
+    const double dev_mean = st.dev_sum / (double)st.periods;
+    const double rms = sqrt(fmax(st.dev_sq_sum / (double)st.periods - dev_mean * dev_mean, 0.0)) * ns_clk;
+    const double f_emu = CLOCK_FREQ / mean;
+    const double err_ppb = (f_emu - cv.f_actual) / cv.f_actual * 1e9;
+    const uint64_t want_cyc = (uint64_t)cv.loops + cv.loops_low + 6;
+    const double dt = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("dcf77-pioemu v%s carrier: loops=%u/%u clkdiv=%u+%u/256 (%.9f)%s\n", DCF77_PROJECT_VERSION, cv.loops, cv.loops_low,
+           (unsigned)emu.div_int, (unsigned)emu.div_frac, (double)emu.div_int + emu.div_frac / 256.0, args->loops ? "" : from_table ? " precomputed" : " searched");
+    printf("periods=%llu cycles/period=%llu..%llu (expected %llu)\n", (unsigned long long)st.periods,
+           (unsigned long long)st.cyc_min, (unsigned long long)st.cyc_max, (unsigned long long)want_cyc);
+    printf("period=%.6fns (min %.1fns max %.1fns) jitter p-p=%.1fns (planned %u clk) rms=%.2fns\n", mean * ns_clk,
+           (double)st.per_min * ns_clk, (double)st.per_max * ns_clk, (double)(st.per_max - st.per_min) * ns_clk, cv.jitter_clk, rms);
+    printf("duty=%.4f%% (planned %.4f%%, high %.1f..%.1fns)\n", 100.0 * (double)st.high_sum / (double)(st.rise_clk - st.first_rise_clk), cv.duty * 100.0,
+           (double)st.high_min * ns_clk, (double)st.high_max * ns_clk);
+    printf("frequency=%.6fHz planned=%.6fHz target=%.1fHz (model %+.3fppb, target %+.1fppm)\n", f_emu, cv.f_actual, target,
+           err_ppb, (f_emu - target) / target * 1e6);
+    printf("%llu cycles in %.3fs (%.1f Mcycles/s)\n", (unsigned long long)emu.cycle, dt, (double)emu.cycle / dt / 1e6);
+
+    const int ok = st.cyc_min == want_cyc && st.cyc_max == want_cyc && fabs(err_ppb) <= CARRIER_TOL_PPB
+                   && st.per_max - st.per_min == cv.jitter_clk;
+    if (!ok) fprintf(stderr, "FAIL: carrier program does not match the planner model\n");
+    return ok ? 0 : 1;
+}
+
+static int run_modulator(const emu_args_t *a){
+    const emu_args_t args = *a;
+    tz_cache_t tz;
+    const tc_proto_t *p = args.proto;
+    const char *zone = args.zone ? args.zone : p->zone;
+    if (tz_cache_init(&tz, zone, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+        if (strcmp(zone, p->zone) != 0) return 1;
+        tz_cache_init_rules(&tz, p->zone, p->std_offset, p->dst_start, p->dst_end, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+    }
+    dcf77_set_zone(&tz);
+    tc_set_proto(p);
+    if (!tc_att_from_start(p)) {
+        fprintf(stderr, "%s: pulses do not start each second with attenuation, the PIO modulator cannot send them\n", p->name);
+        tz_cache_free(&tz);
+        return 1;
+    }
+
+    pio_emu_t emu;
+    edge_check_t chk = { .verbose = args.verbose };
+    pio_emu_init(&emu, modulator_program_instructions, MOD_PROGRAM_LEN, 0, MOD_PROGRAM_LEN - 1);
+    emu.set_base = GPIO_LINE;
+    emu.watch = on_pins;
+    emu.watch_arg = &chk;
+
+    const tx_chan_t chan = { .carrier_pin = CARRIER_PIN, .att_pin = GPIO_LINE, .proto = p, .tz = &tz };
+    tx_minute_t minute;
+    uint32_t words[MOD_MAX_SECONDS];
+    time_t due[MOD_MAX_SECONDS];
+    uint8_t leap = args.leap;
+    uint8_t state = 0; // Line starts in Hi-Z
+    const int64_t origin_ns = (int64_t)args.from * 1000000000LL;
+    int64_t leap_ticks = 0; // Inserted seconds so far: the modulator runs on while UTC repeats :59
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (long i = 0; i < args.count; i++) {
+        const time_t start = args.from + (time_t)i * 60;
+        sched_compile_minute(&chan, 1, start, &leap, &minute);
+        const int n = mod_compile_minute(&minute, 0, words, due);
+        if (n < 0) { fprintf(stderr, "Minute %lld: no valid modulator words\n", (long long)start); return 1; }
+
+        // Same transition filter as the hw edge engine; Carrier = pin driven LOW
+        for (int e = 0; e < minute.n_edges; e++) {
+            const uint8_t low = minute.edge[e].state == Carrier;
+            if (low == state) continue;
+            state = low;
+            expect(&chk, (tx_ts_ns(&minute.edge[e].at) - origin_ns) / MOD_TICK_NS + leap_ticks + MOD_LEAD_TICKS, low, &minute.edge[e], start);
+        }
+        leap_ticks += (n - 60) * (int64_t)MOD_TICKS_SEC;
+
+        // Words go in as the FIFO drains, like the hw backend's blocking push
+        for (int s = 0; s < n; s++) {
+            while (pio_emu_put(&emu, words[s]) < 0) {
+                if (pio_emu_step(&emu) < 0) { fprintf(stderr, "Unsupported instruction at pc=%u\n", emu.pc); return 1; }
+            }
+        }
+    }
+    // Drain: everything pushed has been executed once the model stalls on an empty FIFO
+    while (emu.tx_level || emu.pc != 0) {
+        if (pio_emu_step(&emu) < 0) { fprintf(stderr, "Unsupported instruction at pc=%u\n", emu.pc); return 1; }
+    }
+    if (chk.tail != chk.head) {
+        chk.bad += chk.head - chk.tail;
+        if (args.verbose) fprintf(stderr, "%u edges never produced\n", chk.head - chk.tail);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    const double dt = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("dcf77-pioemu v%s: %ld minutes, %ld edges, %ld mismatches, worst %lld cycles (%.1fus)\n",
+           DCF77_PROJECT_VERSION, args.count, chk.edges, chk.bad, (long long)chk.worst, (double)chk.worst * MOD_TICK_NS / 1000.0);
+    printf("%llu cycles (%llu stalled) in %.3fs (%.1f Mcycles/s)\n", (unsigned long long)emu.cycle,
+           (unsigned long long)emu.stalls, dt, (double)emu.cycle / dt / 1e6);
+
+    tz_cache_free(&tz);
+    return chk.bad ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    emu_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+    return args.mode == MODE_CARRIER ? run_carrier(&args) : run_modulator(&args);
+}
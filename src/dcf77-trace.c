@@ -0,0 +1,186 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "flight_rec.h"
+#include "timecode.h"
+#include "tz_cache.h"
+#include "hw_conf.h"
+#include "parse_num.h"
+#include "version.h"
+
+/*
+dcf77-trace: read the transmitter's flight recorder (-r) while it runs or after it stopped.
+Only maps the file read-only: the transmitter never waits for it.
+  per minute (default)  minute on air, channel, protocol, the time the frame decodes to, edge count and lateness
+  -e                    every edge: deadline, channel, second, state, lateness
+*/
+
+typedef struct trace_args {
+    const char *path;
+    double hours;
+    int chan;
+    uint8_t edges;
+} trace_args_t;
+
+// Per-channel minute being summed up
+typedef struct minute_acc {
+    int64_t minute;  // Minute start on air, 0 = empty
+    tc_frame_t frame;
+    uint32_t edges;
+    uint32_t timed;  // Edges with an applied time (not PIO-timed)
+    int64_t late_sum_ns;
+    int64_t late_max_ns;
+} minute_acc_t;
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s [-f file] [-H hours] [-c channel] [-e]\n"
+                "  -f, --file     path        (Default: " FR_DEFAULT_PATH ")\n"
+                "  -H, --hours    h           (Span before the newest entry, Default: 1, 0 = whole ring)\n"
+                "  -c, --channel  n           (Only this channel)\n"
+                "  -e, --edges                (One line per edge instead of per minute)\n"
+                "  -h, --help                 (This message)\n", prog);
+}
+
+static int parse_args(int argc, char *argv[], trace_args_t *out){
+    *out = (trace_args_t){ .path = FR_DEFAULT_PATH, .hours = 1.0, .chan = -1 };
+
+    static const struct option longopts[] = {
+        {"file",    required_argument, 0, 'f'},
+        {"hours",   required_argument, 0, 'H'},
+        {"channel", required_argument, 0, 'c'},
+        {"edges",   no_argument,       0, 'e'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    char *end;
+    while ((c = getopt_long(argc, argv, "f:H:c:eh", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'f': out->path = optarg; break;
+            case 'H':
+                out->hours = strtod(optarg, &end);
+                if (end == optarg || *end || out->hours < 0) { fprintf(stderr, "Error: invalid hours '%s'\n\n", optarg); return -1; }
+                break;
+            case 'c':
+                if (parse_int(optarg, 0, TX_MAX_CHANNELS - 1, &out->chan) < 0) { fprintf(stderr, "Error: invalid channel '%s'\n\n", optarg); return -1; }
+                break;
+            case 'e': out->edges = 1; break;
+            case 'h': usage(stdout, argv[0]); exit(0);
+            default: usage(stderr, argv[0]); return -1;
+        }
+    }
+    return 0;
+}
+
+static void put_utc(char *buf, size_t len, int64_t ns, const char *fmt){
+    const time_t t = (time_t)(ns / 1000000000LL);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, len, fmt, &tm);
+}
+
+static int has_src(const tc_proto_t *p, int src){
+    for (int i = 0; i < p->n_fields; i++) if (p->field[i].src == src) return 1;
+    return 0;
+}
+
+// The time a frame carries, as a receiver would show it
+static void put_decoded(char *buf, size_t len, const tc_proto_t *p, const tc_frame_t *f){
+    unsigned v[TC_SRC_COUNT];
+    const int ok = tc_decode(p, f, v);
+    const int year = 2000 + (int)v[TC_SRC_YEAR];
+    int mon = (int)v[TC_SRC_MON], mday = (int)v[TC_SRC_MDAY];
+    if (!has_src(p, TC_SRC_MON) && v[TC_SRC_YDAY]) {
+        int y;
+        tz_civil_from_days(tz_days_from_civil(year, 1, 1) + v[TC_SRC_YDAY] - 1, &y, &mon, &mday);
+    }
+    const char *flag = p->utc_fields ? "UTC" : has_src(p, TC_SRC_DST) ? (v[TC_SRC_DST] ? "dst" : "std") : "";
+    snprintf(buf, len, "%04d-%02d-%02d %02u:%02u %-3s%s%s", year, mon, mday, v[TC_SRC_HOUR], v[TC_SRC_MIN], flag,
+             (f->a & TC_LEAP_MINUTE) ? " leap" : "", ok < 0 ? " parity error" : "");
+}
+
+static void flush_minute(const fr_header_t *h, int chan, minute_acc_t *acc){
+    if (!acc->minute) return;
+    const tc_proto_t *p = tc_find(h->proto[chan]);
+    char on_air[32], decoded[64] = "?";
+    put_utc(on_air, sizeof(on_air), acc->minute * 1000000000LL, "%Y-%m-%dT%H:%MZ");
+    if (p) put_decoded(decoded, sizeof(decoded), p, &acc->frame);
+
+    printf("%s ch%d %-6s -> %-32s %3u edges", on_air, chan, h->proto[chan], decoded, acc->edges);
+    if (acc->timed) printf("  late avg %.1fus max %.1fus", acc->late_sum_ns / 1e3 / acc->timed, acc->late_max_ns / 1e3);
+    else printf("  PIO timed");
+    printf("\n");
+    acc->minute = 0;
+}
+
+int main(int argc, char *argv[]){
+    trace_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+
+    flight_rec_t fr;
+    if (fr_attach(&fr, args.path) < 0) return 1;
+    const fr_header_t *h = fr.hdr;
+    const uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+    const uint64_t cap = h->capacity;
+    const uint64_t first = head > cap ? head - cap : 0;
+
+    // Newest readable entry sets the end of the span (the recording may be old, or on a simulated clock)
+    fr_entry_t e;
+    int64_t newest = 0;
+    for (uint64_t n = head; n > first && !newest; n--) {
+        if (fr_read(&fr, n - 1, &e)) newest = e.deadline_ns;
+    }
+    if (!newest) {
+        printf("%s: no edges recorded\n", args.path);
+        fr_close(&fr);
+        return 0;
+    }
+    const int64_t from = args.hours > 0 ? newest - (int64_t)(args.hours * 3600e9) : INT64_MIN;
+
+    char started[32];
+    put_utc(started, sizeof(started), h->started_ns, "%Y-%m-%dT%H:%M:%SZ");
+    printf("# %s v%s: %s, started %s, %llu edges recorded, %u channel%s\n", DCF77_PROJECT_NAME, DCF77_PROJECT_VERSION, args.path, started,
+           (unsigned long long)head, h->n_chan, h->n_chan == 1 ? "" : "s");
+
+    minute_acc_t acc[TX_MAX_CHANNELS] = {0};
+    uint64_t lost = 0;
+    for (uint64_t n = first; n < head; n++) {
+        // Entries the writer has moved past since we looked at head are lost, not an error
+        if (!fr_read(&fr, n, &e)) { lost++; continue; }
+        if (e.deadline_ns < from || e.chan >= TX_MAX_CHANNELS) continue;
+        if (args.chan >= 0 && e.chan != args.chan) continue;
+
+        if (args.edges) {
+            char at[32];
+            put_utc(at, sizeof(at), e.deadline_ns, "%Y-%m-%dT%H:%M:%S");
+            printf("%s.%03lldZ ch%u :%02u %s", at, (long long)(e.deadline_ns % 1000000000LL / 1000000), e.chan, e.sec,
+                   e.state == Carrier_MOD ? "att " : "full");
+            if (e.actual_ns) printf(" late %+.1fus\n", (e.actual_ns - e.deadline_ns) / 1e3);
+            else printf(" PIO\n");
+            continue;
+        }
+
+        const int64_t minute = e.deadline_ns / 1000000000LL - (e.sec < 60 ? e.sec : 59);
+        minute_acc_t *a = &acc[e.chan];
+        if (a->minute != minute) {
+            flush_minute(h, e.chan, a);
+            *a = (minute_acc_t){ .minute = minute, .frame = { .a = e.frame, .b = e.frame_b } };
+        }
+        a->edges++;
+        if (e.actual_ns) {
+            const int64_t late = e.actual_ns - e.deadline_ns;
+            a->timed++;
+            a->late_sum_ns += late;
+            if (late > a->late_max_ns) a->late_max_ns = late;
+        }
+    }
+    for (int c = 0; c < TX_MAX_CHANNELS; c++) flush_minute(h, c, &acc[c]);
+    if (lost) printf("# %llu entries overwritten while reading\n", (unsigned long long)lost);
+
+    fr_close(&fr);
+    return 0;
+}
@@ -0,0 +1,378 @@
+#include <getopt.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dcf77.h"
+#include "timecode.h"
+#include "tz_cache.h"
+#include "parse_num.h"
+#include "version.h"
+
+/*
+dcf77-verify: encode every transmission minute of a range of years, decode each frame with a reference decoder
+and compare it with the time worked out independently of the encoder.
+  reference time     EU rules as arithmetic (CEST from the last Sunday of March to the last Sunday of October,
+                     01:00 UTC), its own civil calendar: no tz_cache, no libc time zone
+  reference decoder  DCF77 bit by bit from the PTB layout: markers, BCD digits, ranges, the three even parities
+Also checks that the table-driven encoder (tc_encode, DCF77) sends the same frame as dcf77_encode().
+Days are handed out to a thread pool; the earliest mismatches are printed in time order.
+*/
+
+#define DEFAULT_FIRST 2000
+#define DEFAULT_LAST 2099
+#define DEFAULT_SHOW 20
+#define DAY_MINUTES 1440
+#define VERIFY_ZONE "Europe/Berlin" // The reference knows the EU rules only
+
+typedef struct verify_args {
+    int first;
+    int last;
+    int threads;
+    int show;
+} verify_args_t;
+
+typedef struct ref_time {
+    int year, mon, mday, wday, hour, min; // Local; wday 1 = Monday
+    uint8_t dst;
+    uint8_t announce; // Change within the next hour (A1)
+} ref_time_t;
+
+typedef struct decoded {
+    int year, mon, mday, wday, hour, min;
+    uint8_t a1, z1, z2, a2;
+    uint8_t parity_ok;
+    uint8_t format_ok; // Markers, BCD digits and ranges
+} decoded_t;
+
+typedef struct mismatch {
+    time_t minute;
+    uint64_t frame;
+    char what[64];
+} mismatch_t;
+
+typedef struct worker {
+    pthread_t tid;
+    uint64_t frames;
+    uint64_t bad;
+    int n_kept;
+    mismatch_t *kept; // The worker's earliest, at most verify_args_t.show
+} worker_t;
+
+static const tz_cache_t *zone;
+static int64_t first_day, n_days;
+static _Atomic int64_t next_day;
+static int show;
+
+/*--------------------------- REFERENCE TIME ------------------------*/
+
+static int64_t floor_div(int64_t a, int64_t b){
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t days_of(int y, int m, int d){
+    static const int before[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    const int64_t yy = y - 1;
+    const int64_t leap = (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)) && m > 2;
+    return 365 * yy + floor_div(yy, 4) - floor_div(yy, 100) + floor_div(yy, 400) + before[m - 1] + leap + d - 1 - 719162;
+}
+
+static void date_of(int64_t days, int *y, int *m, int *d){
+    // Every minute of a day asks for the same date
+    static _Thread_local int64_t last = INT64_MIN;
+    static _Thread_local int ly, lm, ld;
+    if (days == last) {
+        *y = ly; *m = lm; *d = ld;
+        return;
+    }
+    // Year estimate, then correct by at most one either way
+    int yy = 1970 + (int)floor_div(days * 400, 146097);
+    while (days_of(yy, 1, 1) > days) yy--;
+    while (days_of(yy + 1, 1, 1) <= days) yy++;
+    int mm = 12;
+    while (days_of(yy, mm, 1) > days) mm--;
+    *y = ly = yy;
+    *m = lm = mm;
+    *d = ld = (int)(days - days_of(yy, mm, 1)) + 1;
+    last = days;
+}
+
+// 01:00 UTC on the last Sunday of a 31-day month
+static int64_t eu_change(int y, int m){
+    const int64_t last = days_of(y, m, 31);
+    const int64_t sunday = last - (last + 4) % 7; // 1970-01-01 was a Thursday
+    return sunday * 86400 + 3600;
+}
+
+// What the frame sent during minute t must say: the local time of t + 60
+static void reference(time_t t, ref_time_t *r){
+    const int64_t e = (int64_t)t + 60;
+    int y, m, d;
+    date_of(floor_div(e, 86400), &y, &m, &d);
+    static _Thread_local int year = -1;
+    static _Thread_local int64_t on, off, on_next;
+    if (y != year) {
+        year = y;
+        on = eu_change(y, 3);
+        off = eu_change(y, 10);
+        on_next = eu_change(y + 1, 3);
+    }
+    r->dst = e >= on && e < off;
+    const int64_t next = e < on ? on : e < off ? off : on_next;
+    r->announce = next - e <= 3600;
+
+    const int64_t local = e + 3600 + (r->dst ? 3600 : 0);
+    const int64_t days = floor_div(local, 86400);
+    const int64_t secs = local - days * 86400;
+    date_of(days, &r->year, &r->mon, &r->mday);
+    r->hour = (int)(secs / 3600);
+    r->min = (int)(secs % 3600 / 60);
+    r->wday = (int)((days + 3) % 7) + 1;
+}
+
+/*--------------------------- REFERENCE DECODER ------------------------*/
+
+static int bit(uint64_t f, int n){ return (int)((f >> n) & 1); }
+
+// BCD field of n bits from 'from', weights 1 2 4 8 10 20 40 80; each digit must be 0-9
+static int bcd(uint64_t f, int from, int n, uint8_t *ok){
+    static const int weight[] = { 1, 2, 4, 8, 10, 20, 40, 80 };
+    int v = 0, lo = 0, hi = 0;
+    for (int i = 0; i < n; i++) {
+        if (!bit(f, from + i)) continue;
+        v += weight[i];
+        if (i < 4) lo += weight[i];
+        else hi += weight[i] / 10;
+    }
+    if (lo > 9 || hi > 9) *ok = 0;
+    return v;
+}
+
+// Bits from..to inclusive (the parity bit included) hold an even number of ones
+static int even(uint64_t f, int from, int to){
+    const uint64_t mask = (1ULL << (to - from + 1)) - 1;
+    return __builtin_popcountll((f >> from) & mask) % 2 == 0;
+}
+
+static void decode(uint64_t f, decoded_t *d){
+    uint8_t ok = 1;
+    d->a1 = (uint8_t)bit(f, 16);
+    d->z1 = (uint8_t)bit(f, 17);
+    d->z2 = (uint8_t)bit(f, 18);
+    d->a2 = (uint8_t)bit(f, 19);
+    d->min  = bcd(f, 21, 7, &ok);
+    d->hour = bcd(f, 29, 6, &ok);
+    d->mday = bcd(f, 36, 6, &ok);
+    d->wday = bcd(f, 42, 3, &ok);
+    d->mon  = bcd(f, 45, 5, &ok);
+    d->year = bcd(f, 50, 8, &ok);
+    d->parity_ok = (uint8_t)(even(f, 21, 28) && even(f, 29, 35) && even(f, 36, 58));
+
+    // Start of minute 0, start of time 1, no warnings or call bit, exactly one of Z1/Z2, nothing past second 58
+    if ((f & 0xffff) || !bit(f, 20) || d->z1 == d->z2 || (f >> 59)) ok = 0;
+    if (d->min > 59 || d->hour > 23 || d->mday < 1 || d->mday > 31 || d->wday < 1 || d->mon < 1 || d->mon > 12) ok = 0;
+    d->format_ok = ok;
+}
+
+/*--------------------------- SWEEP ------------------------*/
+
+static void put_utc(char *buf, size_t len, time_t t){
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buf, len, "%Y-%m-%dT%H:%MZ", &tm);
+}
+
+static void add_field(char *what, size_t len, const char *name){
+    const size_t n = strlen(what);
+    snprintf(what + n, len - n, "%s%s", n ? "," : "", name);
+}
+
+// Fields the frame gets wrong, empty when it is right
+static void compare(time_t t, uint64_t f, char *what, size_t len){
+    ref_time_t r;
+    decoded_t d;
+    reference(t, &r);
+    decode(f, &d);
+    what[0] = '\0';
+    if (!d.format_ok) add_field(what, len, "format");
+    if (!d.parity_ok) add_field(what, len, "parity");
+    if (d.year != r.year % 100) add_field(what, len, "year");
+    if (d.mon != r.mon) add_field(what, len, "month");
+    if (d.mday != r.mday) add_field(what, len, "day");
+    if (d.wday != r.wday) add_field(what, len, "weekday");
+    if (d.hour != r.hour) add_field(what, len, "hour");
+    if (d.min != r.min) add_field(what, len, "minute");
+    if (d.z1 != r.dst || d.z2 == r.dst) add_field(what, len, "dst");
+    if (d.a1 != r.announce) add_field(what, len, "A1");
+    if (d.a2) add_field(what, len, "A2");
+}
+
+static void keep(worker_t *w, time_t t, uint64_t f, const char *what){
+    w->bad++;
+    if (w->n_kept >= show) return;
+    mismatch_t *m = &w->kept[w->n_kept++];
+    m->minute = t;
+    m->frame = f;
+    snprintf(m->what, sizeof(m->what), "%s", what);
+}
+
+static void *sweep(void *args){
+    worker_t *w = (worker_t *)args;
+    dcf77_frame_t frame[DAY_MINUTES];
+    char what[64];
+
+    for (;;) {
+        const int64_t day = atomic_fetch_add_explicit(&next_day, 1, memory_order_relaxed);
+        if (day >= n_days) break;
+        const time_t t0 = (time_t)((first_day + day) * 86400);
+        dcf77_encode_range(t0, DAY_MINUTES, zone, 0, frame);
+
+        for (int i = 0; i < DAY_MINUTES; i++) {
+            const time_t t = t0 + (time_t)i * 60;
+            compare(t, frame[i], what, sizeof(what));
+            const tc_frame_t tf = tc_encode(&tc_dcf77, t, zone, 0);
+            if (tf.a != frame[i] || tf.b) add_field(what, sizeof(what), "tc_encode");
+            if (what[0]) keep(w, t, frame[i], what);
+        }
+        w->frames += DAY_MINUTES;
+    }
+    return NULL;
+}
+
+static int cmp_minute(const void *a, const void *b){
+    const time_t x = ((const mismatch_t *)a)->minute, y = ((const mismatch_t *)b)->minute;
+    return (x > y) - (x < y);
+}
+
+static void print_mismatch(const mismatch_t *m){
+    ref_time_t r;
+    decoded_t d;
+    reference(m->minute, &r);
+    decode(m->frame, &d);
+    char at[32];
+    put_utc(at, sizeof(at), m->minute);
+    printf("%s frame=0x%016llx want %04d-%02d-%02d %02d:%02d wday %d %s A1=%u  got %02d-%02d-%02d %02d:%02d wday %d Z1=%u Z2=%u A1=%u  [%s]\n",
+           at, (unsigned long long)m->frame, r.year, r.mon, r.mday, r.hour, r.min, r.wday, r.dst ? "CEST" : "CET ", r.announce,
+           d.year, d.mon, d.mday, d.hour, d.min, d.wday, d.z1, d.z2, d.a1, m->what);
+}
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(FILE *out, const char *prog){
+    fprintf(out,"Usage: %s [-F year] [-T year] [-j threads] [-m count]\n"
+                "  -F, --from     year        (First year of transmission minutes, UTC, Default: %d)\n"
+                "  -T, --to       year        (Last year, inclusive, Default: %d)\n"
+                "  -j, --threads  n           (Default: all cores)\n"
+                "  -m, --show     count       (Mismatches printed, earliest first, Default: %d)\n"
+                "  -h, --help                 (This message)\n", prog, DEFAULT_FIRST, DEFAULT_LAST, DEFAULT_SHOW);
+}
+
+static int parse_args(int argc, char *argv[], verify_args_t *out){
+    *out = (verify_args_t){ .first = DEFAULT_FIRST, .last = DEFAULT_LAST, .threads = (int)sysconf(_SC_NPROCESSORS_ONLN), .show = DEFAULT_SHOW };
+
+    static const struct option longopts[] = {
+        {"from",    required_argument, 0, 'F'},
+        {"to",      required_argument, 0, 'T'},
+        {"threads", required_argument, 0, 'j'},
+        {"show",    required_argument, 0, 'm'},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "F:T:j:m:h", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'F':
+                if (parse_int(optarg, TZ_FIRST_YEAR, TZ_LAST_YEAR - 1, &out->first) < 0) { fprintf(stderr, "Error: invalid year '%s'\n\n", optarg); return -1; }
+                break;
+            case 'T':
+                if (parse_int(optarg, TZ_FIRST_YEAR, TZ_LAST_YEAR - 1, &out->last) < 0) { fprintf(stderr, "Error: invalid year '%s'\n\n", optarg); return -1; }
+                break;
+            case 'j':
+                if (parse_int(optarg, 1, 1024, &out->threads) < 0) { fprintf(stderr, "Error: invalid thread count '%s'\n\n", optarg); return -1; }
+                break;
+            case 'm':
+                if (parse_int(optarg, 0, 1000000, &out->show) < 0) { fprintf(stderr, "Error: invalid count '%s'\n\n", optarg); return -1; }
+                break;
+            case 'h': usage(stdout, argv[0]); exit(0);
+            default: usage(stderr, argv[0]); return -1;
+        }
+    }
+    if (out->last < out->first) {
+        fprintf(stderr, "Error: --to is before --from\n\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    verify_args_t args;
+    if (parse_args(argc, argv, &args) != 0) return 1;
+    if (args.threads < 1) args.threads = 1;
+
+    tz_cache_t tz;
+    if (tz_cache_init(&tz, VERIFY_ZONE, TZ_FIRST_YEAR, TZ_LAST_YEAR) < 0) {
+        tz_cache_init_rules(&tz, VERIFY_ZONE, 3600, &startRule, &endRule, TZ_FIRST_YEAR, TZ_LAST_YEAR);
+    }
+    zone = &tz;
+    show = args.show;
+    first_day = days_of(args.first, 1, 1);
+    n_days = days_of(args.last + 1, 1, 1) - first_day;
+    atomic_init(&next_day, 0);
+
+    worker_t *w = calloc((size_t)args.threads, sizeof(*w));
+    mismatch_t *kept = calloc((size_t)args.threads * (size_t)(show ? show : 1), sizeof(*kept));
+    if (!w || !kept) {
+        perror("calloc");
+        free(w);
+        free(kept);
+        tz_cache_free(&tz);
+        return 1;
+    }
+
+    const double t0 = now_s();
+    int started = 0;
+    for (int i = 0; i < args.threads; i++) {
+        w[i].kept = kept + (size_t)i * (size_t)(show ? show : 1);
+        if (pthread_create(&w[i].tid, NULL, sweep, &w[i]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        started++;
+    }
+    if (!started) sweep(&w[started++]); // Nothing to share the work with: sweep here
+
+    uint64_t frames = 0, bad = 0;
+    int n_kept = 0;
+    for (int i = 0; i < started; i++) {
+        if (w[i].tid) pthread_join(w[i].tid, NULL);
+        frames += w[i].frames;
+        bad += w[i].bad;
+        // Workers' lists pack down into one, then the earliest are printed
+        memmove(kept + n_kept, w[i].kept, (size_t)w[i].n_kept * sizeof(*kept));
+        n_kept += w[i].n_kept;
+    }
+    const double dt = now_s() - t0;
+
+    qsort(kept, (size_t)n_kept, sizeof(*kept), cmp_minute);
+    for (int i = 0; i < n_kept && i < show; i++) print_mismatch(&kept[i]);
+
+    printf("# %s v%s: %d-%d %s\n", DCF77_PROJECT_NAME, DCF77_PROJECT_VERSION, args.first, args.last, VERIFY_ZONE);
+    printf("frames=%llu mismatches=%llu threads=%d seconds=%.3f frames_per_sec=%.0f\n", (unsigned long long)frames, (unsigned long long)bad,
+           started, dt, frames / (dt > 0 ? dt : 1e-9));
+
+    free(kept);
+    free(w);
+    tz_cache_free(&tz);
+    return bad ? 1 : 0;
+}
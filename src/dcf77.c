@@ -1,10 +1,16 @@
 #include <time.h>
 #include "dcf77.h"
+#include "tz_cache.h"
 
 uint64_t minute_frame = 0;
 // European Union Rules: Berlin - CET-1CEST,M3.5.0/2,M10.5.0/3
-DSTRule_t startRule = {3, 5, 0, 2, 0}; // Last Sun in March at 2am
-DSTRule_t endRule =   {10, 5, 0, 3, 0}; // Last Sun in Oct at 3am
+const DSTRule_t startRule = {3, 5, 0, 2, 0}; // Last Sun in March at 2am
+const DSTRule_t endRule =   {10, 5, 0, 3, 0}; // Last Sun in Oct at 3am
+
+// Transmitted zone, built once at startup and only read afterwards (NULL = UTC)
+static const tz_cache_t *tx_zone = NULL;
+
+void dcf77_set_zone(const struct tz_cache *tz){ tx_zone = tz; }
 
 int weekday(int y, int m, int d) {
     static const int t[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
@@ -30,78 +36,78 @@ int get_last_sunday(int year, int month) {
     return days - w;                     // back to Sunday
 }
 
-void calculate_dst_flag(struct tm *t) {
-    // Logic Check
-    int year = t->tm_year + 2000; //Year sent is on 0 - 99 scale
-    
-    //DST Always happens on last sunday of March && October
-    int last_sun_march = get_last_sunday(year , startRule.month);
-    int last_sun_oct = get_last_sunday(year, endRule.month);
-
-    //printf("Start: March %d, End: Oct %d \n", last_sun_march, last_sun_oct);
-
-    startRule.mday = (uint8_t) last_sun_march;
-    endRule.mday = (uint8_t) last_sun_oct;
-}
-
-uint8_t toggle_calc(struct tm* t){
-    //When the DST start day & month occurs, return 1 only if it's within 1hr before the event (happens on 02:00)
-    if (t->tm_mon == startRule.month && t->tm_mday == startRule.mday && t->tm_hour == startRule.hour-1) return 1;
-    //When the DST end day & month occurs, return 1 only if it's within 1hr before the event (happens on 03:00)
-    if (t->tm_mon == endRule.month && t->tm_mday == endRule.mday && t->tm_hour == endRule.hour-1) return 1;
-    return 0;
-}
-
 uint8_t leap_calc(int hr, uint8_t active){
     if (active && hr == 23) return 1;
     else return 0;
 }
 
-uint64_t bcd_conv(uint8_t n) { return ( ( (n / 10) % 10) << 4 ) | ( n % 10 ); }
+// 0-99 -> packed BCD
+static const uint8_t bcd_lut[100] = {
+    0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09, 0x10,0x11,0x12,0x13,0x14,0x15,0x16,0x17,0x18,0x19,
+    0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27,0x28,0x29, 0x30,0x31,0x32,0x33,0x34,0x35,0x36,0x37,0x38,0x39,
+    0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49, 0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+    0x60,0x61,0x62,0x63,0x64,0x65,0x66,0x67,0x68,0x69, 0x70,0x71,0x72,0x73,0x74,0x75,0x76,0x77,0x78,0x79,
+    0x80,0x81,0x82,0x83,0x84,0x85,0x86,0x87,0x88,0x89, 0x90,0x91,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99
+};
+
+// Parity groups as bit masks
+#define MASK_MIN  0x000000000FE00000ULL // 21 - 27
+#define MASK_HOUR 0x00000007E0000000ULL // 29 - 34
+#define MASK_DATE 0x03FFFFF000000000ULL // 36 - 57
+
+uint64_t bcd_conv(uint8_t n) { return bcd_lut[n % 100]; }
+
+static inline uint64_t parity64(uint64_t v){ return (uint64_t)(__builtin_popcountll(v) & 1); }
 
 uint64_t even_parity(int start, int end){
-    uint64_t parity = 0;
-    for (int i = start; i <= end; ++i){ parity ^= (minute_frame >> i) & 1ULL; }
-    return parity & 0x1;
+    const uint64_t mask = (end >= 63 ? ~0ULL : ((1ULL << (end + 1)) - 1)) & ~((1ULL << start) - 1);
+    return parity64(minute_frame & mask);
 }
 
-bit_mod_t set_modulation(int bit_sec){
-    if (bit_sec == 59 && (minute_frame & (1ULL << 60))) return (bit_mod_t){Carrier_MOD, 100};
+bit_mod_t dcf77_modulation(dcf77_frame_t frame, int bit_sec){
+    if (bit_sec == 59 && (frame & (1ULL << 60))) return (bit_mod_t){Carrier_MOD, 100};
     if (bit_sec > 58) return (bit_mod_t){Carrier, 0};
-    return (bit_mod_t){Carrier_MOD, (minute_frame & (1ULL << bit_sec)) ? 200 : 100};
+    return (bit_mod_t){Carrier_MOD, (frame & (1ULL << bit_sec)) ? 200 : 100};
 }
 
-void tx_block_prep(time_t t_min, uint8_t *ntp_leap){
+bit_mod_t set_modulation(int bit_sec){ return dcf77_modulation(minute_frame, bit_sec); }
+
+dcf77_frame_t dcf77_encode(time_t t_min, const struct tz_cache *tz, uint8_t ntp_leap){
+    // NTP announces an insertion for the end of the UTC day: A2 during its last hour, whatever the zone
+    const int64_t tod = ((int64_t)t_min % 86400 + 86400) % 86400;
     t_min += 60;
-    struct tm tx_time;
-    localtime_r(&t_min, &tx_time);
-    //Value corrections
-    tx_time.tm_mon += 1;
-    tx_time.tm_wday = tx_time.tm_wday == 0 ? 7 : tx_time.tm_wday;
-    tx_time.tm_year = tx_time.tm_year % 100; // year tm starts from 1900. DCF77 expects 0-99 within century.
-    uint8_t leap_sec = *ntp_leap ? 0 : leap_calc(tx_time.tm_hour, *ntp_leap);
-    calculate_dst_flag(&tx_time);
-    uint8_t dst_toggle = toggle_calc(&tx_time);
-
-    minute_frame = 0;
-
-    minute_frame |= bcd_conv(tx_time.tm_year)  << 50;
-    minute_frame |= bcd_conv(tx_time.tm_mon) << 45;
-    minute_frame |= bcd_conv(tx_time.tm_wday) << 42;
-    minute_frame |= bcd_conv(tx_time.tm_mday) << 36;
-    minute_frame |= bcd_conv(tx_time.tm_hour) << 29;
-    minute_frame |= bcd_conv(tx_time.tm_min) << 21;
-    minute_frame |= 1ULL << 20;
-    minute_frame |= bcd_conv(leap_sec) << 19;
-    minute_frame |= bcd_conv(tx_time.tm_isdst ? 0 : 1) << 18;
-    minute_frame |= bcd_conv(tx_time.tm_isdst) << 17;
-    minute_frame |= bcd_conv(dst_toggle) << 16;
-
-    minute_frame |= even_parity(36, 57) << 58;
-    minute_frame |= even_parity(29, 34) << 35;
-    minute_frame |= even_parity(21, 27) << 28;
-
-
-    if (tx_time.tm_hour == 23 && tx_time.tm_min == 59 && leap_sec) minute_frame |= 1ULL << 60; // Unused 60th position as 23:59:00 leap second trigger
-    return;
+    // Offset, DST and the change announcement come from the cached transition table: no libc, no globals
+    tz_local_t tx_time;
+    tz_localtime(tz, t_min, &tx_time);
+    const uint64_t is_dst = tx_time.info.is_dst;
+    const uint8_t leap_sec = ntp_leap == 1 && tod >= 86400 - 3600;
+
+    dcf77_frame_t frame = 1ULL << 20;
+    frame |= (uint64_t)bcd_lut[tx_time.year % 100] << 50; // DCF77 expects 0-99 within century.
+    frame |= (uint64_t)bcd_lut[tx_time.mon] << 45;
+    frame |= (uint64_t)tx_time.wday << 42;
+    frame |= (uint64_t)bcd_lut[tx_time.mday] << 36;
+    frame |= (uint64_t)bcd_lut[tx_time.hour] << 29;
+    frame |= (uint64_t)bcd_lut[tx_time.min] << 21;
+    frame |= (uint64_t)leap_sec << 19;
+    frame |= (is_dst ^ 1) << 18;
+    frame |= is_dst << 17;
+    frame |= (uint64_t)tx_time.info.announce << 16;
+
+    frame |= parity64(frame & MASK_DATE) << 58;
+    frame |= parity64(frame & MASK_HOUR) << 35;
+    frame |= parity64(frame & MASK_MIN) << 28;
+
+    if (leap_sec && tod == 86400 - 60) frame |= 1ULL << 60; // Unused 60th position as the 23:59 UTC leap second trigger
+    return frame;
+}
+
+void dcf77_encode_range(time_t t_min, size_t count, const struct tz_cache *tz, uint8_t ntp_leap, dcf77_frame_t *out){
+    for (size_t i = 0; i < count; ++i, t_min += 60) out[i] = dcf77_encode(t_min, tz, ntp_leap);
+}
+
+const struct tz_cache *dcf77_zone(void){ return tx_zone; }
+
+void tx_block_prep(time_t t_min, uint8_t *ntp_leap){
+    minute_frame = dcf77_encode(t_min, tx_zone, *ntp_leap);
 }
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/timex.h>
+
+#include "discipline.h"
+#include "net_ntp.h"
+#include "rt_metrics.h"
+#include "hw_conf.h"
+#include "parse_num.h"
+
+#define NS 1000000000LL
+#define DAY_NS (86400LL * NS)
+#define LEAP_NONE INT64_MAX
+
+void tx_disc_cfg_defaults(tx_disc_cfg_t *cfg){
+    *cfg = (tx_disc_cfg_t){
+        .enabled = 1,
+        .poll_s = 0,
+        .bound_ns = 1000000LL,
+        .slew_ppb = 500000LL,  // adjtime()'s limit
+        .step_ns = 500000000LL // A leap second is stepped, like the kernel does
+    };
+}
+
+int tx_disc_cfg_parse(tx_disc_cfg_t *cfg, const char *spec){
+    char buf[128];
+    if (strcmp(spec, "off") == 0) {
+        cfg->enabled = 0;
+        return 0;
+    }
+    if (strlen(spec) >= sizeof(buf)) {
+        fprintf(stderr, "Error: discipline settings too long\n");
+        return -1;
+    }
+    strcpy(buf, spec);
+
+    char *save = NULL;
+    for (char *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        long long v;
+        if (!val) {
+            fprintf(stderr, "Error: discipline setting '%s' is not key=value\n", kv);
+            return -1;
+        }
+        *val++ = '\0';
+        int rc = -1;
+        if      (!strcmp(kv, "poll"))  { if ((rc = parse_ll(val, 0, 86400, &v)) == 0) cfg->poll_s = (uint32_t)v; }
+        else if (!strcmp(kv, "bound")) { if ((rc = parse_ll(val, 1, 10000000, &v)) == 0) cfg->bound_ns = v * 1000LL; }
+        else if (!strcmp(kv, "slew"))  { if ((rc = parse_ll(val, 1, 100000, &v)) == 0) cfg->slew_ppb = v * 1000LL; }
+        else if (!strcmp(kv, "step"))  { if ((rc = parse_ll(val, 1, 3600000, &v)) == 0) cfg->step_ns = v * 1000000LL; }
+        else {
+            fprintf(stderr, "Error: unknown discipline setting '%s'\n", kv);
+            return -1;
+        }
+        if (rc != 0) {
+            fprintf(stderr, "Error: invalid discipline value %s=%s\n", kv, val);
+            return -1;
+        }
+    }
+    cfg->enabled = 1;
+    return 0;
+}
+
+static int64_t clock_ns(clockid_t id){
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (int64_t)ts.tv_sec * NS + ts.tv_nsec;
+}
+
+// CLOCK_REALTIME read between two CLOCK_MONOTONIC reads, attributed to their midpoint
+static void paired_read(int64_t *rt, int64_t *mono){
+    const int64_t m0 = clock_ns(CLOCK_MONOTONIC);
+    *rt = clock_ns(CLOCK_REALTIME);
+    *mono = m0 + (clock_ns(CLOCK_MONOTONIC) - m0) / 2;
+}
+
+int tx_disc_source_local(void *arg, int64_t *utc_ns, int64_t *mono_ns, uint8_t *leap){
+    (void)arg;
+    struct timex tx = { .modes = 0 };
+    const int state = adjtimex(&tx);
+    paired_read(utc_ns, mono_ns);
+    *leap = state == TIME_INS ? 1 : state == TIME_DEL ? 2 : 0;
+    return 1;
+}
+
+int tx_disc_source_ntp(void *arg, int64_t *utc_ns, int64_t *mono_ns, uint8_t *leap){
+    ret_ntp sync;
+    if (ntp_get((const char *)arg, NTP_TIMEOUT_MS, &sync) < 0) return -1;
+    int64_t rt;
+    paired_read(&rt, mono_ns);
+    *utc_ns = rt + sync.offset_ns;
+    *leap = sync.leap_sec;
+    return 1;
+}
+
+/*
+Mapping readers: seqlock over four relaxed atomics. The writer bumps seq to odd, stores, bumps to even;
+a reader retries if seq was odd or changed underneath it.
+*/
+typedef struct disc_map {
+    int64_t mono0, utc0, leap_at;
+    double rate;
+} disc_map_t;
+
+static void map_load(tx_disc_t *d, disc_map_t *m){
+    uint32_t s0, s1;
+    do {
+        s0 = atomic_load_explicit(&d->seq, memory_order_acquire);
+        m->mono0 = atomic_load_explicit(&d->mono0, memory_order_relaxed);
+        m->utc0 = atomic_load_explicit(&d->utc0, memory_order_relaxed);
+        m->rate = atomic_load_explicit(&d->rate, memory_order_relaxed);
+        m->leap_at = atomic_load_explicit(&d->leap_at, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        s1 = atomic_load_explicit(&d->seq, memory_order_relaxed);
+    } while ((s0 & 1) || s0 != s1);
+}
+
+static void map_store(tx_disc_t *d, int64_t mono0, int64_t utc0, double rate, int64_t leap_at){
+    const uint32_t s = atomic_load_explicit(&d->seq, memory_order_relaxed);
+    atomic_store_explicit(&d->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->mono0, mono0, memory_order_relaxed);
+    atomic_store_explicit(&d->utc0, utc0, memory_order_relaxed);
+    atomic_store_explicit(&d->rate, rate, memory_order_relaxed);
+    atomic_store_explicit(&d->leap_at, leap_at, memory_order_relaxed);
+    atomic_store_explicit(&d->seq, s + 2, memory_order_release);
+}
+
+// Linear part only, before any leap second
+static int64_t map_raw(const disc_map_t *m, int64_t mono){
+    const int64_t dt = mono - m->mono0;
+    return m->utc0 + dt + (int64_t)((double)dt * m->rate);
+}
+
+/*
+Leap seconds follow the kernel: an inserted second repeats 23:59:59, a deleted one skips it.
+leap_at is the raw UTC of the following midnight, negative when the second is deleted.
+*/
+static int64_t leap_adjust(int64_t raw, int64_t leap_at){
+    if (leap_at == LEAP_NONE) return raw;
+    if (leap_at > 0) return raw >= leap_at ? raw - NS : raw;
+    return raw >= -leap_at - NS ? raw + NS : raw;
+}
+
+int64_t tx_disc_utc(tx_disc_t *d, int64_t mono_ns){
+    disc_map_t m;
+    map_load(d, &m);
+    return leap_adjust(map_raw(&m, mono_ns), m.leap_at);
+}
+
+int64_t tx_disc_mono(tx_disc_t *d, int64_t utc_ns){
+    disc_map_t m;
+    map_load(d, &m);
+    // Inverse of leap_adjust(): a deadline in a repeated second is its first occurrence
+    if (m.leap_at != LEAP_NONE) {
+        if (m.leap_at > 0 && utc_ns >= m.leap_at) utc_ns += NS;
+        if (m.leap_at < 0 && utc_ns >= -m.leap_at) utc_ns -= NS;
+    }
+    return m.mono0 + (int64_t)((double)(utc_ns - m.utc0) / (1.0 + m.rate));
+}
+
+// Announced leap seconds take effect at the end of the UTC day, on the last day of a month
+static int64_t leap_boundary(int64_t utc_ns, uint8_t leap){
+    if (leap != 1 && leap != 2) return LEAP_NONE;
+    const time_t midnight = (time_t)((utc_ns / DAY_NS + 1) * 86400);
+    struct tm tm;
+    gmtime_r(&midnight, &tm);
+    if (tm.tm_mday != 1) return LEAP_NONE;
+    return leap == 1 ? (int64_t)midnight * NS : -(int64_t)midnight * NS;
+}
+
+static double clampd(double v, double lim){
+    return v > lim ? lim : v < -lim ? -lim : v;
+}
+
+void tx_disc_update(tx_disc_t *d, int64_t utc_ns, int64_t mono_ns){
+    disc_map_t m;
+    map_load(d, &m);
+    const int64_t raw = map_raw(&m, mono_ns);
+    int64_t leap_at = m.leap_at;
+    const int64_t mapped = leap_adjust(raw, leap_at);
+    // Once past the boundary the second is folded into the anchor below
+    if (leap_at != LEAP_NONE && mapped != raw) leap_at = LEAP_NONE;
+    if (leap_at == LEAP_NONE) leap_at = leap_boundary(utc_ns, atomic_load_explicit(&d->leap, memory_order_relaxed));
+
+    const int64_t err = utc_ns - mapped; // > 0: our UTC is behind
+    const double poll = (double)d->cfg.poll_s * NS;
+    atomic_store_explicit(&d->last_err_ns, err, memory_order_relaxed);
+    atomic_fetch_add_explicit(&d->samples, 1, memory_order_relaxed);
+    if (llabs(err) > d->cfg.bound_ns) atomic_fetch_add_explicit(&d->out_of_bound, 1, memory_order_relaxed);
+    if (d->metrics) {
+        atomic_store_explicit(&d->metrics->utc_error_ns, err, memory_order_relaxed);
+        if (llabs(err) > d->cfg.bound_ns) atomic_fetch_add_explicit(&d->metrics->utc_out_of_bound, 1, memory_order_relaxed);
+    }
+
+    if (llabs(err) > d->cfg.step_ns) {
+        atomic_fetch_add_explicit(&d->steps, 1, memory_order_relaxed);
+        fprintf(stderr, "\nDiscipline: stepping %+.3fms\n", err / 1e6);
+        map_store(d, mono_ns, utc_ns, d->freq, leap_boundary(utc_ns, atomic_load_explicit(&d->leap, memory_order_relaxed)));
+        d->slew_clamped = 1;
+        d->last_mono = mono_ns;
+        return;
+    }
+
+    // FLL: after a full phase correction, what is left after one interval is drift
+    const int64_t dt = mono_ns - d->last_mono;
+    if (!d->slew_clamped && dt > 0) d->freq = clampd(d->freq + DISC_FLL_GAIN * (double)err / (double)dt, DISC_FREQ_MAX_PPB / 1e9);
+
+    const double slew_max = (double)d->cfg.slew_ppb / 1e9;
+    const double phase = (double)err / poll;
+    d->slew_clamped = phase > slew_max || phase < -slew_max;
+    // Re-anchor where the old mapping is now: continuous, only the slope changes
+    map_store(d, mono_ns, mapped, d->freq + clampd(phase, slew_max), leap_at);
+    d->last_mono = mono_ns;
+
+    if (d->metrics) atomic_store_explicit(&d->metrics->freq_ppb, (int64_t)(d->freq * 1e9), memory_order_relaxed);
+}
+
+static void *disc_loop(void *args){
+    tx_disc_t *d = (tx_disc_t *)args;
+
+    pthread_mutex_lock(&d->lck);
+    while (!d->stop) {
+        struct timespec until;
+        clock_gettime(CLOCK_MONOTONIC, &until);
+        until.tv_sec += d->cfg.poll_s;
+        while (!d->stop && !d->resample && pthread_cond_timedwait(&d->wake, &d->lck, &until) != ETIMEDOUT);
+        if (d->stop) break;
+        d->resample = 0;
+        const tx_disc_source_t source = d->source;
+        void *source_arg = d->source_arg;
+        pthread_mutex_unlock(&d->lck);
+
+        int64_t utc, mono;
+        uint8_t leap;
+        if (source(source_arg, &utc, &mono, &leap) > 0) {
+            atomic_store_explicit(&d->leap, leap, memory_order_relaxed);
+            tx_disc_update(d, utc, mono);
+        } else {
+            // Holdover: the mapping keeps running on the last drift estimate
+            atomic_fetch_add_explicit(&d->misses, 1, memory_order_relaxed);
+        }
+        pthread_mutex_lock(&d->lck);
+    }
+    pthread_mutex_unlock(&d->lck);
+    return NULL;
+}
+
+int tx_disc_start(tx_disc_t *d, const tx_disc_cfg_t *cfg, tx_disc_source_t src, void *arg, rt_metrics_t *m){
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    d->source = src;
+    d->source_arg = arg;
+    d->metrics = m;
+    d->poll_auto = !d->cfg.poll_s;
+    if (d->poll_auto) d->cfg.poll_s = src == tx_disc_source_ntp ? DISC_POLL_NTP : DISC_POLL_LOCAL;
+
+    int64_t utc, mono;
+    uint8_t leap;
+    if (src(arg, &utc, &mono, &leap) < 0) return -1;
+    atomic_store_explicit(&d->leap, leap, memory_order_relaxed);
+    map_store(d, mono, utc, 0.0, leap_boundary(utc, leap));
+    d->last_mono = mono;
+    d->slew_clamped = 0; // No phase correction in flight: the first interval measures drift only
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&d->wake, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&d->lck, NULL);
+
+    if (thread_create_low(&d->tid, disc_loop, d) != 0) {
+        perror("Discipline: pthread_create");
+        pthread_cond_destroy(&d->wake);
+        pthread_mutex_destroy(&d->lck);
+        return -1;
+    }
+    d->running = 1;
+    return 1;
+}
+
+void tx_disc_set_source(tx_disc_t *d, tx_disc_source_t src, void *arg){
+    if (!d->running) return;
+    pthread_mutex_lock(&d->lck);
+    d->source = src;
+    d->source_arg = arg;
+    if (d->poll_auto) d->cfg.poll_s = src == tx_disc_source_ntp ? DISC_POLL_NTP : DISC_POLL_LOCAL;
+    d->resample = 1;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lck);
+}
+
+void tx_disc_stop(tx_disc_t *d){
+    if (!d->running) return;
+    pthread_mutex_lock(&d->lck);
+    d->stop = 1;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lck);
+    pthread_join(d->tid, NULL); // An NTP query in flight ends within NTP_TIMEOUT_MS
+    pthread_cond_destroy(&d->wake);
+    pthread_mutex_destroy(&d->lck);
+    d->running = 0;
+}
@@ -0,0 +1,112 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "flight_rec.h"
+#include "timecode.h"
+
+static size_t map_size(uint32_t capacity){
+    return sizeof(fr_header_t) + (size_t)capacity * sizeof(fr_entry_t);
+}
+
+int fr_open(flight_rec_t *fr, const char *path, const tx_chan_t *chan, int n_chan){
+    memset(fr, 0, sizeof(*fr));
+    const size_t len = map_size(FR_RECORDS);
+
+    // The last run's recording is the evidence after a crash and restart: keep it as <path>.prev
+    char prev[4096];
+    if (snprintf(prev, sizeof(prev), "%s.prev", path) < (int)sizeof(prev) && rename(path, prev) < 0 && errno != ENOENT) {
+        perror("Recorder: keeping the previous recording");
+    }
+
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { perror("Recorder: open"); return -1; }
+    if (ftruncate(fd, (off_t)len) < 0) {
+        perror("Recorder: ftruncate");
+        close(fd);
+        return -1;
+    }
+    // Populated up front (and locked by mlockall): the RT loop never takes a page fault here
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) { perror("Recorder: mmap"); return -1; }
+
+    fr->hdr = map;
+    fr->ring = (fr_entry_t *)((char *)map + sizeof(fr_header_t));
+    fr->map_len = len;
+    fr->mask = FR_RECORDS - 1;
+
+    fr_header_t *h = fr->hdr;
+    memcpy(h->magic, FR_MAGIC, sizeof(h->magic));
+    h->version = FR_VERSION;
+    h->rec_size = sizeof(fr_entry_t);
+    h->capacity = FR_RECORDS;
+    h->n_chan = (uint8_t)n_chan;
+    for (int c = 0; c < n_chan && c < TX_MAX_CHANNELS; c++) snprintf(h->proto[c], sizeof(h->proto[c]), "%s", chan[c].proto->name);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    h->started_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    atomic_store_explicit(&h->head, 0, memory_order_release);
+    return 1;
+}
+
+int fr_attach(flight_rec_t *fr, const char *path){
+    memset(fr, 0, sizeof(*fr));
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    fr_header_t h;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(h) || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+        fprintf(stderr, "%s: not a flight recorder\n", path);
+        close(fd);
+        return -1;
+    }
+    if (memcmp(h.magic, FR_MAGIC, sizeof(h.magic)) != 0 || h.version != FR_VERSION || h.rec_size != sizeof(fr_entry_t) ||
+        !h.capacity || (h.capacity & (h.capacity - 1)) || (size_t)st.st_size < map_size(h.capacity)) {
+        fprintf(stderr, "%s: not a flight recorder (or another version)\n", path);
+        close(fd);
+        return -1;
+    }
+
+    const size_t len = map_size(h.capacity);
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) { perror("Recorder: mmap"); return -1; }
+
+    fr->hdr = map;
+    fr->ring = (fr_entry_t *)((char *)map + sizeof(fr_header_t));
+    fr->map_len = len;
+    fr->mask = h.capacity - 1;
+    fr->head = atomic_load_explicit(&fr->hdr->head, memory_order_acquire);
+    return 1;
+}
+
+void fr_close(flight_rec_t *fr){
+    if (!fr->hdr) return;
+    munmap(fr->hdr, fr->map_len); // The file stays for post-mortem reads
+    fr->hdr = NULL;
+}
+
+int fr_read(const flight_rec_t *fr, uint64_t n, fr_entry_t *out){
+    const fr_entry_t *e = &fr->ring[n & fr->mask];
+    const uint64_t want = 2 * n + 2;
+    if (atomic_load_explicit(&e->seq, memory_order_acquire) != want) return 0;
+    out->deadline_ns = e->deadline_ns;
+    out->actual_ns = e->actual_ns;
+    out->frame = e->frame;
+    out->frame_b = e->frame_b;
+    out->sec = e->sec;
+    out->state = e->state;
+    out->chan = e->chan;
+    atomic_thread_fence(memory_order_acquire);
+    // Seqlock: unchanged sequence, no overwrite during the copy
+    if (atomic_load_explicit(&e->seq, memory_order_relaxed) != want) return 0;
+    atomic_init(&out->seq, want);
+    return 1;
+}
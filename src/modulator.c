@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "modulator.h"
+#include "tx_clock.h"
+#include "dcf77.h"
+
+const uint16_t modulator_program_instructions[] = {
+    //      .wrap_target
+    0x80a0, //  0:  pull block
+    0x6030, //  1:  out X, 16       (Attenuation delay)
+    0x6050, //  2:  out Y, 16       (Full carrier delay)
+    0x0026, //  3:  jmp !X, 6       (Minute mark: no attenuation)
+    0xe080, //  4:  set PINDIRS, 0  (Hi-Z: attenuate)
+    0x0045, //  5:  jmp X--, 5
+    0xe081, //  6:  set PINDIRS, 1  (Drive LOW: full carrier)
+    0x0087  //  7:  jmp Y--, 7
+    //      .wrap
+};
+
+int mod_word(uint32_t att_ticks, uint32_t period_ticks, uint32_t *word){
+    uint32_t x, y;
+    if (att_ticks == 0) {
+        if (period_ticks < 6) return -1;
+        x = 0;
+        y = period_ticks - 6;
+    } else {
+        if (att_ticks < 3 || period_ticks < att_ticks + 6) return -1;
+        x = att_ticks - 2;
+        y = period_ticks - att_ticks - 6;
+    }
+    if (x > 0xffff || y > 0xffff) return -1;
+    *word = x | (y << 16);
+    return 1;
+}
+
+uint32_t mod_word_att_ticks(uint32_t word){
+    const uint32_t x = word & 0xffff;
+    return x ? x + 2 : 0;
+}
+
+uint32_t mod_word_period_ticks(uint32_t word){
+    const uint32_t x = word & 0xffff, y = word >> 16;
+    return x ? x + y + 8 : y + 6;
+}
+
+int mod_compile_minute(const tx_minute_t *m, int32_t trim_ticks, uint32_t *words, time_t *due){
+    uint32_t att[MOD_MAX_SECONDS] = {0};
+    if (m->n_chan != 1) return -1; // One state machine drives one attenuator line
+    const int n = (m->frame[0] & (1ULL << 60)) ? 61 : 60;
+
+    // The program attenuates from the start of a second and then releases: (Carrier_MOD at :00, Carrier) pairs only
+    for (int i = 0; i < m->n_edges; i += 2) {
+        const tx_edge_t *e = &m->edge[i];
+        if (e->state != Carrier_MOD || e->at.tv_nsec != 0 || i + 1 >= m->n_edges || m->edge[i + 1].state != Carrier) return -1;
+        const int64_t len = tx_ts_ns(&m->edge[i + 1].at) - tx_ts_ns(&e->at);
+        att[e->sec] = (uint32_t)(len / MOD_TICK_NS);
+    }
+
+    for (int s = 0; s < n; s++) {
+        uint32_t period = MOD_TICKS_SEC;
+        if (s == n - 1) period = (uint32_t)((int32_t)period + trim_ticks);
+        if (mod_word(att[s], period, &words[s]) < 0) return -1;
+        due[s] = m->minute_start + (s < 60 ? s : 59);
+    }
+    return n;
+}
+
+void mod_trim_reset(mod_trim_t *t){
+    t->min_phase_ns = INT64_MAX;
+    t->samples = 0;
+}
+
+void mod_trim_observe(mod_trim_t *t, int64_t phase_ns){
+    if (phase_ns < t->min_phase_ns) t->min_phase_ns = phase_ns;
+    t->samples++;
+}
+
+int32_t mod_trim_take(mod_trim_t *t){
+    int32_t ticks = 0;
+    if (t->samples >= MOD_TRIM_SAMPLES) {
+        const int64_t off = t->min_phase_ns / MOD_TICK_NS; // Sub-tick phase is below what a trim can fix
+        ticks = (int32_t)(off > MOD_TRIM_MAX ? MOD_TRIM_MAX : off < -MOD_TRIM_MAX ? -MOD_TRIM_MAX : off);
+    }
+    mod_trim_reset(t);
+    return -ticks;
+}
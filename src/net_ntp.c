@@ -1,45 +1,351 @@
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
 
 #include "net_ntp.h"
 
-ret_ntp *ntp_get() {
-    int sockfd;
-    struct sockaddr_in serv_addr;
-    struct hostent *server;
+#define NTP_MODE_SERVER 4
+#define NTP_LI_UNSYNC 3
+#define DNS_POLL_MS 10 // getaddrinfo_a() has no fd: pending lookups are checked this often
+
+typedef struct ntp_peer {
+    ntp_sample_t *s;
+    char host[64];
+    char port[8];
+    struct addrinfo hints;
+    struct gaicb req;
+    int fd;
+    int64_t next_send;
+    uint32_t org_s, org_f; // Our transmit timestamp, echoed back as the origin
+    int64_t t1;
+    uint8_t done;
+    uint8_t resolving; // Lookup submitted and its result not yet freed
+} ntp_peer_t;
+
+// Lookups a timed-out query could not cancel: glibc still writes into their gaicb, so those peers stay here,
+// one set for the process, until a later query sees them finish. A name in it is not looked up again meanwhile.
+static pthread_mutex_t orphan_lck = PTHREAD_MUTEX_INITIALIZER;
+static ntp_peer_t *orphan[NTP_MAX_SERVERS];
+static int orphan_reserved; // Slots promised to queries still running
+
+static int64_t realtime_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t mono_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// NTP seconds wrap in 2036: take the era closest to our own clock
+static int64_t ntp_to_ns(uint32_t s, uint32_t f, int64_t ref_ns){
+    const int64_t era = 1LL << 32;
+    int64_t sec = (int64_t)s - (int64_t)NTP_TIMESTAMP_DELTA;
+    while (sec + era / 2 < ref_ns / 1000000000LL) sec += era;
+    return sec * 1000000000LL + (int64_t)(((uint64_t)f * 1000000000ULL) >> 32);
+}
+
+static void ns_to_ntp(int64_t ns, uint32_t *s, uint32_t *f){
+    *s = (uint32_t)(ns / 1000000000LL + (int64_t)NTP_TIMESTAMP_DELTA);
+    *f = (uint32_t)(((uint64_t)(ns % 1000000000LL) << 32) / 1000000000ULL);
+}
+
+// 16.16 fixed point seconds (root delay / dispersion)
+static int64_t short_to_ns(uint32_t v){
+    return (int64_t)(((uint64_t)v * 1000000000ULL) >> 16);
+}
+
+static int split_host(const char *spec, size_t len, ntp_peer_t *p){
+    const char *port = NULL;
+    const char *host = spec;
+    size_t hlen = len;
+
+    if (len && spec[0] == '[') { // [v6]:port
+        const char *close = memchr(spec, ']', len);
+        if (!close) return -1;
+        host = spec + 1;
+        hlen = (size_t)(close - host);
+        if (close + 1 < spec + len) {
+            if (close[1] != ':') return -1;
+            port = close + 2;
+        }
+    } else {
+        const char *colon = memchr(spec, ':', len);
+        if (colon && !memchr(colon + 1, ':', (size_t)(spec + len - colon - 1))) { // Exactly one ':' is host:port
+            hlen = (size_t)(colon - spec);
+            port = colon + 1;
+        }
+    }
+    if (hlen == 0 || hlen >= sizeof(p->host)) return -1;
+    memcpy(p->host, host, hlen);
+    p->host[hlen] = '\0';
+
+    const size_t plen = port ? (size_t)(spec + len - port) : strlen(NTP_PORT);
+    if (plen == 0 || plen >= sizeof(p->port)) return -1;
+    memcpy(p->port, port ? port : NTP_PORT, plen);
+    p->port[plen] = '\0';
+    return 0;
+}
+
+static int send_request(ntp_peer_t *p){
     ntp_packet packet;
-    //Time output
-    ret_ntp *resp = malloc(sizeof(ret_ntp)); 
-    
-    // Initialize packet (Client mode = 3, Version = 4)
-    memset(&packet, 0, sizeof(ntp_packet));
+    memset(&packet, 0, sizeof(packet));
     packet.li_vn_mode = 0x23; // 00 100 011 (LI=0, VN=4, Mode=3) == 0010 0011
 
-    // Setup Socket
-    sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    server = gethostbyname(HOSTNAME);
-    
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr_list[0], server->h_length);
-    serv_addr.sin_port = htons(123);
-
-    //Send Request & Receive Time
-    sendto(sockfd, &packet, sizeof(ntp_packet), 0, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
-    recv(sockfd, &packet, sizeof(ntp_packet), 0);
-    // Parse the Leap Indicator
-    uint8_t li = (packet.li_vn_mode >> 6) & 0x03;
-    // Convert Timestamp to Unix time
+    p->t1 = realtime_ns();
+    ns_to_ntp(p->t1, &p->org_s, &p->org_f);
+    packet.txTm_s = htonl(p->org_s);
+    packet.txTm_f = htonl(p->org_f);
+    return send(p->fd, &packet, sizeof(packet), 0) == (ssize_t)sizeof(packet) ? 0 : -1;
+}
+
+static void fail(ntp_peer_t *p, const char *why){
+    p->s->error = why;
+    p->done = 1;
+}
+
+static void open_peer(ntp_peer_t *p){
+    const int rc = gai_error(&p->req);
+    if (rc != 0) {
+        fail(p, gai_strerror(rc));
+        return;
+    }
+    const struct addrinfo *ai = p->req.ar_result;
+    p->fd = socket(ai->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p->fd < 0) {
+        fail(p, "socket failed");
+        return;
+    }
+    // Connected: only this server's datagrams arrive, and ICMP errors are reported
+    const int on = 1;
+    setsockopt(p->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    if (connect(p->fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+        fail(p, "connect failed");
+        return;
+    }
+    p->next_send = mono_ms();
+}
+
+static void read_reply(ntp_peer_t *p){
+    ntp_packet pkt;
+    char cbuf[CMSG_SPACE(sizeof(struct timespec))];
+    struct iovec iov = { .iov_base = &pkt, .iov_len = sizeof(pkt) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cbuf, .msg_controllen = sizeof(cbuf) };
+
+    const ssize_t len = recvmsg(p->fd, &msg, 0);
+    int64_t t4 = realtime_ns();
+    if (len < 0) {
+        if (errno == ECONNREFUSED) fail(p, "connection refused");
+        return;
+    }
+    // Kernel receive timestamp: scheduling delay before recvmsg() is not round trip
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            t4 = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+    }
+
+    if (len < (ssize_t)sizeof(pkt)) return;
+    if ((pkt.li_vn_mode & 0x7) != NTP_MODE_SERVER) return;
+    if (ntohl(pkt.origTm_s) != p->org_s || ntohl(pkt.origTm_f) != p->org_f) return; // Stale or forged
+    const uint8_t li = (pkt.li_vn_mode >> 6) & 0x03;
+    if (pkt.stratum == 0 || pkt.stratum > 15) { fail(p, "kiss-o'-death or bad stratum"); return; }
+    if (li == NTP_LI_UNSYNC) { fail(p, "server unsynchronised"); return; }
+    if (pkt.txTm_s == 0) return;
+
     // NTP is Big-Endian
-    time_t txTm = (time_t)(ntohl(packet.txTm_s) - NTP_TIMESTAMP_DELTA);
+    const int64_t t1 = p->t1;
+    const int64_t t2 = ntp_to_ns(ntohl(pkt.rxTm_s), ntohl(pkt.rxTm_f), t1);
+    const int64_t t3 = ntp_to_ns(ntohl(pkt.txTm_s), ntohl(pkt.txTm_f), t1);
+    ntp_sample_t *s = p->s;
+    s->offset_ns = ((t2 - t1) + (t3 - t4)) / 2;
+    s->delay_ns = (t4 - t1) - (t3 - t2);
+    if (s->delay_ns < 0) s->delay_ns = 0; // Server clock resolution
+    s->root_dist_ns = s->delay_ns / 2 + short_to_ns(ntohl(pkt.rootDelay)) / 2 + short_to_ns(ntohl(pkt.rootDispersion));
+    s->leap = li;
+    s->stratum = pkt.stratum;
+    s->valid = 1;
+    s->error = NULL;
+    p->done = 1;
+}
+
+// Caller holds orphan_lck
+static int reap_orphans(void){
+    int free_slots = 0;
+    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+        ntp_peer_t *p = orphan[i];
+        if (p && gai_error(&p->req) == EAI_INPROGRESS) continue;
+        if (p) {
+            if (p->req.ar_result) freeaddrinfo(p->req.ar_result);
+            free(p);
+            orphan[i] = NULL;
+        }
+        free_slots++;
+    }
+    return free_slots - orphan_reserved;
+}
+
+static int orphan_pending(const ntp_peer_t *p){
+    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+        if (orphan[i] && !strcmp(orphan[i]->host, p->host) && !strcmp(orphan[i]->port, p->port)) return 1;
+    }
+    return 0;
+}
+
+static void adopt_orphan(ntp_peer_t *p){
+    for (int i = 0; i < NTP_MAX_SERVERS; i++) {
+        if (!orphan[i]) { orphan[i] = p; return; }
+    }
+}
+
+static void free_peers(ntp_peer_t **peers, int n){
+    for (int i = 0; i < n; i++) free(peers[i]);
+}
+
+int ntp_query(const char *servers, int timeout_ms, ntp_sample_t *samples, int max){
+    ntp_peer_t *peers[NTP_MAX_SERVERS];
+    struct gaicb *list[NTP_MAX_SERVERS];
+    int n = 0, n_list = 0;
+    if (max > NTP_MAX_SERVERS) return -1;
+
+    for (const char *s = servers; *s && n < max; ) {
+        const size_t len = strcspn(s, ",");
+        ntp_peer_t *p = peers[n] = calloc(1, sizeof(*p));
+        if (!p) {
+            free_peers(peers, n);
+            return -1;
+        }
+        n++;
+        memset(&samples[n - 1], 0, sizeof(samples[n - 1]));
+        p->s = &samples[n - 1];
+        p->fd = -1;
+        if (split_host(s, len, p) < 0) {
+            free_peers(peers, n);
+            return -1;
+        }
+        snprintf(p->s->server, sizeof(p->s->server), "%s", p->host);
+        p->s->error = "no reply";
+        p->hints = (struct addrinfo){ .ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM, .ai_protocol = IPPROTO_UDP };
+        p->req = (struct gaicb){ .ar_name = p->host, .ar_service = p->port, .ar_request = &p->hints };
+        s += len;
+        if (*s == ',') s++;
+    }
+    if (n == 0) return -1;
+
+    // Every lookup submitted here has an orphan slot to fall back on, so hanging DNS costs a bounded amount
+    pthread_mutex_lock(&orphan_lck);
+    int slots = reap_orphans();
+    for (int i = 0; i < n; i++) {
+        ntp_peer_t *p = peers[i];
+        if (slots <= 0 || orphan_pending(p)) { fail(p, "name resolution still pending"); continue; }
+        slots--;
+        p->resolving = 1;
+        list[n_list++] = &p->req;
+    }
+    orphan_reserved += n_list;
+    pthread_mutex_unlock(&orphan_lck);
+
+    // Resolution runs in the background too: one slow name does not hold up the other servers
+    const int64_t deadline = mono_ms() + timeout_ms;
+    if (n_list && getaddrinfo_a(GAI_NOWAIT, list, n_list, NULL) != 0) {
+        for (int i = 0; i < n; i++) {
+            if (!peers[i]->resolving) continue;
+            peers[i]->resolving = 0;
+            fail(peers[i], "name resolution failed");
+        }
+    }
+
+    for (;;) {
+        struct pollfd pfd[NTP_MAX_SERVERS];
+        int idx[NTP_MAX_SERVERS], npfd = 0, pending = 0, dns_pending = 0;
+        const int64_t now = mono_ms();
+        int64_t wake = deadline;
+
+        for (int i = 0; i < n; i++) {
+            ntp_peer_t *p = peers[i];
+            if (p->done) continue;
+            if (p->fd < 0) {
+                if (gai_error(&p->req) == EAI_INPROGRESS) { dns_pending = pending = 1; continue; }
+                open_peer(p);
+                if (p->done) continue;
+            }
+            pending = 1;
+            if (now >= p->next_send) { // First request, or a retry for a lost datagram
+                if (send_request(p) < 0 && errno != EAGAIN) { fail(p, "send failed"); continue; }
+                p->next_send = now + NTP_RETRY_MS;
+            }
+            if (p->next_send < wake) wake = p->next_send;
+            pfd[npfd] = (struct pollfd){ .fd = p->fd, .events = POLLIN };
+            idx[npfd++] = i;
+        }
+        if (!pending || now >= deadline) break;
+        if (dns_pending && now + DNS_POLL_MS < wake) wake = now + DNS_POLL_MS;
+
+        if (poll(pfd, (nfds_t)npfd, (int)(wake - now)) > 0) {
+            for (int k = 0; k < npfd; k++) {
+                if (pfd[k].revents) read_reply(peers[idx[k]]);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&orphan_lck);
+    orphan_reserved -= n_list;
+    for (int i = 0; i < n; i++) {
+        ntp_peer_t *p = peers[i];
+        if (p->fd >= 0) close(p->fd);
+        if (p->resolving && gai_error(&p->req) == EAI_INPROGRESS) {
+            p->s->error = "name resolution timed out";
+            // EAI_ALLDONE: finished after all, its result is freed below
+            if (gai_cancel(&p->req) == EAI_NOTCANCELED) {
+                p->s = NULL; // The samples belong to our caller
+                adopt_orphan(p);
+                continue;
+            }
+        }
+        if (p->resolving && p->req.ar_result) freeaddrinfo(p->req.ar_result);
+        free(p);
+    }
+    pthread_mutex_unlock(&orphan_lck);
+    return n;
+}
+
+int ntp_best(const ntp_sample_t *samples, int n){
+    int best = -1;
+    for (int i = 0; i < n; i++) {
+        if (!samples[i].valid) continue;
+        if (best < 0 || samples[i].root_dist_ns < samples[best].root_dist_ns) best = i;
+    }
+    return best;
+}
 
-    resp->time_data = txTm;
-    resp->leap_sec = li;
+int ntp_get(const char *servers, int timeout_ms, ret_ntp *out){
+    ntp_sample_t samples[NTP_MAX_SERVERS];
+    const int n = ntp_query(servers, timeout_ms, samples, NTP_MAX_SERVERS);
+    if (n < 0) return -1;
+    const int best = ntp_best(samples, n);
+    if (best < 0) return -1;
 
-    close(sockfd);
-    return resp;
+    const ntp_sample_t *s = &samples[best];
+    out->offset_ns = s->offset_ns;
+    out->delay_ns = s->delay_ns;
+    out->root_dist_ns = s->root_dist_ns;
+    out->leap_sec = s->leap;
+    out->time_data = (time_t)((realtime_ns() + s->offset_ns) / 1000000000LL);
+    out->servers_ok = 0;
+    for (int i = 0; i < n; i++) out->servers_ok += samples[i].valid;
+    snprintf(out->server, sizeof(out->server), "%s", s->server);
+    return 1;
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#include "parse_num.h"
+
+int parse_ll(const char *s, long long min, long long max, long long *out){
+    errno = 0;
+    char *end = NULL;
+    const long long v = strtoll(s, &end, 10);
+    if (s == end || *end != '\0' || errno == ERANGE || v < min || v > max) return -1;
+    *out = v;
+    return 0;
+}
+
+int parse_int(const char *s, int min, int max, int *out){
+    long long v;
+    if (parse_ll(s, min, max, &v) < 0) return -1;
+    *out = (int)v;
+    return 0;
+}
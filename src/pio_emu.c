@@ -0,0 +1,239 @@
+#include <string.h>
+
+#include "pio_emu.h"
+
+#define OP(ins) ((ins) >> 13)
+#define DELAY(ins) (((ins) >> 8) & 0x1f)
+
+enum { OP_JMP, OP_WAIT, OP_IN, OP_OUT, OP_PUSH_PULL, OP_MOV, OP_IRQ, OP_SET };
+enum { EXEC_NEXT, EXEC_JUMP, EXEC_STALL };
+
+void pio_emu_init(pio_emu_t *e, const uint16_t *prog, uint8_t len, uint8_t wrap_target, uint8_t wrap){
+    memset(e, 0, sizeof(*e));
+    e->prog = prog;
+    e->len = len;
+    e->wrap_target = wrap_target;
+    e->wrap = wrap;
+    e->out_right = 1;
+    e->osr_count = 32;
+    e->set_count = 1;
+    e->div_int = 1;
+}
+
+void pio_emu_set_clkdiv_int_frac(pio_emu_t *e, uint16_t div_int, uint8_t div_frac){
+    e->div_int = div_int ? div_int : 65536; // INT = 0 means 65536
+    e->div_frac = div_int ? div_frac : 0;
+    e->frac_acc = 0;
+}
+
+void pio_emu_set_clkdiv(pio_emu_t *e, float div){
+    // Same truncation as sm_config_set_clkdiv()
+    const uint16_t div_int = (uint16_t)div;
+    const uint8_t div_frac = div_int ? (uint8_t)((div - (float)div_int) * 256.0f) : 0;
+    pio_emu_set_clkdiv_int_frac(e, div_int, div_frac);
+}
+
+int pio_emu_put(pio_emu_t *e, uint32_t word){
+    if (e->tx_level == PIO_EMU_FIFO) return -1;
+    e->tx[(e->tx_head + e->tx_level++) % PIO_EMU_FIFO] = word;
+    return 1;
+}
+
+static uint32_t field_mask(uint8_t count){
+    return count >= 32 ? 0xffffffffu : ((1u << count) - 1);
+}
+
+static void write_pins(pio_emu_t *e, uint8_t base, uint8_t count, uint32_t value, int dirs){
+    const uint32_t mask = field_mask(count) << base;
+    uint32_t *reg = dirs ? &e->pindirs : &e->pins;
+    const uint32_t next = (*reg & ~mask) | ((value << base) & mask);
+    if (next == *reg) return;
+    *reg = next;
+    if (e->watch) e->watch(e->watch_arg, e->cycle, e->sysclk, e->pins, e->pindirs);
+}
+
+static uint32_t bit_reverse(uint32_t v){
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+static uint32_t shift_out(pio_emu_t *e, uint8_t n){
+    const uint32_t mask = field_mask(n);
+    uint32_t v;
+    if (e->out_right) {
+        v = e->osr & mask;
+        e->osr = n >= 32 ? 0 : e->osr >> n;
+    } else {
+        v = n >= 32 ? e->osr : (e->osr >> (32 - n)) & mask;
+        e->osr = n >= 32 ? 0 : e->osr << n;
+    }
+    e->osr_count = (uint8_t)(e->osr_count + n > 32 ? 32 : e->osr_count + n);
+    return v;
+}
+
+static void shift_in(pio_emu_t *e, uint32_t v, uint8_t n){
+    v &= field_mask(n);
+    if (e->out_right) e->isr = n >= 32 ? v : (e->isr >> n) | (v << (32 - n));
+    else e->isr = n >= 32 ? v : (e->isr << n) | v;
+    e->isr_count = (uint8_t)(e->isr_count + n > 32 ? 32 : e->isr_count + n);
+}
+
+static void advance(pio_emu_t *e){
+    e->pc = (e->pc == e->wrap) ? e->wrap_target : (uint8_t)((e->pc + 1) % e->len);
+}
+
+// One instruction's effect; the caller handles pc, delay and time
+static int exec_ins(pio_emu_t *e, uint16_t ins){
+    const uint8_t arg1 = (ins >> 5) & 0x7; // JMP condition / source / destination
+    const uint8_t arg2 = ins & 0x1f;       // Address / bit count / data
+    const uint8_t bits = arg2 ? arg2 : 32;
+
+    switch (OP(ins)) {
+        case OP_JMP: {
+            int take;
+            switch (arg1) {
+                case 0: take = 1; break;
+                case 1: take = e->x == 0; break;
+                case 2: take = e->x != 0; e->x--; break;
+                case 3: take = e->y == 0; break;
+                case 4: take = e->y != 0; e->y--; break;
+                case 5: take = e->x != e->y; break;
+                case 7: take = e->osr_count < 32; break;
+                default: return -1; // JMP PIN
+            }
+            if (!take) return EXEC_NEXT;
+            e->pc = arg2;
+            return EXEC_JUMP;
+        }
+        case OP_IN: {
+            uint32_t v;
+            switch (arg1) {
+                case 0: v = e->pins >> e->in_base; break;
+                case 1: v = e->x; break;
+                case 2: v = e->y; break;
+                case 3: v = 0; break;
+                case 6: v = e->isr; break;
+                case 7: v = e->osr; break;
+                default: return -1;
+            }
+            shift_in(e, v, bits);
+            return EXEC_NEXT;
+        }
+        case OP_OUT: {
+            if (arg1 == 7) return -1; // OUT EXEC
+            const uint32_t v = shift_out(e, bits);
+            switch (arg1) {
+                case 0: write_pins(e, e->out_base, e->out_count, v, 0); break;
+                case 1: e->x = v; break;
+                case 2: e->y = v; break;
+                case 3: break;
+                case 4: write_pins(e, e->out_base, e->out_count, v, 1); break;
+                case 5: e->pc = (uint8_t)v; return EXEC_JUMP;
+                case 6: e->isr = v; e->isr_count = bits; break;
+            }
+            return EXEC_NEXT;
+        }
+        case OP_PUSH_PULL: {
+            const int if_cond = (ins >> 6) & 1, block = (ins >> 5) & 1;
+            if (ins & 0x80) { // PULL
+                if (if_cond && e->osr_count < 32) return EXEC_NEXT;
+                if (e->tx_level == 0) {
+                    if (block) return EXEC_STALL;
+                    e->osr = e->x;
+                } else {
+                    e->osr = e->tx[e->tx_head];
+                    e->tx_head = (uint8_t)((e->tx_head + 1) % PIO_EMU_FIFO);
+                    e->tx_level--;
+                }
+                e->osr_count = 0;
+            } else { // PUSH
+                if (if_cond && e->isr_count < 32) return EXEC_NEXT;
+                e->rx_last = e->isr;
+                e->rx_count++;
+                e->isr = 0;
+                e->isr_count = 0;
+            }
+            return EXEC_NEXT;
+        }
+        case OP_MOV: {
+            const uint8_t op = (ins >> 3) & 0x3, src = ins & 0x7;
+            uint32_t v;
+            switch (src) {
+                case 0: v = e->pins >> e->in_base; break;
+                case 1: v = e->x; break;
+                case 2: v = e->y; break;
+                case 3: v = 0; break;
+                case 6: v = e->isr; break;
+                case 7: v = e->osr; break;
+                default: return -1; // STATUS
+            }
+            if (op == 1) v = ~v;
+            else if (op == 2) v = bit_reverse(v);
+            switch (arg1) {
+                case 0: write_pins(e, e->out_base, e->out_count, v, 0); break;
+                case 1: e->x = v; break;
+                case 2: e->y = v; break;
+                case 5: e->pc = (uint8_t)(v & 0x1f); return EXEC_JUMP;
+                case 6: e->isr = v; e->isr_count = 0; break;
+                case 7: e->osr = v; e->osr_count = 0; break;
+                default: return -1; // EXEC
+            }
+            return EXEC_NEXT;
+        }
+        case OP_SET:
+            switch (arg1) {
+                case 0: write_pins(e, e->set_base, e->set_count, arg2, 0); break;
+                case 1: e->x = arg2; break;
+                case 2: e->y = arg2; break;
+                case 4: write_pins(e, e->set_base, e->set_count, arg2, 1); break;
+                default: return -1;
+            }
+            return EXEC_NEXT;
+        default:
+            return -1; // WAIT, IRQ
+    }
+}
+
+// Fractional divider: INT system clocks per cycle, one more whenever the 8-bit FRAC accumulator carries
+static inline void tick(pio_emu_t *e){
+    const uint32_t acc = (uint32_t)e->frac_acc + e->div_frac;
+    e->frac_acc = (uint8_t)acc;
+    e->sysclk += e->div_int + (acc >> 8);
+    e->cycle++;
+}
+
+int pio_emu_step(pio_emu_t *e){
+    if (e->delay) {
+        e->delay--;
+        tick(e);
+        return 0;
+    }
+
+    const uint16_t ins = e->prog[e->pc];
+    const int rc = exec_ins(e, ins);
+    if (rc < 0) return -1;
+    if (rc == EXEC_STALL) { // Same instruction next cycle, no delay
+        e->stalls++;
+        tick(e);
+        return 0;
+    }
+    if (rc == EXEC_NEXT) advance(e);
+    e->delay = DELAY(ins);
+    tick(e);
+    return 0;
+}
+
+int pio_emu_exec(pio_emu_t *e, uint16_t ins){
+    const int rc = exec_ins(e, ins);
+    return (rc < 0 || rc == EXEC_STALL) ? -1 : 0;
+}
+
+int pio_emu_run(pio_emu_t *e, uint64_t until){
+    while (e->cycle < until) {
+        if (pio_emu_step(e) < 0) return -1;
+    }
+    return 0;
+}
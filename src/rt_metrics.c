@@ -0,0 +1,164 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "rt_metrics.h"
+#include "hw_conf.h"
+
+static const int64_t hist_bounds[RT_HIST_BUCKETS - 1] = RT_HIST_BOUNDS_NS;
+
+void rt_hist_observe(rt_hist_t *h, int64_t ns){
+    if (ns < 0) ns = 0;
+    int b = 0;
+    while (b < RT_HIST_BUCKETS - 1 && ns > hist_bounds[b]) b++;
+    atomic_fetch_add_explicit(&h->bucket[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, (uint64_t)ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+}
+
+void rt_metrics_edge(rt_metrics_t *m, int64_t late_ns, int64_t send_ns){
+    rt_hist_observe(&m->lateness, late_ns);
+    rt_hist_observe(&m->tx_send, send_ns);
+    if (late_ns > RT_DEADLINE_MISS_NS) atomic_fetch_add_explicit(&m->deadline_misses, 1, memory_order_relaxed);
+    // Single writer: plain compare + store is enough
+    if (late_ns > atomic_load_explicit(&m->worst_late_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&m->worst_late_ns, late_ns, memory_order_relaxed);
+    }
+}
+
+void rt_metrics_frame(rt_metrics_t *m){
+    atomic_fetch_add_explicit(&m->frames_sent, 1, memory_order_relaxed);
+}
+
+#define APPEND(...) do { \
+    if (off < len) { \
+        int n_ = snprintf(buf + off, len - off, __VA_ARGS__); \
+        if (n_ > 0) off += (size_t)n_; \
+    } \
+} while (0)
+
+static size_t format_hist(const rt_hist_t *h, const char *name, const char *help, char *buf, size_t len, size_t off){
+    APPEND("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cum = 0;
+    for (int b = 0; b < RT_HIST_BUCKETS - 1; ++b) {
+        cum += atomic_load_explicit(&h->bucket[b], memory_order_relaxed);
+        APPEND("%s_bucket{le=\"%g\"} %llu\n", name, (double)hist_bounds[b] / 1e9, (unsigned long long)cum);
+    }
+    cum += atomic_load_explicit(&h->bucket[RT_HIST_BUCKETS - 1], memory_order_relaxed);
+    APPEND("%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cum);
+    APPEND("%s_sum %.9f\n", name, (double)atomic_load_explicit(&h->sum_ns, memory_order_relaxed) / 1e9);
+    APPEND("%s_count %llu\n", name, (unsigned long long)cum);
+    return off;
+}
+
+size_t rt_metrics_format(const rt_metrics_t *m, char *buf, size_t len){
+    size_t off = 0;
+    APPEND("# HELP dcf77_frames_sent_total Complete minute frames transmitted.\n# TYPE dcf77_frames_sent_total counter\n");
+    APPEND("dcf77_frames_sent_total %llu\n", (unsigned long long)atomic_load_explicit(&m->frames_sent, memory_order_relaxed));
+    APPEND("# HELP dcf77_deadline_misses_total Edges applied more than %.3fms after their deadline.\n# TYPE dcf77_deadline_misses_total counter\n", RT_DEADLINE_MISS_NS / 1e6);
+    APPEND("dcf77_deadline_misses_total %llu\n", (unsigned long long)atomic_load_explicit(&m->deadline_misses, memory_order_relaxed));
+    APPEND("# HELP dcf77_edge_lateness_worst_seconds Worst edge wake-up lateness since start.\n# TYPE dcf77_edge_lateness_worst_seconds gauge\n");
+    APPEND("dcf77_edge_lateness_worst_seconds %.9f\n", (double)atomic_load_explicit(&m->worst_late_ns, memory_order_relaxed) / 1e9);
+    APPEND("# HELP dcf77_utc_error_seconds Last discipline sample: time source UTC minus the UTC edges are scheduled on.\n# TYPE dcf77_utc_error_seconds gauge\n");
+    APPEND("dcf77_utc_error_seconds %.9f\n", (double)atomic_load_explicit(&m->utc_error_ns, memory_order_relaxed) / 1e9);
+    APPEND("# HELP dcf77_clock_drift_ppb Estimated drift of the local clock against the time source.\n# TYPE dcf77_clock_drift_ppb gauge\n");
+    APPEND("dcf77_clock_drift_ppb %lld\n", (long long)atomic_load_explicit(&m->freq_ppb, memory_order_relaxed));
+    APPEND("# HELP dcf77_utc_out_of_bound_total Discipline samples further from UTC than the configured bound.\n# TYPE dcf77_utc_out_of_bound_total counter\n");
+    APPEND("dcf77_utc_out_of_bound_total %llu\n", (unsigned long long)atomic_load_explicit(&m->utc_out_of_bound, memory_order_relaxed));
+    APPEND("# HELP dcf77_first_frame_seconds Transmitter start to the end of the first complete minute frame.\n# TYPE dcf77_first_frame_seconds gauge\n");
+    APPEND("dcf77_first_frame_seconds %.3f\n", (double)atomic_load_explicit(&m->first_frame_ns, memory_order_relaxed) / 1e9);
+    APPEND("# HELP dcf77_log_dropped_total Transmit thread log records dropped (ring full or over the rate limit).\n# TYPE dcf77_log_dropped_total counter\n");
+    APPEND("dcf77_log_dropped_total %llu\n", (unsigned long long)atomic_load_explicit(&m->log_dropped, memory_order_relaxed));
+    APPEND("# HELP dcf77_spin_seconds_total Time the edge thread spent spinning to deadlines (hybrid wait).\n# TYPE dcf77_spin_seconds_total counter\n");
+    APPEND("dcf77_spin_seconds_total %.6f\n", (double)atomic_load_explicit(&m->spin_ns, memory_order_relaxed) / 1e9);
+    APPEND("# HELP dcf77_spin_waits_total Deadlines reached by the hybrid wait.\n# TYPE dcf77_spin_waits_total counter\n");
+    APPEND("dcf77_spin_waits_total %llu\n", (unsigned long long)atomic_load_explicit(&m->spin_waits, memory_order_relaxed));
+    APPEND("# HELP dcf77_spin_overshoots_total Hybrid wait sleeps that woke past the deadline.\n# TYPE dcf77_spin_overshoots_total counter\n");
+    APPEND("dcf77_spin_overshoots_total %llu\n", (unsigned long long)atomic_load_explicit(&m->spin_overshoots, memory_order_relaxed));
+    APPEND("# HELP dcf77_spin_margin_seconds Hybrid wait: sleep ends this long before the deadline, then spins (0 = off).\n# TYPE dcf77_spin_margin_seconds gauge\n");
+    APPEND("dcf77_spin_margin_seconds %.9f\n", (double)atomic_load_explicit(&m->spin_margin_ns, memory_order_relaxed) / 1e9);
+    off = format_hist(&m->lateness, "dcf77_edge_lateness_seconds", "Edge wake-up lateness relative to the absolute deadline.", buf, len, off);
+    off = format_hist(&m->tx_send, "dcf77_tx_send_seconds", "Time spent applying an attenuator edge.", buf, len, off);
+    return off < len ? off : len;
+}
+
+#undef APPEND
+
+static void serve_client(rt_metrics_srv_t *srv, int cfd){
+    static const char http_hdr[] = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n";
+    char req[512];
+    char body[8192];
+    int http = 0;
+
+    // Plain readers (socat, nc) send nothing: answer after a short wait either way
+    struct pollfd pfd = { .fd = cfd, .events = POLLIN };
+    if (poll(&pfd, 1, 100) > 0) {
+        ssize_t n = recv(cfd, req, sizeof(req) - 1, MSG_DONTWAIT);
+        if (n > 0) { req[n] = '\0'; http = strncmp(req, "GET ", 4) == 0; }
+    }
+
+    size_t blen = rt_metrics_format(srv->m, body, sizeof(body));
+    if (http) send(cfd, http_hdr, sizeof(http_hdr) - 1, MSG_NOSIGNAL);
+    send(cfd, body, blen, MSG_NOSIGNAL);
+}
+
+static void *serve_loop(void *args){
+    rt_metrics_srv_t *srv = (rt_metrics_srv_t *)args;
+    for (;;) {
+        int cfd = accept(srv->fd, NULL, NULL);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // Listener shut down
+        }
+        serve_client(srv, cfd);
+        close(cfd);
+    }
+    return NULL;
+}
+
+int rt_metrics_serve_start(rt_metrics_srv_t *srv, rt_metrics_t *m, const char *path){
+    memset(srv, 0, sizeof(*srv));
+    srv->m = m;
+    srv->fd = -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Metrics: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    strcpy(srv->path, path);
+
+    srv->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (srv->fd < 0) { perror("Metrics: socket"); return -1; }
+
+    unlink(path);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(srv->fd, 4) < 0) {
+        perror("Metrics: bind/listen");
+        close(srv->fd);
+        srv->fd = -1;
+        return -1;
+    }
+
+    if (thread_create_low(&srv->tid, serve_loop, srv) != 0) {
+        perror("Metrics: pthread_create");
+        close(srv->fd);
+        unlink(path);
+        srv->fd = -1;
+        return -1;
+    }
+    return 1;
+}
+
+void rt_metrics_serve_stop(rt_metrics_srv_t *srv){
+    if (srv->fd < 0) return;
+    shutdown(srv->fd, SHUT_RDWR); // Wakes accept()
+    pthread_join(srv->tid, NULL);
+    close(srv->fd);
+    unlink(srv->path);
+    srv->fd = -1;
+}
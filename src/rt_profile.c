@@ -0,0 +1,288 @@
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include "rt_profile.h"
+#include "parse_num.h"
+#include "tx_clock.h"
+
+#define CPU_SYSFS "/sys/devices/system/cpu"
+
+void rt_profile_defaults(rt_profile_t *p){
+    *p = (rt_profile_t){
+        .main_core = 2,
+        .tx_core = 3,
+        .spin_core = RT_CORE_NONE,
+        .spin_margin_ns = 0,
+        .main_prio = 99,
+        .tx_prio = 99,
+        .slack_ns = 0,
+        .calib_ms = 1000,
+        .budget_ns = 1000000LL, // Same as a metrics deadline miss
+        .strict = 0
+    };
+}
+
+static int parse_pair(rt_profile_t *p, char *kv){
+    while (*kv == ' ' || *kv == '\t') kv++;
+    if (*kv == '\0' || *kv == '#') return 0;
+    char *val = strchr(kv, '=');
+    if (!val) {
+        fprintf(stderr, "Error: RT profile entry '%s' is not key=value\n", kv);
+        return -1;
+    }
+    char *end = val;
+    while (end > kv && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = '\0';
+    while (*++val == ' ' || *val == '\t') {}
+    end = val + strlen(val);
+    while (end > val && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) *--end = '\0';
+
+    long long v;
+    int rc = -1;
+    if      (!strcmp(kv, "main"))      { if ((rc = parse_ll(val, 0, CPU_SETSIZE - 1, &v)) == 0) p->main_core = (int)v; }
+    else if (!strcmp(kv, "tx"))        { if ((rc = parse_ll(val, 0, CPU_SETSIZE - 1, &v)) == 0) p->tx_core = (int)v; }
+    else if (!strcmp(kv, "spin"))      { if ((rc = parse_ll(val, RT_CORE_NONE, CPU_SETSIZE - 1, &v)) == 0) p->spin_core = (int)v; }
+    else if (!strcmp(kv, "margin"))    { if ((rc = parse_ll(val, 0, 1000, &v)) == 0) p->spin_margin_ns = v * 1000LL; }
+    else if (!strcmp(kv, "prio"))      { if ((rc = parse_ll(val, 0, 99, &v)) == 0) p->main_prio = p->tx_prio = (int)v; }
+    else if (!strcmp(kv, "main-prio")) { if ((rc = parse_ll(val, 0, 99, &v)) == 0) p->main_prio = (int)v; }
+    else if (!strcmp(kv, "tx-prio"))   { if ((rc = parse_ll(val, 0, 99, &v)) == 0) p->tx_prio = (int)v; }
+    else if (!strcmp(kv, "slack"))     { if ((rc = parse_ll(val, 0, UINT32_MAX, &v)) == 0) p->slack_ns = (uint32_t)v; }
+    else if (!strcmp(kv, "calib"))     { if ((rc = parse_ll(val, 0, 600000, &v)) == 0) p->calib_ms = (uint32_t)v; }
+    else if (!strcmp(kv, "budget"))    { if ((rc = parse_ll(val, 1, 1000000, &v)) == 0) p->budget_ns = v * 1000LL; }
+    else if (!strcmp(kv, "strict"))    { if ((rc = parse_ll(val, 0, 1, &v)) == 0) p->strict = (uint8_t)v; }
+    else {
+        fprintf(stderr, "Error: unknown RT profile key '%s'\n", kv);
+        return -1;
+    }
+    if (rc != 0) fprintf(stderr, "Error: invalid RT profile value %s=%s\n", kv, val);
+    return rc;
+}
+
+int rt_profile_parse(rt_profile_t *p, const char *spec){
+    char line[256];
+
+    if (spec[0] == '@') {
+        FILE *f = fopen(spec + 1, "r");
+        if (!f) {
+            perror(spec + 1);
+            return -1;
+        }
+        int rc = 0;
+        while (rc == 0 && fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\n")] = '\0';
+            rc = parse_pair(p, line);
+        }
+        fclose(f);
+        return rc;
+    }
+
+    if (strlen(spec) >= sizeof(line)) {
+        fprintf(stderr, "Error: RT profile too long\n");
+        return -1;
+    }
+    strcpy(line, spec);
+    char *save = NULL;
+    for (char *kv = strtok_r(line, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        if (parse_pair(p, kv) < 0) return -1;
+    }
+    return 0;
+}
+
+int rt_thread_setup(int core, int prio, uint32_t slack_ns){
+    int rc = 0, err;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset)) != 0) {
+        fprintf(stderr, "pthread_setaffinity_np(core %d): %s\n", core, strerror(err));
+        rc = -1;
+    }
+
+    struct sched_param param = { .sched_priority = prio };
+    if ((err = pthread_setschedparam(pthread_self(), prio ? SCHED_FIFO : SCHED_OTHER, &param)) != 0) {
+        fprintf(stderr, "pthread_setschedparam(%s %d): %s\n", prio ? "SCHED_FIFO" : "SCHED_OTHER", prio, strerror(err));
+        rc = -1;
+    }
+
+    if (slack_ns && prctl(PR_SET_TIMERSLACK, (unsigned long)slack_ns, 0, 0, 0) != 0) {
+        perror("prctl(PR_SET_TIMERSLACK)");
+        rc = -1;
+    }
+    return rc;
+}
+
+// "0-3,6" style list from sysfs; 0 if the file is missing or empty
+static int read_cpulist(const char *path, cpu_set_t *set){
+    char buf[256];
+    CPU_ZERO(set);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    const int ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    if (!ok) return 0;
+
+    int n = 0;
+    char *s = buf;
+    while (*s && *s != '\n') {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s) break;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++) { CPU_SET(c, set); n++; }
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static int read_word(const char *path, char *buf, size_t len){
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    const int ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+#define CHECK_OK   0
+#define CHECK_WARN 1
+#define CHECK_FAIL 2
+
+static void report(FILE *out, int verbose, int level, const char *msg){
+    static const char *tag[] = { "[ ok ]", "[warn]", "[FAIL]" };
+    if (level == CHECK_OK && !verbose) return;
+    fprintf(out, "  %s %s\n", tag[level], msg);
+}
+
+int rt_selfcheck(const rt_profile_t *p, int mlock_ok, int verbose, FILE *out){
+    char msg[160], word[64], path[96];
+    int fails = 0;
+    const int edge = rt_profile_edge_core(p);
+    const long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+
+    if (verbose) fprintf(out, "RT self-check: main core %d prio %d, edge core %d prio %d%s\n",
+                         p->main_core, p->main_prio, edge, p->tx_prio, p->spin_core != RT_CORE_NONE ? " (spin)" : "");
+
+    const int cores[2] = { p->main_core, edge };
+    for (int i = 0; i < 2; i++) {
+        if (i && cores[1] == cores[0]) {
+            report(out, verbose, CHECK_WARN, "main and edge threads share a core");
+            continue;
+        }
+        snprintf(msg, sizeof(msg), "core %d %s", cores[i], cores[i] < ncpu ? "present" : "does not exist");
+        if (cores[i] >= ncpu) fails++;
+        report(out, verbose, cores[i] < ncpu ? CHECK_OK : CHECK_FAIL, msg);
+    }
+
+    // Isolation only matters where the edges are timed
+    cpu_set_t set;
+    read_cpulist(CPU_SYSFS "/isolated", &set);
+    snprintf(msg, sizeof(msg), "edge core %d %s isolcpus", edge, CPU_ISSET(edge, &set) ? "in" : "not in");
+    report(out, verbose, CPU_ISSET(edge, &set) ? CHECK_OK : CHECK_WARN, msg);
+    read_cpulist(CPU_SYSFS "/nohz_full", &set);
+    snprintf(msg, sizeof(msg), "edge core %d %s nohz_full", edge, CPU_ISSET(edge, &set) ? "in" : "not in");
+    report(out, verbose, CPU_ISSET(edge, &set) ? CHECK_OK : CHECK_WARN, msg);
+    if (p->spin_core != RT_CORE_NONE && !CPU_ISSET(edge, &set)) {
+        report(out, verbose, CHECK_WARN, "busy-waiting on a core with a scheduler tick");
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (i && cores[1] == cores[0]) break;
+        snprintf(path, sizeof(path), CPU_SYSFS "/cpu%d/cpufreq/scaling_governor", cores[i]);
+        if (read_word(path, word, sizeof(word)) < 0) {
+            snprintf(msg, sizeof(msg), "core %d governor unknown (no cpufreq)", cores[i]);
+            report(out, verbose, CHECK_OK, msg);
+            continue;
+        }
+        snprintf(msg, sizeof(msg), "core %d governor %s", cores[i], word);
+        report(out, verbose, strcmp(word, "performance") ? CHECK_WARN : CHECK_OK, msg);
+    }
+
+    if (!mlock_ok) fails++;
+    report(out, verbose, mlock_ok ? CHECK_OK : CHECK_FAIL, mlock_ok ? "memory locked (mlockall)" : "memory not locked: page faults can stall edges");
+
+    // The caller already ran rt_thread_setup(): check it actually took
+    int policy;
+    struct sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    const int want = p->main_prio ? SCHED_FIFO : SCHED_OTHER;
+    const int sched_ok = policy == want && (!p->main_prio || param.sched_priority == p->main_prio);
+    snprintf(msg, sizeof(msg), "main thread %s %d (want %s %d)", policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER",
+             param.sched_priority, want == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_OTHER", p->main_prio);
+    if (!sched_ok) fails++;
+    report(out, verbose, sched_ok ? CHECK_OK : CHECK_FAIL, msg);
+
+    return fails;
+}
+
+typedef struct calib_job {
+    const rt_profile_t *p;
+    int64_t *lat;
+    uint32_t n;
+    int setup_ok;
+    int done;
+} calib_job_t;
+
+static void *calib_loop(void *arg){
+    calib_job_t *job = (calib_job_t *)arg;
+    job->setup_ok = rt_thread_setup(rt_profile_edge_core(job->p), job->p->tx_prio, job->p->slack_ns) == 0;
+
+    // The edge loop's own wait (epoll on a realtime timerfd), so the p99 that seeds the spin margin is its lateness
+    tx_clock_t clk;
+    if (tx_clock_realtime_init(&clk) < 0) return NULL;
+    int64_t next = tx_clock_ns(&clk) + RT_CALIB_INTERVAL_NS;
+    for (uint32_t i = 0; i < job->n; i++, next += RT_CALIB_INTERVAL_NS) {
+        const struct timespec ts = { .tv_sec = next / 1000000000LL, .tv_nsec = next % 1000000000LL };
+        clk.sleep_until(&clk, &ts);
+        job->lat[i] = tx_clock_ns(&clk) - next;
+    }
+    tx_clock_close(&clk);
+    job->done = 1;
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b){
+    const int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int rt_calibrate(const rt_profile_t *p, rt_calib_t *res){
+    calib_job_t job = { .p = p, .n = p->calib_ms };
+    memset(res, 0, sizeof(*res));
+    res->core = rt_profile_edge_core(p);
+    res->prio = p->tx_prio;
+    if (!job.n) return 1;
+
+    job.lat = malloc(job.n * sizeof(*job.lat));
+    if (!job.lat) return -1;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, calib_loop, &job) != 0) {
+        free(job.lat);
+        return -1;
+    }
+    pthread_join(tid, NULL);
+    if (!job.done) {
+        free(job.lat);
+        return -1;
+    }
+
+    qsort(job.lat, job.n, sizeof(*job.lat), cmp_i64);
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < job.n; i++) sum += job.lat[i];
+    res->samples = job.n;
+    res->min_ns = job.lat[0];
+    res->avg_ns = sum / job.n;
+    res->p99_ns = job.lat[(job.n - 1) * 99 / 100];
+    res->max_ns = job.lat[job.n - 1];
+    free(job.lat);
+    res->setup_ok = (uint8_t)job.setup_ok;
+    return res->max_ns <= p->budget_ns ? 1 : 0;
+}
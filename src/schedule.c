@@ -0,0 +1,256 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "schedule.h"
+#include "hw_conf.h"
+#include "dcf77.h"
+#include "timecode.h"
+#include "tx_clock.h"
+
+typedef struct chan_edges {
+    uint16_t n;
+    tx_edge_t edge[SCHED_CHAN_EDGES];
+} chan_edges_t;
+
+static void edge_add(chan_edges_t *out, time_t sec_abs, long nsec, uint8_t state, int sec, int chan){
+    if (out->n >= SCHED_CHAN_EDGES) return;
+    tx_edge_t *e = &out->edge[out->n++];
+    e->at.tv_sec = sec_abs;
+    e->at.tv_nsec = nsec;
+    e->state = state;
+    e->sec = (uint8_t)sec;
+    e->chan = (uint8_t)chan;
+}
+
+// One channel's frame as edges, already in deadline order
+static void compile_frame(const tc_proto_t *p, const tc_frame_t *frame, time_t minute_start, int chan, chan_edges_t *out){
+    // Only changes of state become edges: a symbol that starts in the state the last one ended in adds none
+    int state = -1;
+    const int n = tc_seconds(frame);
+    out->n = 0;
+    for (int sec = 0; sec < n; sec++) {
+        const tc_symbol_t *sym = tc_symbol(p, frame, sec);
+        // Leap second (59th sends '0'): the kernel repeats second 59 for the inserted 60th,
+        // so releasing at 59.100 leaves the repeated second unmodulated as the minute mark
+        const time_t at = minute_start + (sec < 60 ? sec : 59);
+        for (int i = 0; i < sym->n; i++) {
+            if (sym->seg[i].state == state) continue;
+            state = sym->seg[i].state;
+            edge_add(out, at, sym->seg[i].ms * 1000000L, (uint8_t)state, sec, chan);
+        }
+    }
+}
+
+int sched_compile_minute(const tx_chan_t *chan, int n_chan, time_t minute_start, uint8_t *leap, tx_minute_t *out){
+    chan_edges_t ce[TX_MAX_CHANNELS];
+    tc_frame_t frame[TX_MAX_CHANNELS];
+    if (n_chan > TX_MAX_CHANNELS) n_chan = TX_MAX_CHANNELS;
+
+    out->minute_start = minute_start;
+    out->gen = 0;
+    out->idle = 0;
+    out->n_chan = (uint8_t)n_chan;
+    out->n_edges = 0;
+
+    for (int c = 0; c < n_chan; c++) {
+        const tx_chan_t *ch = &chan[c];
+        // Frame cache: a channel sending the same time as an earlier one reuses its frame and edges
+        int same = -1;
+        for (int j = 0; j < c && same < 0; j++) {
+            if (chan[j].proto == ch->proto && chan[j].tz == ch->tz && chan[j].t_toff == ch->t_toff) same = j;
+        }
+        if (same >= 0) {
+            frame[c] = frame[same];
+            ce[c] = ce[same];
+            for (int i = 0; i < ce[c].n; i++) ce[c].edge[i].chan = (uint8_t)c;
+        } else {
+            // The offset moves the transmitted time only: edges stay on the minute that is on air
+            frame[c] = tc_encode(ch->proto, minute_start + (time_t)ch->t_toff * 60, ch->tz, *leap);
+            compile_frame(ch->proto, &frame[c], minute_start, c, &ce[c]);
+        }
+        out->frame[c] = frame[c].a;
+        out->frame_b[c] = frame[c].b;
+    }
+
+    // Merge the per-channel lists into one deadline stream (ties keep channel order)
+    uint16_t pos[TX_MAX_CHANNELS] = {0};
+    for (;;) {
+        int best = -1;
+        for (int c = 0; c < n_chan; c++) {
+            if (pos[c] >= ce[c].n) continue;
+            if (best < 0 || tx_ts_ns(&ce[c].edge[pos[c]].at) < tx_ts_ns(&ce[best].edge[pos[best]].at)) best = c;
+        }
+        if (best < 0 || out->n_edges >= SCHED_MAX_EDGES) break;
+        out->edge[out->n_edges++] = ce[best].edge[pos[best]++];
+    }
+    return out->n_edges;
+}
+
+void tx_live_init(tx_live_t *l, const tx_chan_t *chan, int n_chan){
+    memset(l, 0, sizeof(*l));
+    pthread_mutex_init(&l->lck, NULL);
+    for (int c = 0; c < n_chan && c < TX_MAX_CHANNELS; c++) l->t_toff[c] = chan[c].t_toff;
+}
+
+void tx_live_destroy(tx_live_t *l){
+    pthread_mutex_destroy(&l->lck);
+}
+
+void tx_live_commit(tx_live_t *l){
+    atomic_fetch_add_explicit(&l->gen, 1, memory_order_release);
+}
+
+int tx_live_window_on(const tx_live_t *l, time_t minute_start){
+    if (!l->n_win) return 1;
+    const int m = (int)(((minute_start % 86400) + 86400) % 86400 / 60);
+    for (int i = 0; i < l->n_win; i++) {
+        const int from = l->win_from[i], to = l->win_to[i];
+        if (from <= to ? (m >= from && m < to) : (m >= from || m < to)) return 1;
+    }
+    return 0;
+}
+
+// Leap indicator for the minute from minute_start. Leap seconds only happen at the end of a month (the rule of
+// leap_boundary()): on any other day the indication is held back, and once its boundary is armed the indication
+// is used up, so a stale flag is not sent again at the next month end. Only a changed source arms a new one.
+static uint8_t minute_leap(tx_sched_t *s, time_t minute_start){
+    if (s->leap_src) {
+        const uint8_t li = atomic_load_explicit(s->leap_src, memory_order_relaxed);
+        if (li != s->leap_src_last) {
+            s->leap = li;
+            if (!li) s->leap_at = 0; // Withdrawn
+        }
+        s->leap_src_last = li;
+    }
+    // Minutes before the armed boundary keep it, also when the producer rewinds to them
+    if (s->leap_at && minute_start < s->leap_at) return s->leap_armed;
+    if (s->leap != 1 && s->leap != 2) return 0;
+
+    const time_t midnight = (minute_start / 86400 + 1) * 86400;
+    struct tm tm;
+    gmtime_r(&midnight, &tm);
+    if (tm.tm_mday != 1) return 0;
+    s->leap_at = midnight;
+    s->leap_armed = s->leap;
+    s->leap = 0;
+    return s->leap_armed;
+}
+
+// Compile the next minute with the live settings of the current generation
+static void compile_live(tx_sched_t *s, tx_minute_t *out){
+    tx_chan_t chan[TX_MAX_CHANNELS];
+    memcpy(chan, s->chan, sizeof(chan[0]) * (size_t)s->n_chan);
+
+    pthread_mutex_lock(&s->live->lck);
+    const uint32_t gen = atomic_load_explicit(&s->live->gen, memory_order_acquire);
+    if (gen != s->gen) {
+        // Minutes compiled with the old settings get dropped by the consumer: compile again from the one after
+        // the minute on air. A stale 'taken' only costs a duplicate, which the consumer skips.
+        const int64_t taken = atomic_load_explicit(&s->taken, memory_order_acquire);
+        if (taken && s->next_minute > taken + 60) {
+            if (s->remaining > 0) s->remaining += (int)((s->next_minute - (taken + 60)) / 60);
+            s->next_minute = taken + 60;
+        }
+        s->gen = gen;
+    }
+    for (int c = 0; c < s->n_chan; c++) chan[c].t_toff = s->live->t_toff[c];
+    const int on = tx_live_window_on(s->live, s->next_minute);
+    pthread_mutex_unlock(&s->live->lck);
+
+    if (on) {
+        uint8_t leap = minute_leap(s, s->next_minute);
+        sched_compile_minute(chan, s->n_chan, s->next_minute, &leap, out);
+    } else {
+        out->minute_start = s->next_minute;
+        out->idle = 1;
+        out->n_chan = (uint8_t)s->n_chan;
+        out->n_edges = 0;
+    }
+    out->gen = gen;
+}
+
+static int stopped(tx_sched_t *s){
+    return atomic_load_explicit(&s->quit, memory_order_acquire) || atomic_load_explicit(s->stop, memory_order_acquire);
+}
+
+static void *sched_producer(void *args){
+    tx_sched_t *s = (tx_sched_t *)args;
+
+    while (s->remaining != 0 && !stopped(s)) {
+        while (sem_wait(&s->free) != 0 && errno == EINTR);
+        if (stopped(s)) break;
+
+        const uint32_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+        if (s->live) compile_live(s, &s->slot[head % SCHED_RING]);
+        else {
+            uint8_t leap = minute_leap(s, s->next_minute);
+            sched_compile_minute(s->chan, s->n_chan, s->next_minute, &leap, &s->slot[head % SCHED_RING]);
+        }
+        atomic_store_explicit(&s->head, head + 1, memory_order_release);
+        s->next_minute += 60;
+        if (s->remaining > 0) s->remaining--;
+        sem_post(&s->filled); // Release: slot contents visible to the consumer
+    }
+
+    atomic_store_explicit(&s->done, 1, memory_order_release);
+    sem_post(&s->filled); // Wake a consumer waiting on an empty ring
+    return NULL;
+}
+
+int sched_start(tx_sched_t *s, const tx_chan_t *chan, int n_chan, tx_live_t *live, time_t first_minute, int minutes, uint8_t leap, _Atomic uint8_t *leap_src, atomic_bool *stop){
+    memset(s, 0, sizeof(*s));
+    s->chan = chan;
+    s->n_chan = n_chan;
+    s->live = live;
+    if (live) s->gen = atomic_load_explicit(&live->gen, memory_order_acquire);
+    s->next_minute = first_minute;
+    s->remaining = minutes;
+    s->leap = leap;
+    s->leap_src = leap_src;
+    s->leap_src_last = leap; // The caller read the start value from the same source
+    s->stop = stop;
+    sem_init(&s->filled, 0, 0);
+    sem_init(&s->free, 0, SCHED_RING);
+
+    if (thread_create_low(&s->tid, sched_producer, s) != 0) {
+        perror("Schedule: pthread_create");
+        sem_destroy(&s->filled);
+        sem_destroy(&s->free);
+        return -1;
+    }
+    return 1;
+}
+
+const tx_minute_t *sched_next(tx_sched_t *s){
+    for (;;) {
+        while (sem_wait(&s->filled) != 0 && errno == EINTR);
+        // The producer posts once more when it finishes: an empty ring then means no more minutes
+        const int done = atomic_load_explicit(&s->done, memory_order_acquire);
+        if (done && s->tail == atomic_load_explicit(&s->head, memory_order_acquire)) return NULL;
+        const tx_minute_t *m = &s->slot[s->tail % SCHED_RING];
+        if (!s->live) return m;
+
+        // Compiled before a settings change, or a repeat after the producer rewound: it compiles this minute again
+        const int64_t taken = atomic_load_explicit(&s->taken, memory_order_relaxed);
+        const int stale = m->gen != atomic_load_explicit(&s->live->gen, memory_order_acquire) || (taken && m->minute_start <= taken);
+        if (!stale || (done && m->minute_start > taken)) { // A finished producer recompiles nothing: send it as is
+            atomic_store_explicit(&s->taken, m->minute_start, memory_order_release);
+            return m;
+        }
+        sched_release(s);
+    }
+}
+
+void sched_release(tx_sched_t *s){
+    s->tail++;
+    sem_post(&s->free);
+}
+
+void sched_stop(tx_sched_t *s){
+    atomic_store_explicit(&s->quit, 1, memory_order_release);
+    sem_post(&s->free); // Unblock a producer waiting for space; it sees the quit flag
+    pthread_join(s->tid, NULL);
+    sem_destroy(&s->filled);
+    sem_destroy(&s->free);
+}
@@ -0,0 +1,256 @@
+#include <string.h>
+
+#include "timecode.h"
+#include "tz_cache.h"
+
+#define TC_BIT(s) (1ULL << (s))
+#define TC_MARKERS_10S (TC_BIT(0) | TC_BIT(9) | TC_BIT(19) | TC_BIT(29) | TC_BIT(39) | TC_BIT(49) | TC_BIT(59))
+
+// Attenuate from the start of the second for 'ms', then full carrier
+#define TC_ATT(ms) { 2, { { 0, Carrier_MOD }, { (ms), Carrier } } }
+// Full carrier for 'ms', then attenuated until the next second (JJY)
+#define TC_FULL(ms) { 2, { { 0, Carrier }, { (ms), Carrier_MOD } } }
+
+// MSF: UK rules, GMT/BST switching at 01:00 UTC
+static const DSTRule_t uk_start = {3, 5, 0, 1, 0};
+static const DSTRule_t uk_end =   {10, 5, 0, 2, 0};
+// WWVB DST bits: US rules, second Sunday in March to first Sunday in November at 2am
+static const DSTRule_t us_start = {3, 2, 0, 2, 0};
+static const DSTRule_t us_end =   {11, 1, 0, 2, 0};
+
+/*
+DCF77 (77.5kHz, Mainflingen): see the frame layout in dcf77-pi5.c. 100/200ms attenuation for '0'/'1',
+second 59 unmodulated; a leap second sends '0' at 59 and the minute mark at 60.
+*/
+const tc_proto_t tc_dcf77 = {
+    .name = "dcf77", .carrier_hz = 77500.0,
+    .zone = "Europe/Berlin", .std_offset = 3600, .dst_start = &startRule, .dst_end = &endRule,
+    .next_minute = 1, .leap_insert = 1,
+    .const_a = TC_BIT(20),
+    .markers = TC_BIT(59),
+    .n_fields = 10,
+    .field = {
+        { TC_SRC_ANNOUNCE,  0, 16, 0, 0, {1} },
+        { TC_SRC_DST,       0, 17, 0, 0, {1} },
+        { TC_SRC_STD,       0, 18, 0, 0, {1} },
+        { TC_SRC_LEAP_HOUR, 0, 19, 0, 0, {1} },
+        { TC_SRC_MIN,       0, 21, 0, 0, {4, 3} },
+        { TC_SRC_HOUR,      0, 29, 0, 0, {4, 2} },
+        { TC_SRC_MDAY,      0, 36, 0, 0, {4, 2} },
+        { TC_SRC_WDAY,      0, 42, 0, 0, {3} },
+        { TC_SRC_MON,       0, 45, 0, 0, {4, 1} },
+        { TC_SRC_YEAR,      0, 50, 0, 0, {4, 4} },
+    },
+    .n_parity = 3,
+    .parity = { { 28, 0, 21, 27, 0 }, { 35, 0, 29, 34, 0 }, { 58, 0, 36, 57, 0 } },
+    .sym = { TC_ATT(100), TC_ATT(200), TC_ATT(100), TC_ATT(200), { 0 } },
+};
+
+/*
+MSF (60kHz, Anthorn): two bits per second. Minute marker 500ms off; A/B 00 = 100ms, 10 = 200ms, 11 = 300ms,
+01 = 100ms off, 100ms on, 100ms off. A 17-51 date and time MSB first, A 52-59 = 01111110,
+B 53 BST change imminent, B 54-57 odd parity, B 58 BST in effect. DUT1 (B 1-16) is sent as 0.
+*/
+const tc_proto_t tc_msf = {
+    .name = "msf", .carrier_hz = 60000.0,
+    .zone = "Europe/London", .std_offset = 0, .dst_start = &uk_start, .dst_end = &uk_end,
+    .next_minute = 1,
+    .const_a = 0x3fULL << 53,
+    .markers = TC_BIT(0),
+    .n_fields = 8,
+    .field = {
+        { TC_SRC_YEAR,     0, 17, 1, 0, {4, 4} },
+        { TC_SRC_MON,      0, 25, 1, 0, {1, 4} },
+        { TC_SRC_MDAY,     0, 30, 1, 0, {2, 4} },
+        { TC_SRC_WDAY0,    0, 36, 1, 0, {3} },
+        { TC_SRC_HOUR,     0, 39, 1, 0, {2, 4} },
+        { TC_SRC_MIN,      0, 45, 1, 0, {3, 4} },
+        { TC_SRC_ANNOUNCE, 1, 53, 1, 0, {1} },
+        { TC_SRC_DST,      1, 58, 1, 0, {1} },
+    },
+    .n_parity = 4,
+    .parity = { { 54, 1, 17, 24, 1 }, { 55, 1, 25, 35, 1 }, { 56, 1, 36, 38, 1 }, { 57, 1, 39, 51, 1 } },
+    .sym = { TC_ATT(100), TC_ATT(200), { 4, { { 0, Carrier_MOD }, { 100, Carrier }, { 200, Carrier_MOD }, { 300, Carrier } } },
+             TC_ATT(300), TC_ATT(500) },
+};
+
+/*
+WWVB (60kHz, Fort Collins), amplitude code only: power reduced for 200/500/800ms for '0'/'1'/marker,
+markers every 10 seconds. Current UTC minute, day of year, DUT1 sent as +0.0, leap year and leap second
+warning, DST bits 57/58 = DST at 24:00/00:00 UTC of the current day.
+*/
+const tc_proto_t tc_wwvb = {
+    .name = "wwvb", .carrier_hz = 60000.0,
+    .zone = "America/Denver", .std_offset = -7 * 3600, .dst_start = &us_start, .dst_end = &us_end,
+    .utc_fields = 1,
+    .const_a = TC_BIT(36) | TC_BIT(38),
+    .markers = TC_MARKERS_10S,
+    .n_fields = 8,
+    .field = {
+        { TC_SRC_MIN,       0, 1,  1, 1, {3, 4} },
+        { TC_SRC_HOUR,      0, 12, 1, 1, {2, 4} },
+        { TC_SRC_YDAY,      0, 22, 1, 1, {2, 4, 4} },
+        { TC_SRC_YEAR,      0, 45, 1, 1, {4, 4} },
+        { TC_SRC_LEAP_YEAR, 0, 55, 1, 0, {1} },
+        { TC_SRC_LEAP_DAY,  0, 56, 1, 0, {1} },
+        { TC_SRC_DST_DAY1,  0, 57, 1, 0, {1} },
+        { TC_SRC_DST_DAY0,  0, 58, 1, 0, {1} },
+    },
+    .sym = { TC_ATT(200), TC_ATT(500), TC_ATT(200), TC_ATT(500), TC_ATT(800) },
+};
+
+/*
+JJY (40kHz Fukushima, 60kHz Kyushu): inverted pulses, full carrier for 800/500/200ms for '0'/'1'/marker.
+Current JST minute, same time and day of year layout as WWVB, PA1/PA2 even parity of hour/minute,
+year, weekday and leap second bits. The call sign variant of minutes 15 and 45 is not sent.
+*/
+#define TC_JJY(id, hz) { \
+    .name = id, .carrier_hz = hz, \
+    .zone = "Asia/Tokyo", .std_offset = 9 * 3600, \
+    .markers = TC_MARKERS_10S, \
+    .n_fields = 7, \
+    .field = { \
+        { TC_SRC_MIN,      0, 1,  1, 1, {3, 4} }, \
+        { TC_SRC_HOUR,     0, 12, 1, 1, {2, 4} }, \
+        { TC_SRC_YDAY,     0, 22, 1, 1, {2, 4, 4} }, \
+        { TC_SRC_YEAR,     0, 41, 1, 0, {4, 4} }, \
+        { TC_SRC_WDAY0,    0, 50, 1, 0, {3} }, \
+        { TC_SRC_LEAP_DAY, 0, 53, 1, 0, {1} }, \
+        { TC_SRC_LEAP_DAY, 0, 54, 1, 0, {1} }, \
+    }, \
+    .n_parity = 2, \
+    .parity = { { 36, 0, 12, 18, 0 }, { 37, 0, 1, 8, 0 } }, \
+    .sym = { TC_FULL(800), TC_FULL(500), TC_FULL(800), TC_FULL(500), TC_FULL(200) }, \
+}
+
+const tc_proto_t tc_jjy = TC_JJY("jjy", 40000.0);
+const tc_proto_t tc_jjy60 = TC_JJY("jjy60", 60000.0);
+
+static const tc_proto_t *const tc_all[] = { &tc_dcf77, &tc_msf, &tc_wwvb, &tc_jjy, &tc_jjy60 };
+
+// Transmitted protocol, set once at startup and only read afterwards
+static const tc_proto_t *tx_proto = &tc_dcf77;
+
+void tc_set_proto(const tc_proto_t *p){ tx_proto = p; }
+const tc_proto_t *tc_proto(void){ return tx_proto; }
+
+const tc_proto_t *tc_find(const char *name){
+    for (size_t i = 0; i < sizeof(tc_all) / sizeof(tc_all[0]); ++i) {
+        if (strcmp(tc_all[i]->name, name) == 0) return tc_all[i];
+    }
+    return NULL;
+}
+
+static inline unsigned to_bcd(unsigned v){ return v % 10 | (v / 10 % 10) << 4 | (v / 100 % 10) << 8; }
+
+static uint64_t field_bits(const tc_field_t *f, unsigned bcd){
+    int nd = 0;
+    while (nd < 3 && f->width[nd]) nd++;
+
+    uint64_t bits = 0;
+    unsigned pos = f->pos;
+    for (int j = 0; j < nd; ++j) {
+        const unsigned w = f->width[j];
+        const unsigned digit = bcd >> (4 * (f->msb_first ? nd - 1 - j : j)) & 0xf;
+        for (unsigned k = 0; k < w; ++k, ++pos) bits |= (uint64_t)(digit >> (f->msb_first ? w - 1 - k : k) & 1) << pos;
+        pos += f->gap;
+    }
+    return bits;
+}
+
+tc_frame_t tc_encode(const tc_proto_t *p, time_t t_min, const struct tz_cache *tz, uint8_t ntp_leap){
+    const time_t t = t_min + (p->next_minute ? 60 : 0);
+    tz_local_t lt;
+    tz_localtime(p->utc_fields ? NULL : tz, t, &lt);
+    const tz_info_t zi = p->utc_fields ? tz_lookup(tz, t) : lt.info;
+
+    // Leap seconds follow UTC days, whatever the transmitted zone
+    const int64_t tod = ((int64_t)t_min % 86400 + 86400) % 86400;
+    const int64_t day0 = (int64_t)t - (((int64_t)t % 86400 + 86400) % 86400);
+    const unsigned leap_day = ntp_leap == 1;
+
+    unsigned v[TC_SRC_COUNT];
+    v[TC_SRC_MIN] = (unsigned)lt.min;
+    v[TC_SRC_HOUR] = (unsigned)lt.hour;
+    v[TC_SRC_MDAY] = (unsigned)lt.mday;
+    v[TC_SRC_MON] = (unsigned)lt.mon;
+    v[TC_SRC_YEAR] = (unsigned)(lt.year % 100);
+    v[TC_SRC_WDAY] = (unsigned)lt.wday;
+    v[TC_SRC_WDAY0] = (unsigned)(lt.wday % 7);
+    v[TC_SRC_YDAY] = (unsigned)lt.yday;
+    v[TC_SRC_DST] = zi.is_dst;
+    v[TC_SRC_STD] = zi.is_dst ^ 1;
+    v[TC_SRC_ANNOUNCE] = zi.announce;
+    v[TC_SRC_LEAP_HOUR] = leap_day && tod >= 86400 - 3600;
+    v[TC_SRC_LEAP_DAY] = leap_day;
+    v[TC_SRC_DST_DAY0] = tz_lookup(tz, (time_t)day0).is_dst;
+    v[TC_SRC_DST_DAY1] = tz_lookup(tz, (time_t)(day0 + 86400)).is_dst;
+    v[TC_SRC_LEAP_YEAR] = lt.year % 4 == 0 && (lt.year % 100 != 0 || lt.year % 400 == 0);
+
+    tc_frame_t f = { p->const_a, p->const_b };
+    for (int i = 0; i < p->n_fields; ++i) {
+        const tc_field_t *fl = &p->field[i];
+        const uint64_t bits = field_bits(fl, to_bcd(v[fl->src]));
+        if (fl->chan) f.b |= bits;
+        else f.a |= bits;
+    }
+    for (int i = 0; i < p->n_parity; ++i) {
+        const tc_parity_t *pr = &p->parity[i];
+        const uint64_t mask = ((1ULL << (pr->to + 1)) - 1) & ~((1ULL << pr->from) - 1);
+        const uint64_t bit = (uint64_t)((__builtin_popcountll(f.a & mask) & 1) ^ pr->odd) << pr->sec;
+        if (pr->chan) f.b |= bit;
+        else f.a |= bit;
+    }
+
+    if (p->leap_insert && leap_day && tod == 86400 - 60) f.a |= TC_LEAP_MINUTE; // Sent during 23:59 UTC
+    return f;
+}
+
+int tc_decode(const tc_proto_t *p, const tc_frame_t *f, unsigned v[TC_SRC_COUNT]){
+    for (int i = 0; i < TC_SRC_COUNT; ++i) v[i] = 0;
+    for (int i = 0; i < p->n_fields; ++i) {
+        const tc_field_t *fl = &p->field[i];
+        const uint64_t bits = fl->chan ? f->b : f->a;
+        int nd = 0;
+        while (nd < 3 && fl->width[nd]) nd++;
+
+        // field_bits() backwards: digits in transmission order, each w bits wide
+        unsigned val = 0, scale = 1, pos = fl->pos;
+        unsigned digit[3];
+        for (int j = 0; j < nd; ++j) {
+            const unsigned w = fl->width[j];
+            digit[j] = 0;
+            for (unsigned k = 0; k < w; ++k, ++pos) digit[j] |= (unsigned)(bits >> pos & 1) << (fl->msb_first ? w - 1 - k : k);
+            pos += fl->gap;
+        }
+        for (int j = 0; j < nd; ++j, scale *= 10) val += digit[fl->msb_first ? nd - 1 - j : j] * scale;
+        v[fl->src] = val;
+    }
+    for (int i = 0; i < p->n_parity; ++i) {
+        const tc_parity_t *pr = &p->parity[i];
+        const uint64_t mask = ((1ULL << (pr->to + 1)) - 1) & ~((1ULL << pr->from) - 1);
+        const unsigned want = (unsigned)((__builtin_popcountll(f->a & mask) & 1) ^ pr->odd);
+        if ((unsigned)((pr->chan ? f->b : f->a) >> pr->sec & 1) != want) return -1;
+    }
+    return 1;
+}
+
+int tc_seconds(const tc_frame_t *f){ return (f->a & TC_LEAP_MINUTE) ? 61 : 60; }
+
+const tc_symbol_t *tc_symbol(const tc_proto_t *p, const tc_frame_t *f, int sec){
+    if (f->a & TC_LEAP_MINUTE) {
+        if (sec == 59) return &p->sym[0];
+        if (sec == 60) sec = 59;
+    }
+    if (p->markers & TC_BIT(sec)) return &p->sym[TC_SYM_MARK];
+    return &p->sym[(f->a >> sec & 1) | (f->b >> sec & 1) << 1];
+}
+
+int tc_att_from_start(const tc_proto_t *p){
+    for (int i = 0; i <= TC_SYM_MARK; ++i) {
+        const tc_symbol_t *s = &p->sym[i];
+        if (s->n == 0) continue;
+        if (s->n != 2 || s->seg[0].ms != 0 || s->seg[0].state != Carrier_MOD || s->seg[1].state != Carrier) return 0;
+    }
+    return 1;
+}
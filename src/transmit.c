@@ -0,0 +1,295 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hw_conf.h"
+#include "tx_backend.h"
+#include "rt_metrics.h"
+#include "rt_profile.h"
+#include "schedule.h"
+#include "modulator.h"
+#include "tx_clock.h"
+#include "discipline.h"
+#include "net_ntp.h"
+#include "args.h"
+#include "dcf77.h"
+#include "timecode.h"
+#include "flight_rec.h"
+#include "tx_log.h"
+
+void clk_delay(struct timespec tm) {
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &tm, NULL) == EINTR) { tx_log_msg("Interrupted clk sleep"); }
+}
+
+static int64_t mono_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return tx_ts_ns(&ts);
+}
+
+// Apply one attenuator edge and record its wake-up lateness and cost; returns when it was applied
+static int64_t edge_send(tx_backend_t *be, tx_clock_t *clk, rt_metrics_t *m, int ch, uint8_t state, const struct timespec *deadline){
+    const int64_t woke = tx_clock_ns(clk);
+    const int64_t t0 = mono_ns();
+    be->att_set(be, ch, state, deadline);
+    const int64_t cost = mono_ns() - t0;
+    rt_metrics_edge(m, woke - tx_ts_ns(deadline), cost);
+    return woke + cost;
+}
+
+// SCHED_OTHER helper thread: main() runs SCHED_FIFO 99 and must not hand that down implicitly
+int thread_create_low(pthread_t *tid, void *(*fn)(void *), void *arg){
+    pthread_attr_t attr;
+    struct sched_param param = { .sched_priority = 0 };
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    int rc = pthread_create(tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+void tx_backend_free(tx_backend_t *be){
+    if (be && be->destroy) be->destroy(be);
+}
+
+void run_event(parser_t *t_args, int ev){
+    const uint64_t one = 1;
+    atomic_fetch_or_explicit(t_args->events, ev, memory_order_release);
+    if (write(t_args->evfd, &one, sizeof(one)) < 0) { /* Counter saturated: main() is awake anyway */ }
+}
+
+static void signal_exit(parser_t *t_args){
+    run_event(t_args, RUN_EV_DONE);
+}
+
+int carrier_setup(void *args) {
+    parser_t* t_args = (parser_t *)args;
+    tx_backend_t *be = t_args->backend;
+    for (int c = 0; c < t_args->n_chan; c++) {
+        const tx_chan_t *ch = &t_args->chan[c];
+        int from_table;
+        clk_vals_t clock_settings = carrier_plan(CLOCK_FREQ, ch->proto->carrier_hz, &from_table);
+        if (t_args->verbose) {
+            const tx_log_rec_t r = { .ev = TX_LOG_CARRIER, .i = c, .a = { ch->carrier_pin, (int64_t)(ch->proto->carrier_hz * 1e3 + 0.5) } };
+            tx_log_push(&r);
+        }
+
+        // The state machine runs on its own from here: no thread needs to stay behind for it
+        if (be->carrier_start(be, c, ch->carrier_pin, &clock_settings) < 0) {
+            while (--c >= 0) be->carrier_stop(be, c);
+            return -1;
+        }
+    }
+    atomic_store_explicit(&t_args->carrier_on, 1, memory_order_relaxed);
+    return 1;
+}
+
+void carrier_shutdown(void *args) {
+    parser_t* t_args = (parser_t *)args;
+    if (!atomic_exchange_explicit(&t_args->carrier_on, 0, memory_order_relaxed)) return;
+    for (int c = 0; c < t_args->n_chan; c++) t_args->backend->carrier_stop(t_args->backend, c);
+}
+
+// Outside every transmit window: carrier off from the minute boundary, back on a second before a minute that sends
+static void idle_minute(parser_t *t_args, const tx_minute_t *block){
+    tx_clock_t *clk = t_args->clock;
+    if (atomic_load_explicit(&t_args->carrier_on, memory_order_relaxed)) {
+        const struct timespec at = { .tv_sec = block->minute_start, .tv_nsec = 0 };
+        clk->sleep_until(clk, &at);
+        if (!atomic_load_explicit(t_args->stop_thread, memory_order_acquire)) carrier_shutdown(t_args);
+    }
+    if (t_args->verbose) tx_log_ev(TX_LOG_IDLE, 0, block->minute_start);
+    const struct timespec wake = { .tv_sec = block->minute_start + 59, .tv_nsec = 0 };
+    clk->sleep_until(clk, &wake);
+}
+
+// A receiver decodes a frame once the minute mark after it arrives: that is when the first complete one counts
+static void first_frame(parser_t *t_args, const tx_minute_t *block, int64_t join_ns){
+    const int64_t ns = ((int64_t)block->minute_start + 60) * 1000000000LL - join_ns;
+    atomic_store_explicit(&t_args->metrics->first_frame_ns, ns, memory_order_relaxed);
+    if (t_args->verbose) tx_log_ev(TX_LOG_FIRST_FRAME, 0, ns);
+}
+
+// CPU modulator: sleep to every edge deadline and flip the attenuator
+static void edge_loop(parser_t *t_args, tx_sched_t *sched, int64_t join_ns){
+    tx_backend_t *be = t_args->backend;
+    rt_metrics_t *m = t_args->metrics;
+    tx_clock_t *clk = t_args->clock;
+    int64_t resume_ns = INT64_MIN; // Edges before this are not sent, set by the first minute on air
+    int complete = 0;
+
+    const tx_minute_t *block;
+    while ((block = sched_next(sched)) && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire)) {
+        if (t_args->live) atomic_store_explicit(&t_args->live->on_air, block->minute_start, memory_order_relaxed);
+        if (block->idle) {
+            idle_minute(t_args, block);
+            sched_release(sched);
+            continue;
+        }
+        if (!atomic_load_explicit(&t_args->carrier_on, memory_order_relaxed) && carrier_setup(t_args) < 0) {
+            tx_log_msg("Carrier restart failed");
+            sched_release(sched);
+            break;
+        }
+        if (resume_ns == INT64_MIN) {
+            // Joining mid-minute: the seconds already under way stay unmodulated, transmission starts at the next whole second
+            struct timespec now;
+            clk->now(clk, &now);
+            resume_ns = (tx_ts_ns(&now) + 999999999LL) / 1000000000LL * 1000000000LL;
+            if (resume_ns > (int64_t)block->minute_start * 1000000000LL) {
+                for (int c = 0; c < t_args->n_chan; c++) be->att_set(be, c, Carrier, &now);
+            }
+        }
+        if (t_args->verbose) tx_log_ev(TX_LOG_MINUTE, 0, block->minute_start);
+
+        int skipped = 0;
+        for (int i = 0; i < block->n_edges && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire); i++) {
+            const tx_edge_t *edge = &block->edge[i];
+            if (tx_ts_ns(&edge->at) < resume_ns) { skipped = 1; continue; }
+            clk->sleep_until(clk, &edge->at);
+            if (atomic_load_explicit(t_args->stop_thread, memory_order_acquire)) break; // Woken early to stop: no early edge
+
+            if (t_args->verbose && edge->chan == 0 && edge->state == Carrier_MOD) tx_log_ev(TX_LOG_SECOND, edge->sec, 0);
+
+            const int64_t applied = edge_send(be, clk, m, edge->chan, edge->state, &edge->at);
+            // After the edge, off its timing path
+            if (t_args->rec) fr_record(t_args->rec, tx_ts_ns(&edge->at), applied, block->frame[edge->chan], block->frame_b[edge->chan], edge->sec, edge->state, edge->chan);
+        }
+        const int done = !skipped && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire);
+        if (done) rt_metrics_frame(m);
+        sched_release(sched);
+        if (t_args->verbose) tx_log_ev(TX_LOG_EOL, 0, 0);
+        if (done && !complete++) first_frame(t_args, block, join_ns);
+    }
+}
+
+// PIO modulator: the state machine times every edge, this thread only keeps its FIFO topped up
+static void mod_loop(parser_t *t_args, tx_sched_t *sched, int64_t join_ns){
+    tx_backend_t *be = t_args->backend;
+    rt_metrics_t *m = t_args->metrics;
+    tx_clock_t *clk = t_args->clock;
+    uint32_t words[MOD_MAX_SECONDS];
+    time_t due[MOD_MAX_SECONDS];
+    mod_trim_t trim;
+    int32_t trim_ticks = 0;
+    int started = 0, drain = 1, complete = 0;
+
+    if (be->mod_start(be, t_args->chan[0].att_pin) < 0) {
+        tx_log_errno("PIO modulator init failed", errno);
+        return;
+    }
+    mod_trim_reset(&trim);
+
+    const tx_minute_t *block;
+    while (drain && (block = sched_next(sched)) && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire)) {
+        if (t_args->live) atomic_store_explicit(&t_args->live->on_air, block->minute_start, memory_order_relaxed);
+        const int n = mod_compile_minute(block, trim_ticks, words, due);
+        if (t_args->verbose) tx_log_ev(TX_LOG_MINUTE, 0, block->minute_start);
+        int e = 0, skipped = 0;
+
+        for (int s = 0; s < n && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire); s++) {
+            const struct timespec at = { .tv_sec = due[s], .tv_nsec = 0 };
+            // Seconds already under way, or too close to align the first word to, are skipped
+            if (!started && tx_ts_ns(&at) < tx_clock_ns(clk) + MOD_PREROLL_NS) { skipped = 1; continue; }
+
+            int64_t phase;
+            if (be->mod_push(be, words[s], &at, &phase) < 0) { drain = 0; break; }
+            started = 1;
+            // The state machine times these edges: recorded as pushed, with no applied time
+            while (t_args->rec && e < block->n_edges && block->edge[e].sec <= s) {
+                const tx_edge_t *edge = &block->edge[e++];
+                if (edge->sec == s) fr_record(t_args->rec, tx_ts_ns(&edge->at), 0, block->frame[0], block->frame_b[0], edge->sec, edge->state, 0);
+            }
+            if (phase != INT64_MIN) {
+                mod_trim_observe(&trim, phase);
+                rt_hist_observe(&m->lateness, phase);
+            }
+            if (t_args->verbose) tx_log_ev(TX_LOG_SECOND, s < 60 ? s : 60, 0);
+        }
+        trim_ticks = mod_trim_take(&trim);
+        if (t_args->verbose && trim_ticks) tx_log_ev(TX_LOG_TRIM, trim_ticks, 0);
+        const int done = drain && !skipped && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire);
+        if (done) rt_metrics_frame(m);
+        sched_release(sched);
+        if (t_args->verbose) tx_log_ev(TX_LOG_EOL, 0, 0);
+        if (done && !complete++) first_frame(t_args, block, join_ns);
+    }
+    be->mod_stop(be, drain && !atomic_load_explicit(t_args->stop_thread, memory_order_acquire));
+}
+
+static void att_close_all(parser_t *t_args){
+    if (t_args->mod_sel != MOD_CPU) return;
+    for (int c = 0; c < t_args->n_chan; c++) t_args->backend->att_close(t_args->backend, c);
+}
+
+void* data_tx(void *args){
+    parser_t* t_args = (parser_t *)args;
+    const rt_profile_t *rt = t_args->rt;
+    rt_thread_setup(rt_profile_edge_core(rt), rt->tx_prio, rt->slack_ns); // Already checked by main(): failures are reported only
+    tx_log_bind(); // Nothing below formats or writes a message itself
+
+    tx_backend_t *be = t_args->backend;
+    tx_clock_t *clk = t_args->clock;
+    const int64_t join_ns = tx_clock_ns(clk);
+    if (t_args->mod_sel == MOD_CPU) {
+        for (int c = 0; c < t_args->n_chan; c++) be->att_open(be, c, t_args->chan[c].att_pin);
+    }
+
+    int timeout =  (t_args->t_lim > 0) ? t_args->t_lim : 960; //Default timeout after 16hrs -> 960 mins
+    if (t_args->daemon) timeout = -1;
+    
+    time_t start_transm;
+    uint8_t leap;
+    const uint8_t t_src = atomic_load_explicit(&t_args->t_src, memory_order_relaxed);
+    
+    if (!t_src){ struct timespec now; clk->now(clk, &now); start_transm = now.tv_sec; leap = 0;}
+    if (t_src && t_args->disc){
+        // The clock already follows the time source
+        struct timespec now; clk->now(clk, &now); start_transm = now.tv_sec;
+        leap = atomic_load_explicit(&t_args->disc->leap, memory_order_relaxed);
+    }
+    else if (t_src){
+        ret_ntp sync;
+        if (ntp_get(t_args->ntp_servers, NTP_TIMEOUT_MS, &sync) > 0) {
+            start_transm = sync.time_data;
+            leap = sync.leap_sec;
+            if (t_args->verbose) {
+                tx_log_rec_t r = { .ev = TX_LOG_NTP, .i = sync.servers_ok, .a = { sync.offset_ns, sync.delay_ns, sync.root_dist_ns } };
+                snprintf(r.s, sizeof(r.s), "%.*s", (int)sizeof(r.s) - 1, sync.server); // Truncated to fit the record
+                tx_log_push(&r);
+            }
+        } else {
+            // Better late-labelled frames from the local clock than no transmitter at all
+            tx_log_ev(TX_LOG_NTP, 0, NTP_TIMEOUT_MS);
+            struct timespec now; clk->now(clk, &now); start_transm = now.tv_sec; leap = 0;
+        }
+    }
+    start_transm -= start_transm % 60; //Round down to the minute; channel offsets only shift the encoded time
+
+    // Encoding happens ahead of time on a low priority thread: this loop only sleeps and flips the pin
+    tx_sched_t *sched = malloc(sizeof(*sched));
+    if (!sched || sched_start(sched, t_args->chan, t_args->n_chan, t_args->live, start_transm, timeout, leap,
+                                 (t_src && t_args->disc) ? &t_args->disc->leap : NULL, t_args->stop_thread) < 0) {
+        tx_log_errno("Schedule init failed", errno);
+        free(sched);
+        att_close_all(t_args);
+        signal_exit(t_args);
+        return NULL;
+    }
+
+    if (t_args->mod_sel == MOD_PIO) mod_loop(t_args, sched, join_ns);
+    else edge_loop(t_args, sched, join_ns);
+
+    sched_stop(sched);
+    free(sched);
+
+    att_close_all(t_args);
+    
+    signal_exit(t_args);
+    return NULL;
+}
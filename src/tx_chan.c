@@ -0,0 +1,46 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_chan.h"
+#include "timecode.h"
+#include "parse_num.h"
+
+#define GPIO_MAX 27 // RP1 bank 0, the pins PIO can drive; the rest are internal
+
+int tx_chan_parse(tx_chan_t *c, const char *spec){
+    char line[256];
+    if (strlen(spec) >= sizeof(line)) {
+        fprintf(stderr, "Error: channel spec too long\n");
+        return -1;
+    }
+    strcpy(line, spec);
+
+    char *save = NULL;
+    for (char *kv = strtok_r(line, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) {
+            fprintf(stderr, "Error: channel entry '%s' is not key=value\n", kv);
+            return -1;
+        }
+        *val++ = '\0';
+
+        long long v;
+        int rc = -1;
+        if      (!strcmp(kv, "carrier")) { if ((rc = parse_ll(val, 0, GPIO_MAX, &v)) == 0) c->carrier_pin = (unsigned int)v; }
+        else if (!strcmp(kv, "att"))     { if ((rc = parse_ll(val, 0, GPIO_MAX, &v)) == 0) c->att_pin = (unsigned int)v; }
+        else if (!strcmp(kv, "offset"))  { if ((rc = parse_ll(val, -525600, 525600, &v)) == 0) { c->t_toff = (int)v; c->have_toff = 1; } }
+        else if (!strcmp(kv, "zone"))    { rc = (*val && strlen(val) < sizeof(c->zone)) ? 0 : -1; if (rc == 0) strcpy(c->zone, val); }
+        else if (!strcmp(kv, "proto"))   { rc = (c->proto = tc_find(val)) ? 0 : -1; }
+        else {
+            fprintf(stderr, "Error: unknown channel key '%s' (carrier, att, offset, zone, proto)\n", kv);
+            return -1;
+        }
+        if (rc < 0) {
+            fprintf(stderr, "Error: invalid channel value %s=%s\n", kv, val);
+            return -1;
+        }
+    }
+    return 0;
+}
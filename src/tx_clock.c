@@ -0,0 +1,239 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "tx_clock.h"
+#include "discipline.h"
+#include "tx_log.h"
+#include "rt_metrics.h"
+
+static int aborted(tx_clock_t *clk){
+    return clk->abort && atomic_load_explicit(clk->abort, memory_order_acquire);
+}
+
+// Timer, wake eventfd and the epoll set the sleeper waits in; -1 with everything closed on failure
+static int fds_open(tx_clock_t *clk, clockid_t id){
+    clk->timer_fd = timerfd_create(id, TFD_CLOEXEC | TFD_NONBLOCK);
+    clk->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    clk->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (clk->timer_fd < 0 || clk->wake_fd < 0 || clk->epoll_fd < 0) {
+        perror("Clock: timerfd/eventfd/epoll");
+        tx_clock_close(clk);
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = clk->timer_fd };
+    int rc = epoll_ctl(clk->epoll_fd, EPOLL_CTL_ADD, clk->timer_fd, &ev);
+    ev.data.fd = clk->wake_fd;
+    if (rc == 0) rc = epoll_ctl(clk->epoll_fd, EPOLL_CTL_ADD, clk->wake_fd, &ev);
+    if (rc < 0) {
+        perror("Clock: epoll_ctl");
+        tx_clock_close(clk);
+        return -1;
+    }
+    return 1;
+}
+
+void tx_clock_close(tx_clock_t *clk){
+    if (clk->timer_fd >= 0) close(clk->timer_fd);
+    if (clk->wake_fd >= 0) close(clk->wake_fd);
+    if (clk->epoll_fd >= 0) close(clk->epoll_fd);
+    clk->timer_fd = clk->wake_fd = clk->epoll_fd = -1;
+}
+
+void tx_clock_wake(tx_clock_t *clk){
+    const uint64_t one = 1;
+    if (clk->wake_fd >= 0 && write(clk->wake_fd, &one, sizeof(one)) < 0) { /* Counter saturated: already awake */ }
+}
+
+void tx_clock_drain(tx_clock_t *clk){
+    uint64_t cnt;
+    if (clk->wake_fd >= 0 && read(clk->wake_fd, &cnt, sizeof(cnt)) < 0) { /* EAGAIN: nothing pending */ }
+}
+
+// Absolute timer on the clock's timerfd; 1 when it fired, 0 when woken to abort.
+// A realtime timer is cancelled when the clock is set: re-armed, the same deadline is then in the new timebase.
+static int fd_sleep(tx_clock_t *clk, const struct timespec *at, int flags){
+    const struct itimerspec its = { .it_value = *at };
+    if (!at->tv_sec && !at->tv_nsec) return 1; // Zero would disarm: long past anyway
+    for (;;) {
+        if (timerfd_settime(clk->timer_fd, TFD_TIMER_ABSTIME | flags, &its, NULL) < 0) {
+            tx_log_errno("Clock: timerfd_settime", errno);
+            return 1;
+        }
+        for (;;) {
+            struct epoll_event ev[2];
+            const int n = epoll_wait(clk->epoll_fd, ev, 2, -1);
+            if (n < 0 && errno != EINTR) {
+                tx_log_errno("Clock: epoll_wait", errno);
+                return 1;
+            }
+            int fired = 0, cancelled = 0;
+            for (int i = 0; i < n; i++) {
+                if (ev[i].data.fd == clk->wake_fd) {
+                    if (aborted(clk)) return 0;
+                    tx_clock_drain(clk); // Nothing to stop for: a leftover wake
+                    continue;
+                }
+                uint64_t exp;
+                if (read(clk->timer_fd, &exp, sizeof(exp)) == (ssize_t)sizeof(exp)) fired = 1;
+                else if (errno == ECANCELED) cancelled = 1;
+            }
+            if (fired) return 1;
+            if (cancelled) break;
+        }
+    }
+}
+
+static void rt_now(tx_clock_t *clk, struct timespec *ts){
+    (void)clk;
+    clock_gettime(CLOCK_REALTIME, ts);
+}
+
+static void rt_sleep_until(tx_clock_t *clk, const struct timespec *deadline){
+    fd_sleep(clk, deadline, TFD_TIMER_CANCEL_ON_SET);
+}
+
+int tx_clock_realtime_init(tx_clock_t *clk){
+    clk->name = "realtime";
+    clk->now = rt_now;
+    clk->sleep_until = rt_sleep_until;
+    clk->abort = NULL;
+    clk->disc = NULL;
+    clk->spin = NULL;
+    atomic_store_explicit(&clk->virt_ns, 0, memory_order_relaxed);
+    return fds_open(clk, CLOCK_REALTIME);
+}
+
+static void virt_now(tx_clock_t *clk, struct timespec *ts){
+    const int64_t ns = atomic_load_explicit(&clk->virt_ns, memory_order_acquire);
+    ts->tv_sec = (time_t)(ns / 1000000000LL);
+    ts->tv_nsec = (long)(ns % 1000000000LL);
+}
+
+// Never goes backwards: a deadline in the past returns at once, like clock_nanosleep does
+static void virt_sleep_until(tx_clock_t *clk, const struct timespec *deadline){
+    const int64_t target = tx_ts_ns(deadline);
+    int64_t cur = atomic_load_explicit(&clk->virt_ns, memory_order_relaxed);
+    while (cur < target && !atomic_compare_exchange_weak_explicit(&clk->virt_ns, &cur, target, memory_order_release, memory_order_relaxed));
+}
+
+void tx_clock_virtual_init(tx_clock_t *clk, time_t start){
+    clk->name = "virtual";
+    clk->now = virt_now;
+    clk->sleep_until = virt_sleep_until;
+    clk->abort = NULL;
+    clk->disc = NULL;
+    clk->spin = NULL;
+    clk->timer_fd = clk->wake_fd = clk->epoll_fd = -1; // Never blocks
+    atomic_store_explicit(&clk->virt_ns, (int64_t)start * 1000000000LL, memory_order_release);
+}
+
+static int64_t mono_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return tx_ts_ns(&ts);
+}
+
+static void disc_now(tx_clock_t *clk, struct timespec *ts){
+    const int64_t ns = tx_disc_utc(clk->disc, mono_ns());
+    ts->tv_sec = (time_t)(ns / 1000000000LL);
+    ts->tv_nsec = (long)(ns % 1000000000LL);
+}
+
+// The mapping may be re-anchored while we sleep: wake-ups short of the deadline sleep again
+static void disc_sleep_until(tx_clock_t *clk, const struct timespec *deadline){
+    const int64_t target = tx_ts_ns(deadline);
+    for (;;) {
+        const int64_t m = tx_disc_mono(clk->disc, target);
+        const struct timespec ts = { .tv_sec = (time_t)(m / 1000000000LL), .tv_nsec = (long)(m % 1000000000LL) };
+        if (!fd_sleep(clk, &ts, 0)) return;
+        if (tx_disc_utc(clk->disc, mono_ns()) >= target) return;
+    }
+}
+
+int tx_clock_disciplined_init(tx_clock_t *clk, struct tx_disc *disc){
+    clk->name = "disciplined";
+    clk->now = disc_now;
+    clk->sleep_until = disc_sleep_until;
+    clk->abort = NULL;
+    clk->disc = disc;
+    clk->spin = NULL;
+    atomic_store_explicit(&clk->virt_ns, 0, memory_order_relaxed);
+    return fds_open(clk, CLOCK_MONOTONIC);
+}
+
+static inline void cpu_relax(void){
+#if defined(__aarch64__) || defined(__arm__)
+    __asm__ volatile("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static int64_t clamp_margin(int64_t ns){
+    return ns < TX_SPIN_MIN_NS ? TX_SPIN_MIN_NS : ns > TX_SPIN_MAX_NS ? TX_SPIN_MAX_NS : ns;
+}
+
+static void spin_set_margin(tx_spin_t *sp, int64_t ns){
+    sp->margin_ns = clamp_margin(ns);
+    if (sp->m) atomic_store_explicit(&sp->m->spin_margin_ns, sp->margin_ns, memory_order_relaxed);
+}
+
+// One wake-up of the coarse sleep, late_ns after the time it asked for
+static void spin_observe(tx_spin_t *sp, int64_t late_ns){
+    if (!sp->adaptive) return;
+    if (late_ns < 0) late_ns = 0;
+    // Past the deadline: no waiting for the window
+    if (late_ns > sp->margin_ns) spin_set_margin(sp, late_ns + TX_SPIN_GUARD_NS);
+
+    const int64_t b = late_ns / TX_SPIN_BUCKET_NS;
+    sp->hist[b < TX_SPIN_BUCKETS ? b : TX_SPIN_BUCKETS - 1]++;
+    if (++sp->n < TX_SPIN_WINDOW) return;
+
+    const uint32_t p99 = (TX_SPIN_WINDOW * 99 + 99) / 100;
+    uint32_t seen = 0;
+    int i = 0;
+    while (i < TX_SPIN_BUCKETS - 1 && (seen += sp->hist[i]) < p99) i++;
+    spin_set_margin(sp, (i + 1) * TX_SPIN_BUCKET_NS + TX_SPIN_GUARD_NS);
+    memset(sp->hist, 0, sizeof(sp->hist));
+    sp->n = 0;
+}
+
+static void spin_sleep_until(tx_clock_t *clk, const struct timespec *deadline){
+    tx_spin_t *sp = clk->spin;
+    const int64_t target = tx_ts_ns(deadline);
+    const int64_t wake = target - sp->margin_ns;
+    int64_t now = tx_clock_ns(clk);
+
+    // A deadline already within the margin (or past) tells nothing about the sleep: spin only
+    const int slept = now < wake;
+    if (slept) {
+        const struct timespec ts = { .tv_sec = (time_t)(wake / 1000000000LL), .tv_nsec = (long)(wake % 1000000000LL) };
+        sp->coarse(clk, &ts);
+        if (aborted(clk)) return;
+        now = tx_clock_ns(clk);
+        spin_observe(sp, now - wake);
+    }
+
+    const int64_t t0 = now;
+    while (now < target) {
+        cpu_relax();
+        if (clk->abort && atomic_load_explicit(clk->abort, memory_order_relaxed)) break;
+        now = tx_clock_ns(clk);
+    }
+    if (!sp->m) return;
+    atomic_fetch_add_explicit(&sp->m->spin_ns, (uint64_t)(now - t0), memory_order_relaxed);
+    atomic_fetch_add_explicit(&sp->m->spin_waits, 1, memory_order_relaxed);
+    if (slept && t0 > target) atomic_fetch_add_explicit(&sp->m->spin_overshoots, 1, memory_order_relaxed);
+}
+
+void tx_clock_spin_init(tx_clock_t *clk, tx_spin_t *sp, int64_t margin_ns, int64_t init_ns, struct rt_metrics *m){
+    *sp = (tx_spin_t){ .coarse = clk->sleep_until, .adaptive = margin_ns == 0, .started_ns = mono_ns(), .m = m };
+    spin_set_margin(sp, margin_ns ? margin_ns : init_ns ? init_ns + TX_SPIN_GUARD_NS : TX_SPIN_INIT_NS);
+    clk->spin = sp;
+    clk->sleep_until = spin_sleep_until;
+}
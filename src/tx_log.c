@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "tx_log.h"
+#include "hw_conf.h"
+#include "rt_metrics.h"
+
+#define RING_MASK (TX_LOG_RECORDS - 1)
+
+// One producer (the bound thread), one consumer (the writer): head and tail only ever move forward
+static tx_log_rec_t ring[TX_LOG_RECORDS];
+static _Atomic uint64_t head;
+static _Atomic uint64_t tail;
+static _Atomic uint64_t dropped;
+static atomic_bool running;
+static atomic_bool stopping;
+static pthread_t writer_tid;
+static rt_metrics_t *drop_metrics;
+static _Thread_local uint8_t bound;
+
+static void local_time(char *buf, size_t len, int64_t t){
+    const time_t tt = (time_t)t;
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+// Returns 0 for an event it does not know (nothing written)
+static int format_rec(FILE *out, const tx_log_rec_t *r){
+    char buf[32];
+    switch (r->ev) {
+        case TX_LOG_TEXT: fprintf(out, "%s\n", r->msg); break;
+        case TX_LOG_ERRNO: fprintf(out, "%s: %s\n", r->msg, strerror(r->i)); break;
+        case TX_LOG_MINUTE: local_time(buf, sizeof(buf), r->a[0]); fputs(buf, out); break;
+        case TX_LOG_SECOND: fprintf(out, "\b\b\b:%02d", r->i); break;
+        case TX_LOG_TRIM: fprintf(out, " trim %+d", r->i); break;
+        case TX_LOG_EOL: fputc('\n', out); break;
+        case TX_LOG_IDLE: local_time(buf, sizeof(buf), r->a[0]); fprintf(out, "%s idle\n", buf); break;
+        case TX_LOG_CARRIER: {
+            // Planned again here rather than carried: the planner is deterministic and the record stays small
+            int from_table;
+            const clk_vals_t c = carrier_plan(CLOCK_FREQ, r->a[1] / 1e3, &from_table);
+            fprintf(out, "Carrier config [%d]: GPIO=%lld Clock=%.0f MHz (%s plan)\nFrequency requested=%.6fHz (%+.1fppb) loops=%u/%u clkdiv=%u+%u/256 duty=%.3f%%\n",
+                    r->i, (long long)r->a[0], CLOCK_FREQ/1000000, from_table ? "precomputed" : "searched", c.f_actual, c.err_ppb,
+                    c.loops, c.loops_low, c.div_int, c.div_frac, c.duty * 100.0);
+            break;
+        }
+        case TX_LOG_FIRST_FRAME: fprintf(out, "First complete frame %.3fs after start\n", r->a[0] / 1e9); break;
+        case TX_LOG_NTP:
+            if (!r->i) { fprintf(out, "NTP: no server answered within %lldms, using the local clock\n", (long long)r->a[0]); break; }
+            fprintf(out, "NTP: %s offset %+.3fms delay %.3fms root distance %.3fms (%d server%s answered)\n", r->s,
+                    r->a[0] / 1e6, r->a[1] / 1e6, r->a[2] / 1e6, r->i, r->i == 1 ? "" : "s");
+            break;
+        default: return 0;
+    }
+    return 1;
+}
+
+static void drop(void){
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+    if (drop_metrics) atomic_fetch_add_explicit(&drop_metrics->log_dropped, 1, memory_order_relaxed);
+}
+
+void tx_log_push(const tx_log_rec_t *r){
+    if (!bound || !atomic_load_explicit(&running, memory_order_acquire)) {
+        format_rec(stderr, r);
+        return;
+    }
+    const uint64_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&tail, memory_order_acquire) >= TX_LOG_RECORDS) {
+        drop();
+        return;
+    }
+    ring[h & RING_MASK] = *r;
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+void tx_log_ev(tx_log_ev_t ev, int32_t i, int64_t a0){
+    const tx_log_rec_t r = { .ev = (uint16_t)ev, .i = i, .a = { a0 } };
+    tx_log_push(&r);
+}
+
+void tx_log_msg(const char *msg){
+    const tx_log_rec_t r = { .ev = TX_LOG_TEXT, .msg = msg };
+    tx_log_push(&r);
+}
+
+void tx_log_errno(const char *msg, int err){
+    const tx_log_rec_t r = { .ev = TX_LOG_ERRNO, .i = err, .msg = msg };
+    tx_log_push(&r);
+}
+
+static int64_t mono_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *log_loop(void *args){
+    (void)args;
+    const struct timespec poll = { .tv_sec = 0, .tv_nsec = TX_LOG_POLL_MS * 1000000L };
+    int64_t window = mono_ns();
+    uint32_t written = 0;
+    uint64_t reported = 0;
+
+    for (;;) {
+        // Stop is raised after the producer is gone: one more pass empties the ring
+        const int stop = atomic_load_explicit(&stopping, memory_order_acquire);
+        const uint64_t h = atomic_load_explicit(&head, memory_order_acquire);
+        uint64_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+
+        const int64_t now = mono_ns();
+        const int rolled = now - window >= 1000000000LL;
+        if (rolled) {
+            window = now;
+            written = 0;
+        }
+        for (; t != h; t++) {
+            if (written < TX_LOG_RATE) {
+                written += (uint32_t)format_rec(stderr, &ring[t & RING_MASK]);
+            } else {
+                drop();
+            }
+            atomic_store_explicit(&tail, t + 1, memory_order_release);
+        }
+
+        // At most one report per rate window, and one at the end
+        const uint64_t d = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if (d != reported && (rolled || stop)) {
+            fprintf(stderr, "Log: %llu records dropped\n", (unsigned long long)(d - reported));
+            reported = d;
+        }
+        if (stop) break;
+        nanosleep(&poll, NULL);
+    }
+    return NULL;
+}
+
+int tx_log_start(rt_metrics_t *m){
+    drop_metrics = m;
+    atomic_store_explicit(&stopping, 0, memory_order_relaxed);
+    if (thread_create_low(&writer_tid, log_loop, NULL) != 0) {
+        perror("Log: pthread_create");
+        return -1;
+    }
+    atomic_store_explicit(&running, 1, memory_order_release);
+    return 1;
+}
+
+void tx_log_stop(void){
+    if (!atomic_load_explicit(&running, memory_order_acquire)) return;
+    atomic_store_explicit(&stopping, 1, memory_order_release);
+    pthread_join(writer_tid, NULL);
+    atomic_store_explicit(&running, 0, memory_order_release);
+}
+
+void tx_log_bind(void){
+    bound = 1;
+}
+
+uint64_t tx_log_dropped(void){
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
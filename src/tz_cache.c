@@ -0,0 +1,225 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tz_cache.h"
+
+#define PROBE_STEP (7 * 86400)
+
+// Howard Hinnant's days_from_civil / civil_from_days
+int64_t tz_days_from_civil(int y, int m, int d){
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void tz_civil_from_days(int64_t z, int *y, int *m, int *d){
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+int tz_parse_utc(const char *s, time_t *out){
+    if (s[0] == '@') {
+        char *end = NULL;
+        errno = 0;
+        long long v = strtoll(s + 1, &end, 10);
+        if (end == s + 1 || *end != '\0' || errno == ERANGE) return -1;
+        *out = (time_t)v;
+        return 0;
+    }
+    int y, mo, d, h = 0, mi = 0, n = 0;
+    if (sscanf(s, "%d-%d-%d%n", &y, &mo, &d, &n) != 3) return -1;
+    if (s[n] == 'T' || s[n] == ' ') {
+        int n2 = 0;
+        if (sscanf(s + n + 1, "%d:%d%n", &h, &mi, &n2) != 2) return -1;
+        n += n2 + 1;
+    }
+    if (s[n] != '\0' || mo < 1 || mo > 12 || d < 1 || d > 31 || h < 0 || h > 23 || mi < 0 || mi > 59) return -1;
+    *out = (time_t)(tz_days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60);
+    return 0;
+}
+
+static int64_t floor_div(int64_t a, int64_t b){
+    int64_t q = a / b;
+    if ((a % b) && ((a < 0) != (b < 0))) q--;
+    return q;
+}
+
+static int64_t year_start(int y){ return tz_days_from_civil(y, 1, 1) * 86400; }
+
+static int year_of(time_t t){
+    int y, m, d;
+    tz_civil_from_days(floor_div((int64_t)t, 86400), &y, &m, &d);
+    return y;
+}
+
+static int cache_alloc(tz_cache_t *tz, const char *name, int first_year, int last_year){
+    memset(tz, 0, sizeof(*tz));
+    if (last_year < first_year) { errno = EINVAL; return -1; }
+    snprintf(tz->zone, sizeof(tz->zone), "%s", name);
+    tz->first_year = first_year;
+    tz->last_year = last_year;
+    tz->year = calloc((size_t)(last_year - first_year + 1), sizeof(tz_year_t));
+    return tz->year ? 1 : -1;
+}
+
+static void year_add_trans(tz_year_t *yr, int64_t at, int32_t off, uint8_t dst){
+    if (yr->n_trans >= TZ_MAX_TRANS) return;
+    yr->trans[yr->n_trans++] = (tz_trans_t){ .at = at, .utc_offset = off, .is_dst = dst };
+}
+
+/*--------------------------- tzfile probe ------------------------*/
+
+static void probe(int64_t t, int32_t *off, uint8_t *dst){
+    time_t tt = (time_t)t;
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    *off = (int32_t)tm.tm_gmtoff;
+    *dst = tm.tm_isdst > 0;
+}
+
+static int zone_file_exists(const char *zone){
+    if (zone[0] == '/') return access(zone, R_OK) == 0;
+    const char *dir = getenv("TZDIR");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir ? dir : "/usr/share/zoneinfo", zone);
+    return access(path, R_OK) == 0;
+}
+
+int tz_cache_init(tz_cache_t *tz, const char *zone, int first_year, int last_year){
+    if (!zone_file_exists(zone)) {
+        fprintf(stderr, "Time zone '%s' not found\n", zone);
+        errno = ENOENT;
+        return -1;
+    }
+    if (cache_alloc(tz, zone, first_year, last_year) < 0) return -1;
+
+    // localtime_r is only used here: swap TZ, probe, restore
+    const char *old = getenv("TZ");
+    char *saved = old ? strdup(old) : NULL;
+    setenv("TZ", zone, 1);
+    tzset();
+
+    for (int y = first_year; y <= last_year; ++y) {
+        tz_year_t *yr = &tz->year[y - first_year];
+        const int64_t t0 = year_start(y), t1 = year_start(y + 1);
+        probe(t0, &yr->utc_offset, &yr->is_dst);
+
+        int32_t off = yr->utc_offset;
+        uint8_t dst = yr->is_dst;
+        for (int64_t lo = t0; lo < t1; lo += PROBE_STEP) {
+            int64_t hi = lo + PROBE_STEP < t1 ? lo + PROBE_STEP : t1 - 1;
+            int32_t off_hi;
+            uint8_t dst_hi;
+            probe(hi, &off_hi, &dst_hi);
+            if (off_hi == off && dst_hi == dst) continue;
+
+            // Bisect to the exact second of the change
+            int64_t a = lo, b = hi;
+            while (b - a > 1) {
+                int64_t mid = a + (b - a) / 2;
+                int32_t o;
+                uint8_t d;
+                probe(mid, &o, &d);
+                if (o == off && d == dst) a = mid; else b = mid;
+            }
+            year_add_trans(yr, b, off_hi, dst_hi);
+            off = off_hi;
+            dst = dst_hi;
+        }
+    }
+
+    if (saved) { setenv("TZ", saved, 1); free(saved); }
+    else unsetenv("TZ");
+    tzset();
+    return 1;
+}
+
+/*--------------------------- tzfile probe ------------------------*/
+
+static int64_t rule_instant(int y, const DSTRule_t *r, int32_t local_offset){
+    int mday;
+    if (r->week >= 5) mday = get_last_sunday(y, r->month); // EU style rules: last Sunday of the month
+    else mday = 1 + (7 - weekday(y, r->month, 1)) % 7 + 7 * (r->week - 1); // US style: n-th Sunday
+    return tz_days_from_civil(y, r->month, mday) * 86400 + (int64_t)r->hour * 3600 - local_offset;
+}
+
+int tz_cache_init_rules(tz_cache_t *tz, const char *name, int32_t std_offset, const DSTRule_t *start, const DSTRule_t *end, int first_year, int last_year){
+    if (cache_alloc(tz, name, first_year, last_year) < 0) return -1;
+    const int32_t dst_offset = std_offset + 3600;
+
+    for (int y = first_year; y <= last_year; ++y) {
+        tz_year_t *yr = &tz->year[y - first_year];
+        yr->utc_offset = std_offset; // Northern hemisphere: standard time at New Year
+        yr->is_dst = 0;
+        if (!start || !end) continue; // No DST
+        const int64_t on = rule_instant(y, start, std_offset);
+        const int64_t off = rule_instant(y, end, dst_offset);
+        year_add_trans(yr, on, dst_offset, 1);
+        year_add_trans(yr, off, std_offset, 0);
+    }
+    return 1;
+}
+
+void tz_cache_free(tz_cache_t *tz){
+    free(tz->year);
+    tz->year = NULL;
+}
+
+// First change strictly after t within the same or the following year, 0 if none is cached
+static int64_t next_trans(const tz_cache_t *tz, int yi, time_t t){
+    for (int k = 0; k < 2 && yi + k <= tz->last_year - tz->first_year; ++k) {
+        const tz_year_t *yr = &tz->year[yi + k];
+        for (int i = 0; i < yr->n_trans; ++i) {
+            if (yr->trans[i].at > (int64_t)t) return yr->trans[i].at;
+        }
+    }
+    return 0;
+}
+
+tz_info_t tz_lookup(const tz_cache_t *tz, time_t t){
+    tz_info_t info = {0};
+    if (!tz || !tz->year) return info; // UTC
+
+    int y = year_of(t);
+    if (y < tz->first_year) y = tz->first_year;
+    if (y > tz->last_year) y = tz->last_year;
+    const int yi = y - tz->first_year;
+    const tz_year_t *yr = &tz->year[yi];
+
+    info.utc_offset = yr->utc_offset;
+    info.is_dst = yr->is_dst;
+    for (int i = 0; i < yr->n_trans && yr->trans[i].at <= (int64_t)t; ++i) {
+        info.utc_offset = yr->trans[i].utc_offset;
+        info.is_dst = yr->trans[i].is_dst;
+    }
+
+    const int64_t nt = next_trans(tz, yi, t);
+    info.announce = nt && nt - (int64_t)t <= TZ_ANNOUNCE_SECS;
+    return info;
+}
+
+void tz_localtime(const tz_cache_t *tz, time_t t, tz_local_t *out){
+    out->info = tz_lookup(tz, t);
+    const int64_t local = (int64_t)t + out->info.utc_offset;
+    const int64_t days = floor_div(local, 86400);
+    const int64_t secs = local - days * 86400;
+
+    tz_civil_from_days(days, &out->year, &out->mon, &out->mday);
+    out->hour = (int)(secs / 3600);
+    out->min = (int)(secs % 3600 / 60);
+    out->wday = (int)(((days + 3) % 7 + 7) % 7) + 1; // 1970-01-01 was a Thursday
+    out->yday = (int)(days - tz_days_from_civil(out->year, 1, 1)) + 1;
+}